@@ -6,38 +6,22 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Operations are done on double words, so default to 32-bit words only
-// on 64-bit context. Otherwise use 32-bit operations (16-bit words).
-// Never defaults to 8-bit words.
-#ifndef BQINT_WORD_BITS
-	#if INTPTR_MAX == INT64_MAX
-		#define BQINT_WORD_BITS 32
-	#else
-		#define BQINT_WORD_BITS 16
-	#endif
-#endif
-
-#if BQINT_WORD_BITS == 32
-typedef uint32_t bqint_word;
-typedef uint64_t bqint_dword;
-#elif BQINT_WORD_BITS == 16
-typedef uint16_t bqint_word;
-typedef uint32_t bqint_dword;
-#elif BQINT_WORD_BITS == 8
-typedef uint8_t bqint_word;
-typedef uint16_t bqint_dword;
-#else
-#error "Unsupported BQINT_WORD_BITS"
-#endif
-
+// BQINT_COMPACT packs the size, capacity and flags into 16 bits each, making
+// `struct bqint` 16 bytes instead of 24 on 64-bit platforms (plus any extra
+// inline capacity). This limits the values to 65535 words, larger results
+// are truncated like any other result that doesn't fit.
 #ifdef BQINT_TYPE_BQINT_SIZE
 typedef BQINT_TYPE_BQINT_SIZE bqint_size;
+#elif defined(BQINT_COMPACT)
+typedef uint16_t bqint_size;
 #else
 typedef uint32_t bqint_size;
 #endif
 
 #ifdef BQINT_TYPE_BQINT_FLAGS
 typedef BQINT_TYPE_BQINT_FLAGS bqint_flags;
+#elif defined(BQINT_COMPACT)
+typedef uint16_t bqint_flags;
 #else
 typedef uint32_t bqint_flags;
 #endif
@@ -51,10 +35,18 @@ typedef uint32_t bqint_flags;
 #define BQINT_ASSERT_FLAGS (BQINT_ERROR)
 #endif
 
-#define BQINT_MAX_WORDS (~(bqint_size)0)
+#define BQINT_MAX_WORDS ((bqint_size)~(bqint_size)0)
 
 #define BQINT_ASSERT_FLAG_SET(flag) BQINT_ASSERT(!((flag) & BQINT_ASSERT_FLAGS))
 
+// The small query functions are defined in every instance, so they must not
+// warn when a program doesn't call them (or compiles `inline` away)
+#if defined(__GNUC__)
+#define BQINT__UNUSED __attribute__((unused))
+#else
+#define BQINT__UNUSED
+#endif
+
 // -- Flags
 
 enum
@@ -65,29 +57,619 @@ enum
 	BQINT_ALLOCATED = 1 << 2,
 	BQINT_DYNAMIC = 1 << 3,
 	BQINT_INLINED = 1 << 4,
+	BQINT_VIEW = 1 << 5,
+	BQINT_SHARED = 1 << 6,
 
 	BQINT_TRUNCATED = 1 << 8,
 	BQINT_OUT_OF_MEMORY = 1 << 9,
 	BQINT_DIV_BY_ZERO = 1 << 10,
 	BQINT_PARSE_FAILED = 1 << 11,
+	BQINT_DOMAIN_ERROR = 1 << 12,
 
 	BQINT_STORAGE = 0
 		| BQINT_STATIC
 		| BQINT_ALLOCATED
 		| BQINT_DYNAMIC
-		| BQINT_INLINED,
+		| BQINT_INLINED
+		| BQINT_VIEW
+		| BQINT_SHARED,
 
 	BQINT_ERROR = 0
 		| BQINT_TRUNCATED
 		| BQINT_OUT_OF_MEMORY
 		| BQINT_DIV_BY_ZERO
-		| BQINT_PARSE_FAILED,
+		| BQINT_PARSE_FAILED
+		| BQINT_DOMAIN_ERROR,
+};
+
+// -- Allocators
+
+typedef void*(*bqint_alloc_fn)(size_t);
+typedef void*(*bqint_realloc_fn)(void *, size_t copy_size, size_t new_size);
+typedef void(*bqint_free_fn)(void*);
+
+// Set global allocators for bqint functions
+// Note: If realloc_fn is 0, then a default one will be provided using alloc_fn and free_fn
+// Note: The memory must be aligned like malloc() does, double words of 64-bit
+// words need 16 byte alignment
+void bqint_set_allocators(bqint_alloc_fn alloc_fn, bqint_free_fn free_fn, bqint_realloc_fn realloc_fn);
+
+// -- Pooled allocator
+
+// Define BQINT_POOL to include a pooled allocator meant to be plugged in with
+// bqint_set_allocators(bqint_pool_alloc, bqint_pool_free, bqint_pool_realloc).
+// Allocations are rounded up to power of two size classes and freed blocks
+// are cached in thread-local freelists, so values that are repeatedly
+// created and destroyed reuse the same memory. A reallocation that fits in
+// the current size class returns the same block without copying.
+// Note: Blocks can be freed from any thread, they end up in the cache of the
+// thread that frees them. Call bqint_pool_trim() before a thread exits to
+// release its cache.
+
+#ifdef BQINT_POOL
+
+// Largest pooled block in bytes as a power of two, larger blocks are passed
+// directly to malloc() and free()
+#ifndef BQINT_POOL_MAX_CLASS
+#define BQINT_POOL_MAX_CLASS 20
+#endif
+
+// Maximum number of cached free blocks per size class per thread
+#ifndef BQINT_POOL_MAX_CACHED
+#define BQINT_POOL_MAX_CACHED 64
+#endif
+
+void *bqint_pool_alloc(size_t size);
+void bqint_pool_free(void *memory);
+void *bqint_pool_realloc(void *memory, size_t copy_size, size_t new_size);
+
+// Release the cached blocks of the calling thread back to the system
+void bqint_pool_trim(void);
+
+#endif
+
+// -- Statistics
+
+// Instrumentation is opt-in: define BQINT_STATS (for the implementation) to
+// count operations, operand sizes, allocations and error events. Define also
+// BQINT_STATS_CYCLES to record a latency histogram per operation using the
+// CPU cycle counter (or a user provided BQINT_CYCLE_COUNTER() expression).
+// Without BQINT_STATS the hooks compile to nothing and snapshots are zero.
+// Note: The counters are global and not synchronized between threads.
+
+enum
+{
+	BQINT_STAT_SET,
+	BQINT_STAT_ADD,
+	BQINT_STAT_ADD_INPLACE,
+	BQINT_STAT_MUL,
+	BQINT_STAT_MUL_INPLACE,
+	BQINT_STAT_SUB,
+	BQINT_STAT_SHR,
+	BQINT_STAT_SHL,
+	BQINT_STAT_AND,
+	BQINT_STAT_OR,
+	BQINT_STAT_XOR,
+	BQINT_STAT_ANDNOT,
+	BQINT_STAT_NOT,
+	BQINT_STAT_CMP,
+	BQINT_STAT_DIVMOD,
+	BQINT_STAT_GCD,
+	BQINT_STAT_GCDEXT,
+	BQINT_STAT_INVMOD,
+	BQINT_STAT_POW,
+	BQINT_STAT_PRODUCT,
+	BQINT_STAT_BSPLIT,
+	BQINT_STAT_SQRTREM,
+	BQINT_STAT_ROOT,
+	BQINT_STAT_RNS_SET,
+	BQINT_STAT_RNS_GET,
+	BQINT_STAT_ACCUMULATE,
+	BQINT_STAT_ACCUMULATOR_GET,
+	BQINT_STAT_RANDOM,
+	BQINT_STAT_POWMOD,
+	BQINT_STAT_PRIME,
+	BQINT_STAT_NEXT_PRIME,
+	BQINT_STAT_DIVEXACT,
+	BQINT_STAT_JOB_STEP,
+	BQINT_STAT_DOT,
+	BQINT_STAT_SORT,
+	BQINT_STAT_MULTI_POWMOD,
+
+	BQINT_STAT_NUM_OPS,
+};
+
+// Histogram bucket `i` counts values in range [2^(i-1), 2^i), bucket 0 is
+// for zero and the last bucket contains everything larger
+#define BQINT_STATS_SIZE_BUCKETS 24
+#define BQINT_STATS_LATENCY_BUCKETS 32
+
+typedef struct bqint_op_stats
+{
+	uint64_t calls;
+	uint64_t cycles;
+	uint64_t size_histogram[BQINT_STATS_SIZE_BUCKETS];
+	uint64_t latency_histogram[BQINT_STATS_LATENCY_BUCKETS];
+} bqint_op_stats;
+
+typedef struct bqint_stats
+{
+	bqint_op_stats ops[BQINT_STAT_NUM_OPS];
+
+	uint64_t allocs;
+	uint64_t reallocs;
+	uint64_t frees;
+	uint64_t bytes_allocated;
+	uint64_t bytes_freed;
+
+	uint64_t truncated;
+	uint64_t out_of_memory;
+	uint64_t div_by_zero;
+	uint64_t parse_failed;
+	uint64_t domain_error;
+} bqint_stats;
+
+// Copy the current counters to `stats`
+void bqint_stats_snapshot(bqint_stats *stats);
+
+// Reset all the counters to zero
+void bqint_stats_reset(void);
+
+// Returns a human readable name for a BQINT_STAT_* operation
+const char *bqint_stats_op_name(int op);
+
+// -- Thresholds
+
+// Crossover sizes in words between the tiers of the algorithms. The defaults
+// are measured for the local machine by the tune program (tune_bqint.c) that
+// writes `bqint_thresholds.h`, which is included from the include path if it
+// exists (unless BQINT_NO_THRESHOLDS_HEADER is defined). The macros can also
+// be defined directly, they are evaluated separately for every instance so
+// they may depend on BQINT_WORD_BITS.
+#if !defined(BQINT_NO_THRESHOLDS_HEADER) && defined(__has_include)
+	#if __has_include("bqint_thresholds.h")
+		#include "bqint_thresholds.h"
+	#endif
+#endif
+
+// Operand size in words up to which bqint_gcd() uses binary GCD instead of
+// Lehmer's algorithm
+#ifndef BQINT_GCD_LEHMER_THRESHOLD
+#define BQINT_GCD_LEHMER_THRESHOLD (128 / BQINT_WORD_BITS)
+#endif
+
+// Operand size in words from which squares are computed with the dedicated
+// squaring instead of the general multiplication
+#ifndef BQINT_SQR_THRESHOLD
+#define BQINT_SQR_THRESHOLD (BQINT_WORD_BITS <= 16 ? 4096 / BQINT_WORD_BITS : 128 / BQINT_WORD_BITS)
+#endif
+
+enum
+{
+	BQINT_THRESHOLD_GCD_LEHMER,
+	BQINT_THRESHOLD_SQR,
+
+	BQINT_THRESHOLD_NUM,
+};
+
+// Returns the name of a BQINT_THRESHOLD_* value as used in the environment
+// variable, see bqint_load_thresholds()
+const char *bqint_threshold_name(int threshold);
+
+// -- Prime fields
+
+// Fixed primes of the bqint_fe_*() field element functions
+enum
+{
+	BQINT_FIELD_25519,     // 2^255 - 19
+	BQINT_FIELD_SECP256K1, // 2^256 - 2^32 - 977
+	BQINT_FIELD_P256,      // 2^256 - 2^224 + 2^192 + 2^96 - 1
+	BQINT_FIELD_P384,      // 2^384 - 2^128 - 2^96 + 2^32 - 1
+
+	BQINT_FIELD_NUM,
 };
 
+// -- Instances
+
+// The word size dependent part of the library can be included again with
+// BQINT_INSTANCE defined to 8, 16, 32 or 64. This makes a copy of it with words
+// of that many bits where every name starts with `bqintN` instead of `bqint`
+// (bqint64, bqint64_word, bqint64_add(), ...), BQINT_IMPLEMENTATION includes
+// the implementation of the instance too. The flags, allocators, pool and
+// statistics are shared by all instances. BQINT_INSTANCE is undefined at the
+// end of the header and BQINT_WORD_BITS is left as the word size of the plain
+// `bqint` names.
+//
+//   #define BQINT_INSTANCE 64
+//   #include "bqint.h"
+//
+// The first instance defines macros for all the names that map them to the
+// current instance, outside of the instances they map back to themselves.
+
+// Zero-copy view of the bqint `a` of any instance as a value of the instance
+// `prefix` (such as bqint32 or bqint64), see bqint_view_le(). Only on
+// little-endian hosts, `a` is evaluated more than once.
+#define BQINT_REINTERPRET(prefix, a) prefix##_view_le( \
+		(a).flags & BQINT_INLINED ? (const void*)(a).data.inline_words : (const void*)(a).data.words, \
+		(a).size * sizeof(*(a).data.inline_words), (a).flags & BQINT_NEGATIVE)
+
+#define BQINT__NAME(name) BQINT__NAME_EXPAND(BQINT__SUFFIX, name)
+#define BQINT__NAME_EXPAND(suffix, name) BQINT__NAME_PASTE(suffix, name)
+#define BQINT__NAME_PASTE(suffix, name) bqint ## suffix ## name
+#define BQINT__STRING(x) BQINT__STRING_EXPAND(x)
+#define BQINT__STRING_EXPAND(x) #x
+#define BQINT__SUFFIX
+
+#endif
+
+#ifdef BQINT_INSTANCE
+	#pragma push_macro("BQINT_WORD_BITS")
+	#undef BQINT_WORD_BITS
+	#define BQINT_WORD_BITS BQINT_INSTANCE
+	#undef BQINT__SUFFIX
+	#define BQINT__SUFFIX BQINT_INSTANCE
+#endif
+
+#if defined(BQINT_INSTANCE) && !defined(BQINT__NAMES_DEFINED)
+#define BQINT__NAMES_DEFINED
+#define bqint BQINT__NAME()
+#define bqint__accumulate BQINT__NAME(__accumulate)
+#define bqint__accumulator_carry BQINT__NAME(__accumulator_carry)
+#define bqint__accumulator_normalize BQINT__NAME(__accumulator_normalize)
+#define bqint__accumulator_reserve BQINT__NAME(__accumulator_reserve)
+#define bqint__add_n_words BQINT__NAME(__add_n_words)
+#define bqint__add_signed BQINT__NAME(__add_signed)
+#define bqint__add_size BQINT__NAME(__add_size)
+#define bqint__add_words BQINT__NAME(__add_words)
+#define bqint__addmul_1_words BQINT__NAME(__addmul_1_words)
+#define bqint__addmul_2_words BQINT__NAME(__addmul_2_words)
+#define bqint__addmul_4_words BQINT__NAME(__addmul_4_words)
+#define bqint__addmul_wide_words BQINT__NAME(__addmul_wide_words)
+#define bqint__bitop BQINT__NAME(__bitop)
+#define bqint__bitop_word BQINT__NAME(__bitop_word)
+#define bqint__bitop_words BQINT__NAME(__bitop_words)
+#define bqint__bitop_words_signed BQINT__NAME(__bitop_words_signed)
+#define bqint__bpsw BQINT__NAME(__bpsw)
+#define bqint__bsplit BQINT__NAME(__bsplit)
+#define bqint__clamp_size BQINT__NAME(__clamp_size)
+#define bqint__clz_word BQINT__NAME(__clz_word)
+#define bqint__cmp BQINT__NAME(__cmp)
+#define bqint__cmp_mag BQINT__NAME(__cmp_mag)
+#define bqint__cmp_n_words BQINT__NAME(__cmp_n_words)
+#define bqint__combine_flags BQINT__NAME(__combine_flags)
+#define bqint__ctz_word BQINT__NAME(__ctz_word)
+#define bqint__detach BQINT__NAME(__detach)
+#define bqint__digits BQINT__NAME(__digits)
+#define bqint__div_word_words BQINT__NAME(__div_word_words)
+#define bqint__divexact BQINT__NAME(__divexact)
+#define bqint__divexact_words BQINT__NAME(__divexact_words)
+#define bqint__divmod BQINT__NAME(__divmod)
+#define bqint__divmod_words BQINT__NAME(__divmod_words)
+#define bqint__domain_error BQINT__NAME(__domain_error)
+#define bqint__dot_fold BQINT__NAME(__dot_fold)
+#define bqint__fe_field BQINT__NAME(__fe_field)
+#define bqint__fe_load BQINT__NAME(__fe_load)
+#define bqint__fe_mul_words BQINT__NAME(__fe_mul_words)
+#define bqint__fe_prime_25519 BQINT__NAME(__fe_prime_25519)
+#define bqint__fe_prime_p256 BQINT__NAME(__fe_prime_p256)
+#define bqint__fe_prime_p384 BQINT__NAME(__fe_prime_p384)
+#define bqint__fe_prime_secp256k1 BQINT__NAME(__fe_prime_secp256k1)
+#define bqint__fe_reduce BQINT__NAME(__fe_reduce)
+#define bqint__fe_reduce_word BQINT__NAME(__fe_reduce_word)
+#define bqint__fe_store BQINT__NAME(__fe_store)
+#define bqint__flags_fit BQINT__NAME(__flags_fit)
+#define bqint__gcd_apply BQINT__NAME(__gcd_apply)
+#define bqint__gcd_binary BQINT__NAME(__gcd_binary)
+#define bqint__gcd_cofactor_step BQINT__NAME(__gcd_cofactor_step)
+#define bqint__gcd_lehmer BQINT__NAME(__gcd_lehmer)
+#define bqint__grow BQINT__NAME(__grow)
+#define bqint__inc_words BQINT__NAME(__inc_words)
+#define bqint__inverse_word BQINT__NAME(__inverse_word)
+#define bqint__is_big_endian BQINT__NAME(__is_big_endian)
+#define bqint__is_prime_word BQINT__NAME(__is_prime_word)
+#define bqint__jacobi_small BQINT__NAME(__jacobi_small)
+#define bqint__job_error BQINT__NAME(__job_error)
+#define bqint__job_finish BQINT__NAME(__job_finish)
+#define bqint__job_get_string_step BQINT__NAME(__job_get_string_step)
+#define bqint__job_init BQINT__NAME(__job_init)
+#define bqint__job_mul_step BQINT__NAME(__job_mul_step)
+#define bqint__job_powmod_step BQINT__NAME(__job_powmod_step)
+#define bqint__lincomb BQINT__NAME(__lincomb)
+#define bqint__lincomb_words BQINT__NAME(__lincomb_words)
+#define bqint__load_bytes BQINT__NAME(__load_bytes)
+#define bqint__mod_word BQINT__NAME(__mod_word)
+#define bqint__mont BQINT__NAME(__mont)
+#define bqint__mont_add BQINT__NAME(__mont_add)
+#define bqint__mont_equal BQINT__NAME(__mont_equal)
+#define bqint__mont_free BQINT__NAME(__mont_free)
+#define bqint__mont_get BQINT__NAME(__mont_get)
+#define bqint__mont_half BQINT__NAME(__mont_half)
+#define bqint__mont_init BQINT__NAME(__mont_init)
+#define bqint__mont_is_zero BQINT__NAME(__mont_is_zero)
+#define bqint__mont_layout BQINT__NAME(__mont_layout)
+#define bqint__mont_mul BQINT__NAME(__mont_mul)
+#define bqint__mont_pow BQINT__NAME(__mont_pow)
+#define bqint__mont_set BQINT__NAME(__mont_set)
+#define bqint__mont_set_small BQINT__NAME(__mont_set_small)
+#define bqint__mont_sub BQINT__NAME(__mont_sub)
+#define bqint__montmul_words BQINT__NAME(__montmul_words)
+#define bqint__mul_signed BQINT__NAME(__mul_signed)
+#define bqint__mul_words BQINT__NAME(__mul_words)
+#define bqint__mul_words_inplace BQINT__NAME(__mul_words_inplace)
+#define bqint__multi_pippenger BQINT__NAME(__multi_pippenger)
+#define bqint__multi_straus BQINT__NAME(__multi_straus)
+#define bqint__popcount64 BQINT__NAME(__popcount64)
+#define bqint__pow_window BQINT__NAME(__pow_window)
+#define bqint__powmod_base BQINT__NAME(__powmod_base)
+#define bqint__powmod_word BQINT__NAME(__powmod_word)
+#define bqint__prev_prime_word BQINT__NAME(__prev_prime_word)
+#define bqint__product BQINT__NAME(__product)
+#define bqint__product_tree BQINT__NAME(__product_tree)
+#define bqint__reserve BQINT__NAME(__reserve)
+#define bqint__root BQINT__NAME(__root)
+#define bqint__sdword BQINT__NAME(__sdword)
+#define bqint__set_abs BQINT__NAME(__set_abs)
+#define bqint__set_bytes BQINT__NAME(__set_bytes)
+#define bqint__set_error BQINT__NAME(__set_error)
+#define bqint__set_raw_u32 BQINT__NAME(__set_raw_u32)
+#define bqint__set_sign BQINT__NAME(__set_sign)
+#define bqint__shl BQINT__NAME(__shl)
+#define bqint__shl_words BQINT__NAME(__shl_words)
+#define bqint__shr BQINT__NAME(__shr)
+#define bqint__shr_words BQINT__NAME(__shr_words)
+#define bqint__shr_words_lost BQINT__NAME(__shr_words_lost)
+#define bqint__small_prime_residues BQINT__NAME(__small_prime_residues)
+#define bqint__small_primes BQINT__NAME(__small_primes)
+#define bqint__sort_cmp BQINT__NAME(__sort_cmp)
+#define bqint__sort_digit BQINT__NAME(__sort_digit)
+#define bqint__sort_key BQINT__NAME(__sort_key)
+#define bqint__sort_key_init BQINT__NAME(__sort_key_init)
+#define bqint__sort_run BQINT__NAME(__sort_run)
+#define bqint__sqr_words BQINT__NAME(__sqr_words)
+#define bqint__squares_mod11 BQINT__NAME(__squares_mod11)
+#define bqint__squares_mod63 BQINT__NAME(__squares_mod63)
+#define bqint__squares_mod64 BQINT__NAME(__squares_mod64)
+#define bqint__squares_mod65 BQINT__NAME(__squares_mod65)
+#define bqint__sub_n_words BQINT__NAME(__sub_n_words)
+#define bqint__sub_words BQINT__NAME(__sub_words)
+#define bqint__submul_1_words BQINT__NAME(__submul_1_words)
+#define bqint__swap BQINT__NAME(__swap)
+#define bqint__thresholds BQINT__NAME(__thresholds)
+#define bqint__tree_depth BQINT__NAME(__tree_depth)
+#define bqint__trial_division BQINT__NAME(__trial_division)
+#define bqint__truncate BQINT__NAME(__truncate)
+#define bqint__wide BQINT__NAME(__wide)
+#define bqint__word_at_bit BQINT__NAME(__word_at_bit)
+#define bqint_accumulator BQINT__NAME(_accumulator)
+#define bqint_accumulator_add BQINT__NAME(_accumulator_add)
+#define bqint_accumulator_add_word BQINT__NAME(_accumulator_add_word)
+#define bqint_accumulator_clear BQINT__NAME(_accumulator_clear)
+#define bqint_accumulator_free BQINT__NAME(_accumulator_free)
+#define bqint_accumulator_get BQINT__NAME(_accumulator_get)
+#define bqint_accumulator_init BQINT__NAME(_accumulator_init)
+#define bqint_add BQINT__NAME(_add)
+#define bqint_add_inplace BQINT__NAME(_add_inplace)
+#define bqint_and BQINT__NAME(_and)
+#define bqint_and_inplace BQINT__NAME(_and_inplace)
+#define bqint_andnot BQINT__NAME(_andnot)
+#define bqint_andnot_inplace BQINT__NAME(_andnot_inplace)
+#define bqint_bit_length BQINT__NAME(_bit_length)
+#define bqint_bsplit BQINT__NAME(_bsplit)
+#define bqint_byte_size BQINT__NAME(_byte_size)
+#define bqint_clear_bit BQINT__NAME(_clear_bit)
+#define bqint_cmp BQINT__NAME(_cmp)
+#define bqint_ctz BQINT__NAME(_ctz)
+#define bqint_div BQINT__NAME(_div)
+#define bqint_divexact BQINT__NAME(_divexact)
+#define bqint_divexact_word BQINT__NAME(_divexact_word)
+#define bqint_divmod BQINT__NAME(_divmod)
+#define bqint_dot BQINT__NAME(_dot)
+#define bqint_dword BQINT__NAME(_dword)
+#define bqint_dynamic BQINT__NAME(_dynamic)
+#define bqint_dynamic_initial BQINT__NAME(_dynamic_initial)
+#define bqint_fe BQINT__NAME(_fe)
+#define bqint_fe_add BQINT__NAME(_fe_add)
+#define bqint_fe_equal BQINT__NAME(_fe_equal)
+#define bqint_fe_get BQINT__NAME(_fe_get)
+#define bqint_fe_inv BQINT__NAME(_fe_inv)
+#define bqint_fe_mul BQINT__NAME(_fe_mul)
+#define bqint_fe_prime BQINT__NAME(_fe_prime)
+#define bqint_fe_set BQINT__NAME(_fe_set)
+#define bqint_fe_set_u32 BQINT__NAME(_fe_set_u32)
+#define bqint_fe_size BQINT__NAME(_fe_size)
+#define bqint_fe_sqr BQINT__NAME(_fe_sqr)
+#define bqint_fe_sub BQINT__NAME(_fe_sub)
+#define bqint_free BQINT__NAME(_free)
+#define bqint_gcd BQINT__NAME(_gcd)
+#define bqint_gcdext BQINT__NAME(_gcdext)
+#define bqint_get_bytes BQINT__NAME(_get_bytes)
+#define bqint_get_size BQINT__NAME(_get_size)
+#define bqint_get_string BQINT__NAME(_get_string)
+#define bqint_get_threshold BQINT__NAME(_get_threshold)
+#define bqint_get_words BQINT__NAME(_get_words)
+#define bqint_invmod BQINT__NAME(_invmod)
+#define bqint_is_probable_prime BQINT__NAME(_is_probable_prime)
+#define bqint_is_square BQINT__NAME(_is_square)
+#define bqint_job BQINT__NAME(_job)
+#define bqint_job_cancel BQINT__NAME(_job_cancel)
+#define bqint_job_get_string BQINT__NAME(_job_get_string)
+#define bqint_job_mul BQINT__NAME(_job_mul)
+#define bqint_job_powmod BQINT__NAME(_job_powmod)
+#define bqint_job_step BQINT__NAME(_job_step)
+#define bqint_load_thresholds BQINT__NAME(_load_thresholds)
+#define bqint_mod BQINT__NAME(_mod)
+#define bqint_mul BQINT__NAME(_mul)
+#define bqint_mul_inplace BQINT__NAME(_mul_inplace)
+#define bqint_multi_powmod BQINT__NAME(_multi_powmod)
+#define bqint_next_prime BQINT__NAME(_next_prime)
+#define bqint_not BQINT__NAME(_not)
+#define bqint_ok BQINT__NAME(_ok)
+#define bqint_or BQINT__NAME(_or)
+#define bqint_or_inplace BQINT__NAME(_or_inplace)
+#define bqint_parse_string BQINT__NAME(_parse_string)
+#define bqint_popcount BQINT__NAME(_popcount)
+#define bqint_pow BQINT__NAME(_pow)
+#define bqint_pow_word BQINT__NAME(_pow_word)
+#define bqint_powmod BQINT__NAME(_powmod)
+#define bqint_product BQINT__NAME(_product)
+#define bqint_product_words BQINT__NAME(_product_words)
+#define bqint_random_below BQINT__NAME(_random_below)
+#define bqint_random_bits BQINT__NAME(_random_bits)
+#define bqint_random_fn BQINT__NAME(_random_fn)
+#define bqint_reserve BQINT__NAME(_reserve)
+#define bqint_rns BQINT__NAME(_rns)
+#define bqint_rns_add BQINT__NAME(_rns_add)
+#define bqint_rns_free BQINT__NAME(_rns_free)
+#define bqint_rns_get BQINT__NAME(_rns_get)
+#define bqint_rns_init BQINT__NAME(_rns_init)
+#define bqint_rns_mul BQINT__NAME(_rns_mul)
+#define bqint_rns_set BQINT__NAME(_rns_set)
+#define bqint_rns_sub BQINT__NAME(_rns_sub)
+#define bqint_root BQINT__NAME(_root)
+#define bqint_scan0 BQINT__NAME(_scan0)
+#define bqint_scan1 BQINT__NAME(_scan1)
+#define bqint_series_fn BQINT__NAME(_series_fn)
+#define bqint_set BQINT__NAME(_set)
+#define bqint_set_bit BQINT__NAME(_set_bit)
+#define bqint_set_bytes BQINT__NAME(_set_bytes)
+#define bqint_set_i32 BQINT__NAME(_set_i32)
+#define bqint_set_raw BQINT__NAME(_set_raw)
+#define bqint_set_threshold BQINT__NAME(_set_threshold)
+#define bqint_set_u32 BQINT__NAME(_set_u32)
+#define bqint_set_zero BQINT__NAME(_set_zero)
+#define bqint_share BQINT__NAME(_share)
+#define bqint_shl BQINT__NAME(_shl)
+#define bqint_shl_inplace BQINT__NAME(_shl_inplace)
+#define bqint_shr BQINT__NAME(_shr)
+#define bqint_shr_inplace BQINT__NAME(_shr_inplace)
+#define bqint_shrink_to_fit BQINT__NAME(_shrink_to_fit)
+#define bqint_sort BQINT__NAME(_sort)
+#define bqint_sqrt BQINT__NAME(_sqrt)
+#define bqint_sqrtrem BQINT__NAME(_sqrtrem)
+#define bqint_static BQINT__NAME(_static)
+#define bqint_string_size BQINT__NAME(_string_size)
+#define bqint_sub BQINT__NAME(_sub)
+#define bqint_test_bit BQINT__NAME(_test_bit)
+#define bqint_unique BQINT__NAME(_unique)
+#define bqint_view BQINT__NAME(_view)
+#define bqint_view_le BQINT__NAME(_view_le)
+#define bqint_word BQINT__NAME(_word)
+#define bqint_xor BQINT__NAME(_xor)
+#define bqint_xor_inplace BQINT__NAME(_xor_inplace)
+#endif
+
+// Declare and implement each instance once
+#undef BQINT__DECLARE
+#undef BQINT__IMPLEMENT
+#if !defined(BQINT_INSTANCE)
+	#ifndef BQINT__DECLARED
+		#define BQINT__DECLARED
+		#define BQINT__DECLARE
+	#endif
+	#if defined(BQINT_IMPLEMENTATION) && !defined(BQINT__IMPLEMENTED)
+		#define BQINT__IMPLEMENTED
+		#define BQINT__IMPLEMENT
+	#endif
+#elif BQINT_INSTANCE == 8
+	#ifndef BQINT__DECLARED_8
+		#define BQINT__DECLARED_8
+		#define BQINT__DECLARE
+	#endif
+	#if defined(BQINT_IMPLEMENTATION) && !defined(BQINT__IMPLEMENTED_8)
+		#define BQINT__IMPLEMENTED_8
+		#define BQINT__IMPLEMENT
+	#endif
+#elif BQINT_INSTANCE == 16
+	#ifndef BQINT__DECLARED_16
+		#define BQINT__DECLARED_16
+		#define BQINT__DECLARE
+	#endif
+	#if defined(BQINT_IMPLEMENTATION) && !defined(BQINT__IMPLEMENTED_16)
+		#define BQINT__IMPLEMENTED_16
+		#define BQINT__IMPLEMENT
+	#endif
+#elif BQINT_INSTANCE == 32
+	#ifndef BQINT__DECLARED_32
+		#define BQINT__DECLARED_32
+		#define BQINT__DECLARE
+	#endif
+	#if defined(BQINT_IMPLEMENTATION) && !defined(BQINT__IMPLEMENTED_32)
+		#define BQINT__IMPLEMENTED_32
+		#define BQINT__IMPLEMENT
+	#endif
+#elif BQINT_INSTANCE == 64
+	#ifndef BQINT__DECLARED_64
+		#define BQINT__DECLARED_64
+		#define BQINT__DECLARE
+	#endif
+	#if defined(BQINT_IMPLEMENTATION) && !defined(BQINT__IMPLEMENTED_64)
+		#define BQINT__IMPLEMENTED_64
+		#define BQINT__IMPLEMENT
+	#endif
+#else
+#error "Unsupported BQINT_INSTANCE"
+#endif
+
+#ifdef BQINT__DECLARE
+
+// -- Words
+
+// Operations are done on double words, so default to 32-bit words only
+// on 64-bit context. Otherwise use 32-bit operations (16-bit words).
+// Never defaults to 8-bit words. 64-bit words need a compiler with 128-bit
+// integers (GCC and Clang on 64-bit targets).
+#ifndef BQINT_WORD_BITS
+	#if INTPTR_MAX == INT64_MAX
+		#define BQINT_WORD_BITS 32
+	#else
+		#define BQINT_WORD_BITS 16
+	#endif
+#endif
+
+#if BQINT_WORD_BITS == 64 && defined(__SIZEOF_INT128__)
+typedef uint64_t bqint_word;
+__extension__ typedef unsigned __int128 bqint_dword;
+#elif BQINT_WORD_BITS == 32
+typedef uint32_t bqint_word;
+typedef uint64_t bqint_dword;
+#elif BQINT_WORD_BITS == 16
+typedef uint16_t bqint_word;
+typedef uint32_t bqint_dword;
+#elif BQINT_WORD_BITS == 8
+typedef uint8_t bqint_word;
+typedef uint16_t bqint_dword;
+#else
+#error "Unsupported BQINT_WORD_BITS"
+#endif
+
+// Current value of a BQINT_THRESHOLD_* crossover of this instance, the
+// BQINT_*_THRESHOLD macros unless overridden
+size_t bqint_get_threshold(int threshold);
+
+// Reset the crossovers of this instance to the BQINT_*_THRESHOLD macros and
+// override them from the environment variable BQINT_THRESHOLDS
+// (BQINTN_THRESHOLDS for the instance bqintN) if it's set, as a list such as
+// "gcd_lehmer=4,sqr=16". The environment is only read by this function.
+// Note: Not synchronized with other threads using this instance, call it
+// during startup.
+void bqint_load_thresholds(void);
+
+// Override a BQINT_THRESHOLD_* crossover of this instance at runtime
+void bqint_set_threshold(int threshold, size_t words);
+
 // -- Structure
 
+// Number of words stored inside the struct without allocating, by default
+// the space of the data pointer. Define BQINT_INLINE_BITS to make sure that
+// values up to that many bits never touch the heap (the struct grows to fit).
 #ifndef BQINT_INLINE_CAPACITY
-#define BQINT_INLINE_CAPACITY (sizeof(bqint_word*) / sizeof(bqint_word))
+	#ifdef BQINT_INLINE_BITS
+		#define BQINT__INLINE_BITS_WORDS ((BQINT_INLINE_BITS + BQINT_WORD_BITS - 1) / BQINT_WORD_BITS)
+		#define BQINT_INLINE_CAPACITY (BQINT__INLINE_BITS_WORDS > sizeof(bqint_word*) / sizeof(bqint_word) \
+				? BQINT__INLINE_BITS_WORDS : sizeof(bqint_word*) / sizeof(bqint_word))
+	#else
+		#define BQINT_INLINE_CAPACITY (sizeof(bqint_word*) / sizeof(bqint_word))
+	#endif
 #endif
 
 typedef struct bqint
@@ -115,10 +697,45 @@ bqint bqint_static(void *buffer, size_t size);
 // dynamically allocate a new one
 bqint bqint_dynamic_initial(void *buffer, size_t size);
 
+// Initialize a read-only view of `count` external words without copying them,
+// the words must be in native byte order with the least significant first
+// (on little-endian hosts this is plain little-endian data). High zero words
+// are trimmed by scanning down from the top, the rest of the data is not
+// touched. The view can be used as any const input, writing to it copies the
+// value to storage owned by the bqint first. The memory must outlive the view.
+bqint bqint_view(const bqint_word *words, size_t count);
+
+// Initialize a read-only view of `size` bytes of little-endian words of any
+// size without copying them, such as the words of a bqint of another instance
+// (see BQINT_REINTERPRET()). Only on little-endian hosts, `data` must be
+// aligned for bqint_word. A partial top word can't be viewed: it's left out
+// and the view is marked BQINT_TRUNCATED, copy such values with
+// bqint_set_bytes() instead.
+bqint bqint_view_le(const void *data, size_t size, int negative);
+
 // If the bqint has allocated it's own memory it must be released by this,
 // will also reset the value to zero
 void bqint_free(bqint *a);
 
+// -- Storage
+
+// Make sure that `a` has storage for at least `words` words without changing
+// the value, useful for preallocating before loops that grow the value.
+// Static values are never resized.
+void bqint_reserve(bqint *a, bqint_size words);
+
+// Release the unused storage of `a`, moves the value to the inline buffer
+// if it fits there
+void bqint_shrink_to_fit(bqint *a);
+
+// Move the value of `a` to reference counted storage. Copies made from it with
+// bqint_set() share the words instead of copying them, and the first
+// operation that writes to a copy (or to `a`) gives it storage of its own.
+// The reference count is atomic so the copies can be used and freed from any
+// thread, but a single bqint still must not be written to from two threads.
+// Values that fit in the inline storage are left as is.
+void bqint_share(bqint *a);
+
 // -- Setting values
 
 // Set bqint to the value of another bqint
@@ -139,6 +756,35 @@ void bqint_set_i32(bqint *a, int32_t val);
 // size: Length of the number in bytes
 void bqint_set_raw(bqint *a, const void *data, size_t size);
 
+// Byte order flags for bqint_set_bytes() and bqint_get_bytes()
+#ifndef BQINT__BYTES_DEFINED
+#define BQINT__BYTES_DEFINED
+enum
+{
+	BQINT_BYTES_LITTLE_ENDIAN = 0,
+	BQINT_BYTES_BIG_ENDIAN = 1 << 0,
+
+	// bqint_get_bytes(): Pad the output to exactly `size` bytes with zeroes
+	BQINT_BYTES_PAD = 1 << 1,
+};
+#endif
+
+// Set bqint to the non-negative value of `size` bytes in `data`
+// order: BQINT_BYTES_LITTLE_ENDIAN or BQINT_BYTES_BIG_ENDIAN
+void bqint_set_bytes(bqint *a, const void *data, size_t size, int order);
+
+// -- Exporting values
+
+// Returns the number of bytes needed to store the magnitude of `a`
+size_t bqint_byte_size(const bqint *a);
+
+// Write the magnitude of `a` into `data`, which has room for `size` bytes
+// order: BQINT_BYTES_LITTLE_ENDIAN or BQINT_BYTES_BIG_ENDIAN, optionally
+// combined with BQINT_BYTES_PAD to zero-pad the number to `size` bytes.
+// Returns the number of bytes written. If the value doesn't fit nothing is
+// written and the required size (larger than `size`) is returned instead.
+size_t bqint_get_bytes(const bqint *a, void *data, size_t size, int order);
+
 // -- Arithmetic
 
 // Add bqints result and a and store the value in result
@@ -162,25 +808,396 @@ void bqint_mul(bqint *result, const bqint *a, const bqint *b);
 void bqint_sub(bqint *result, const bqint *a, const bqint *b);
 
 // Shift the bits of result right and store the value in result
+// Negative values are rounded towards negative infinity (two's complement)
 // result = result >> shift
-void bqint_shr_inplace(bqint *result, bqint_size shift);
+void bqint_shr_inplace(bqint *result, size_t shift);
+
+// Shift the bits of a right and store the value in result
+// Negative values are rounded towards negative infinity (two's complement)
+// result = a >> shift
+void bqint_shr(bqint *result, const bqint *a, size_t shift);
+
+// Shift the bits of result left and store the value in result
+// result = result << shift
+void bqint_shl_inplace(bqint *result, size_t shift);
+
+// Shift the bits of a left and store the value in result
+// result = a << shift
+void bqint_shl(bqint *result, const bqint *a, size_t shift);
+
+// -- Bitwise logic
+
+// Negative values behave as if they were infinitely sign extended two's
+// complement numbers. Non-negative operands use straight word loops that
+// compilers can vectorize.
+
+// result = a & b
+void bqint_and(bqint *result, const bqint *a, const bqint *b);
+
+// result = result & a
+void bqint_and_inplace(bqint *result, const bqint *a);
+
+// result = a | b
+void bqint_or(bqint *result, const bqint *a, const bqint *b);
+
+// result = result | a
+void bqint_or_inplace(bqint *result, const bqint *a);
+
+// result = a ^ b
+void bqint_xor(bqint *result, const bqint *a, const bqint *b);
+
+// result = result ^ a
+void bqint_xor_inplace(bqint *result, const bqint *a);
+
+// result = a & ~b
+void bqint_andnot(bqint *result, const bqint *a, const bqint *b);
+
+// result = result & ~a
+void bqint_andnot_inplace(bqint *result, const bqint *a);
+
+// result = ~a (equal to -a - 1)
+void bqint_not(bqint *result, const bqint *a);
+
+// -- Bits
+
+// The bit queries work on the magnitude of the value, bit 0 is the least
+// significant bit. Setting and clearing bits keeps the sign.
+
+// Returned by bqint_scan1() if there are no set bits
+#define BQINT_BIT_NONE ((size_t)-1)
+
+// Number of significant bits in the magnitude, zero for zero
+size_t bqint_bit_length(const bqint *a);
+
+// Number of set bits in the magnitude
+size_t bqint_popcount(const bqint *a);
+
+// Number of trailing zero bits in the magnitude, zero for zero
+size_t bqint_ctz(const bqint *a);
+
+// Returns non-zero if `bit` is set in the magnitude
+int bqint_test_bit(const bqint *a, size_t bit);
+
+// Set `bit` in the magnitude, grows the value if needed
+void bqint_set_bit(bqint *a, size_t bit);
+
+// Clear `bit` in the magnitude
+void bqint_clear_bit(bqint *a, size_t bit);
+
+// Index of the first set bit at or above `start`, BQINT_BIT_NONE if none
+size_t bqint_scan1(const bqint *a, size_t start);
+
+// Index of the first clear bit at or above `start`
+size_t bqint_scan0(const bqint *a, size_t start);
+
+// -- Random numbers
+
+// Random source for the bqint_random_*() functions, must fill `size` bytes at
+// `data` with uniformly random bits. The words are filled directly.
+typedef void (*bqint_random_fn)(void *user, void *data, size_t size);
+
+// Uniformly random non-negative value with at most `bits` bits
+void bqint_random_bits(bqint *a, size_t bits, bqint_random_fn rng, void *user);
+
+// Uniformly random value in range [0, |bound|), a zero bound sets
+// BQINT_DOMAIN_ERROR. Uses rejection sampling that generates the top word
+// first and draws the rest of the words only if it does not reject.
+void bqint_random_below(bqint *a, const bqint *bound, bqint_random_fn rng, void *user);
+
+// -- Division
+
+// Divide a by b rounding towards zero, the remainder has the sign of a
+// quot = a / b, rem = a % b
+// Either of the results may be NULL (but not both the same bqint).
+// Dividing by zero sets BQINT_DIV_BY_ZERO and the results to zero.
+void bqint_divmod(bqint *quot, bqint *rem, const bqint *a, const bqint *b);
+
+// result = a / b
+void bqint_div(bqint *result, const bqint *a, const bqint *b);
+
+// result = a % b
+void bqint_mod(bqint *result, const bqint *a, const bqint *b);
+
+// result = a / b for a `b` that is known to divide `a`, the result is
+// meaningless otherwise. The quotient is computed from the low words up with
+// the inverse of the divisor modulo 2^BQINT_WORD_BITS (Jebelean's exact
+// division) which is about as fast as a multiplication and needs no
+// normalization.
+void bqint_divexact(bqint *result, const bqint *a, const bqint *b);
+
+// result = a / d for a word `d` that is known to divide `a`
+void bqint_divexact_word(bqint *result, const bqint *a, bqint_word d);
+
+// -- Number theory
+
+// Greatest common divisor of the magnitudes of a and b
+// result = gcd(a, b)
+void bqint_gcd(bqint *result, const bqint *a, const bqint *b);
+
+// Extended GCD: g = gcd(a, b) = a * s + b * t
+// The cofactors are the ones the Euclidean algorithm produces, ie.
+// |s| <= |b| / (2 g) and |t| <= |a| / (2 g). Any result may be NULL.
+void bqint_gcdext(bqint *g, bqint *s, bqint *t, const bqint *a, const bqint *b);
+
+// Modular inverse: result * a = 1 (mod m), 0 <= result < |m|
+// Returns zero (and sets result to zero) if a is not invertible modulo m.
+int bqint_invmod(bqint *result, const bqint *a, const bqint *m);
+
+// -- Powers
+
+// The size of the result is computed up front so the powers are allocated only
+// once. Factors of two in the base are stripped and applied as a final shift,
+// the odd part is raised with squarings and a sliding window of odd powers.
+
+// result = base^exp, 0^0 = 1
+void bqint_pow(bqint *result, const bqint *base, uint32_t exp);
+
+// result = base^exp
+void bqint_pow_word(bqint *result, uint32_t base, uint32_t exp);
+
+// result = base^exp mod |mod|, 0 <= result < |mod|
+// Odd moduli use Montgomery multiplication with a sliding window. Negative
+// exponents use the inverse of the base, or set BQINT_DOMAIN_ERROR if it's not
+// invertible. A zero modulus sets BQINT_DIV_BY_ZERO.
+void bqint_powmod(bqint *result, const bqint *base, const bqint *exp, const bqint *mod);
+
+// result = bases[0]^exps[0] bases[1]^exps[1] ... bases[count - 1]^exps[count - 1]
+// mod |mod|, 0 <= result < |mod|, 1 mod |mod| if count is 0. All the terms share
+// one chain of squarings in Montgomery form: Few terms are interleaved with a
+// sliding window table per base (Straus) and many terms are collected into
+// buckets by their exponent digits (Pippenger), picked by the estimated number
+// of multiplications. Negative exponents and errors are handled as in
+// bqint_powmod(), even moduli multiply the separate powers.
+void bqint_multi_powmod(bqint *result, const bqint *bases, const bqint *exps, size_t count, const bqint *mod);
+
+// -- Products
+
+// The factors are multiplied in a balanced tree so that the operands of each
+// multiplication have similar sizes. Runs of single word factors are packed
+// into full words before building the tree.
+
+// result = factors[0] * factors[1] * ... * factors[count - 1], 1 if count is 0
+void bqint_product(bqint *result, const bqint *factors, size_t count);
+
+// result = words[0] * words[1] * ... * words[count - 1], 1 if count is 0
+void bqint_product_words(bqint *result, const bqint_word *words, size_t count);
+
+// result = a[0] * b[0] + a[1] * b[1] + ... + a[count - 1] * b[count - 1], 0 if
+// count is 0. The sum is accumulated in the storage of `result` sized once for
+// the largest term: the rows of each product are added (or subtracted) in
+// place as two's complement and the carries out of the rows are collected in
+// double word lanes that are folded in only when they could overflow. Terms
+// where both operands are the same value are squared.
+void bqint_dot(bqint *result, const bqint *a, const bqint *b, size_t count);
+
+// Callback of bqint_bsplit(), sets `p`, `q` and `a` to the values of term `n`
+typedef void (*bqint_series_fn)(void *user, size_t n, bqint *p, bqint *q, bqint *a);
+
+// Binary splitting of the series sum
+//   S = sum a(n) p(begin) ... p(n) / (q(begin) ... q(n)), begin <= n < end
+// into the integers p = p(begin) ... p(end - 1), q = q(begin) ... q(end - 1)
+// and t = q S. The terms may be negative. The halves are evaluated and
+// combined recursively (t = q_right t_left + p_left t_right) reusing the same
+// scratch values on every level. Any result may be NULL.
+void bqint_bsplit(bqint *p, bqint *q, bqint *t, size_t begin, size_t end,
+		bqint_series_fn term, void *user);
+
+// -- Roots
+
+// The roots are computed with Newton's iteration, recursing on the top half of
+// the bits for the initial estimate so that the full size iterations start
+// with half of the bits already correct. Roots of negative values (other than
+// odd roots in bqint_root()) set BQINT_DOMAIN_ERROR.
+
+// result = floor(sqrt(a))
+void bqint_sqrt(bqint *result, const bqint *a);
+
+// root = floor(sqrt(a)), rem = a - root^2
+// Either of the results may be NULL.
+void bqint_sqrtrem(bqint *root, bqint *rem, const bqint *a);
+
+// result = floor(a^(1/k)), odd roots of negative values are rounded towards zero
+void bqint_root(bqint *result, const bqint *a, uint32_t k);
+
+// Returns non-zero if `a` is a perfect square. Most non-squares are rejected
+// by their residues modulo 64, 63, 65 and 11 without computing the root.
+int bqint_is_square(const bqint *a);
+
+// -- Primes
+
+// Trial division by the primes below 1024 (reducing the value once per group
+// of primes that fits in a word) followed by the Baillie-PSW test: a strong
+// probable prime test to base 2 and a strong Lucas test, both with Montgomery
+// multiplication. There are no known composites that pass it, and it's exact
+// for values below 2^64.
+
+// Returns 1 if `a` is a probable prime and 0 if not, values below 2 are not
+// prime. Returns -1 if the test couldn't allocate its temporaries, so callers
+// must not treat the result as a plain truth value.
+int bqint_is_probable_prime(const bqint *a);
+
+// result = the smallest probable prime greater than `a`. Windows of candidates
+// are sieved with the small primes before testing the remaining ones.
+void bqint_next_prime(bqint *result, const bqint *a);
+
+// -- Residue number system
+
+// A residue number system stores values as their residues modulo a set of
+// word sized primes (channels). Addition, subtraction and multiplication
+// work on each channel independently without carries, the loops over the
+// channels have no dependencies between iterations. Conversion back uses
+// Garner's algorithm with precomputed inverses.
+// Values are reconstructed in the symmetric range |value| <= (M - 1) / 2
+// where M is the product of the primes.
+
+typedef struct bqint_rns
+{
+	bqint_word *primes;   // Moduli, largest first
+	bqint_word *inverses; // (primes[0] * ... * primes[i - 1])^-1 mod primes[i]
+	size_t count;         // Number of channels (words per value)
+	bqint modulus;        // Product of the primes
+	bqint half;           // (modulus - 1) / 2
+} bqint_rns;
+
+// Initialize a residue number system that can represent values with
+// |value| < 2^bits, picks the largest primes below 2^BQINT_WORD_BITS.
+// Returns zero if there are not enough word sized primes or the memory
+// allocation fails.
+int bqint_rns_init(bqint_rns *rns, size_t bits);
+
+// Release the tables of a residue number system
+void bqint_rns_free(bqint_rns *rns);
+
+// Convert `a` to `rns->count` residues, the value must be in range
+void bqint_rns_set(const bqint_rns *rns, bqint_word *residues, const bqint *a);
+
+// Convert residues back to a value
+void bqint_rns_get(const bqint_rns *rns, bqint *result, const bqint_word *residues);
+
+// result = a + b (per channel), the arrays may overlap exactly
+void bqint_rns_add(const bqint_rns *rns, bqint_word *result, const bqint_word *a, const bqint_word *b);
+
+// result = a - b (per channel), the arrays may overlap exactly
+void bqint_rns_sub(const bqint_rns *rns, bqint_word *result, const bqint_word *a, const bqint_word *b);
+
+// result = a * b (per channel), the arrays may overlap exactly
+void bqint_rns_mul(const bqint_rns *rns, bqint_word *result, const bqint_word *a, const bqint_word *b);
+
+// -- Prime field elements
+
+// Arithmetic modulo one of the fixed BQINT_FIELD_* primes. The elements are
+// arrays of words that are always fully reduced to [0, p), the operations
+// don't allocate and the results may alias the inputs. Products are computed
+// with the word kernels and reduced using the sparse form of the prime: the
+// high half is folded to the low half as 32-bit chunk sums (the NIST fast
+// reduction for P-256 and P-384, 2^N = c (mod p) for small c otherwise).
+// `field` must be one of the BQINT_FIELD_* values.
+
+// Number of words in an element, enough for every field
+#define BQINT_FE_WORDS (48 / sizeof(bqint_word))
+
+typedef struct bqint_fe
+{
+	bqint_word words[BQINT_FE_WORDS]; // Only the first bqint_fe_size() are used
+} bqint_fe;
+
+// Number of words used by the elements of `field`
+bqint_size bqint_fe_size(int field);
+
+// Set `result` to the prime of `field`
+void bqint_fe_prime(int field, bqint *result);
+
+// r = a mod p for any `a`, negative values are reduced to [0, p) as well
+void bqint_fe_set(int field, bqint_fe *r, const bqint *a);
+
+// r = val mod p
+void bqint_fe_set_u32(int field, bqint_fe *r, uint32_t val);
+
+// Convert an element back to a (non-negative) bqint
+void bqint_fe_get(int field, bqint *result, const bqint_fe *a);
+
+// Returns non-zero if a == b
+int bqint_fe_equal(int field, const bqint_fe *a, const bqint_fe *b);
+
+// r = a + b mod p
+void bqint_fe_add(int field, bqint_fe *r, const bqint_fe *a, const bqint_fe *b);
+
+// r = a - b mod p
+void bqint_fe_sub(int field, bqint_fe *r, const bqint_fe *a, const bqint_fe *b);
+
+// r = a b mod p
+void bqint_fe_mul(int field, bqint_fe *r, const bqint_fe *a, const bqint_fe *b);
+
+// r = a^2 mod p
+void bqint_fe_sqr(int field, bqint_fe *r, const bqint_fe *a);
+
+// r = a^-1 mod p computed as a^(p - 2), the inverse of zero is zero
+void bqint_fe_inv(int field, bqint_fe *r, const bqint_fe *a);
+
+// -- Accumulator
+
+// Sums many values without propagating carries on every add. Each word of
+// the sum is kept in a double word lane, so an add is a lane-wise loop with
+// no dependencies between the words. The carries are propagated only when
+// the headroom of the lanes runs out (every 2^BQINT_WORD_BITS - 2 adds) or
+// when the sum is read. Negative values go to a separate set of lanes.
+
+typedef struct bqint_accumulator
+{
+	bqint_dword *lanes;  // Positive lanes followed by the negative lanes
+	size_t size;         // Number of lanes in use (of each sign)
+	size_t capacity;     // Number of allocated lanes (of each sign)
+	size_t pending;      // Adds since the carries were last propagated
+	bqint_flags flags;   // Error flags of the added values and allocations
+} bqint_accumulator;
+
+// Initialize an empty accumulator (with the value zero)
+void bqint_accumulator_init(bqint_accumulator *acc);
+
+// Release the lanes of an accumulator
+void bqint_accumulator_free(bqint_accumulator *acc);
+
+// Reset the sum to zero keeping the allocated lanes
+void bqint_accumulator_clear(bqint_accumulator *acc);
+
+// acc = acc + a
+void bqint_accumulator_add(bqint_accumulator *acc, const bqint *a);
+
+// acc = acc + word
+void bqint_accumulator_add_word(bqint_accumulator *acc, bqint_word word);
+
+// Propagate the carries and store the sum in `result`
+void bqint_accumulator_get(bqint_accumulator *acc, bqint *result);
 
 // -- Compares
 
 // Compare bqints, positive if a > b, negative if a < b, zero if equal
 int bqint_cmp(const bqint *a, const bqint *b);
 
+// -- Sorting
+
+// Sort `count` values in increasing order (as bqint_cmp()). The values are
+// radix sorted on a fixed-width key of the sign, size and top 64 bits of the
+// magnitude, only the values with equal keys are compared in full. Falls back
+// to qsort() if the key buffers can't be allocated.
+void bqint_sort(bqint *array, size_t count);
+
+// Remove the repeats of equal values from a sorted array, returns the number
+// of distinct values which are moved to the front. The values after them are
+// freed, so the whole array can still be freed as before.
+size_t bqint_unique(bqint *array, size_t count);
+
 // -- Queries
 
 // Returns a non-zero value if the value is what it's supposed to be represented
 // ie. no error or truncation of the value has happened.
-inline static int bqint_ok(const bqint *a)
+BQINT__UNUSED inline static int bqint_ok(const bqint *a)
 {
 	return (a->flags & BQINT_ERROR) == 0;
 }
 
 // Get the size of the bqint in words
-static inline size_t bqint_get_size(const bqint *a)
+BQINT__UNUSED static inline size_t bqint_get_size(const bqint *a)
 {
 	return a->size;
 }
@@ -189,7 +1206,7 @@ static inline size_t bqint_get_size(const bqint *a)
 // bqint_get_size() returns the number of words returned
 // Note: This breaks strict constness!
 // TODO: bqint_get_const_words?
-static inline bqint_word *bqint_get_words(const bqint *a)
+BQINT__UNUSED static inline bqint_word *bqint_get_words(const bqint *a)
 {
 	if (a->flags & BQINT_INLINED) {
 		return (bqint_word*)a->data.inline_words;
@@ -207,15 +1224,78 @@ static inline bqint_word *bqint_get_words(const bqint *a)
 // returns: NULL on success, pointer to first invalid char if failed
 const char *bqint_parse_string(bqint *a, const char *str, int base);
 
-// -- Allocators
+// Returns an upper bound for the size of the string of `a` in `base` (2 to 36)
+// including the sign and the zero terminator
+size_t bqint_string_size(const bqint *a, int base);
 
-typedef void*(*bqint_alloc_fn)(size_t);
-typedef void*(*bqint_realloc_fn)(void *, size_t copy_size, size_t new_size);
-typedef void(*bqint_free_fn)(void*);
+// Write `a` to `buffer` as a zero-terminated string of digits in `base` (2 to
+// 36, digits past 9 are a-z) with a leading '-' if it's negative. Returns the
+// length of the string. If `size` is less than bqint_string_size() nothing is
+// written and the required size (larger than `size`) is returned instead.
+// The digits are produced by repeated division by the largest power of the
+// base that fits in a word.
+size_t bqint_get_string(const bqint *a, char *buffer, size_t size, int base);
 
-// Set global allocators for bqint functions
-// Note: If realloc_fn is 0, then a default one will be provided using alloc_fn and free_fn
-void bqint_set_allocators(bqint_alloc_fn alloc_fn, bqint_free_fn free_fn, bqint_realloc_fn realloc_fn);
+// -- Jobs
+
+// Jobs run a long operation as a state machine in bounded steps, so that the
+// work can be interleaved with other work on the same thread and cancelled.
+// The work is measured in word operations (word multiplications or divisions).
+// The operands are copied when the job is set up, the result is written only
+// when the job finishes. Finished and cancelled jobs hold no memory.
+
+#ifndef BQINT__JOBS_DEFINED
+#define BQINT__JOBS_DEFINED
+enum
+{
+	BQINT_JOB_MUL,
+	BQINT_JOB_POWMOD,
+	BQINT_JOB_GET_STRING,
+};
+
+enum
+{
+	BQINT_JOB_RUNNING,
+	BQINT_JOB_DONE,
+	BQINT_JOB_CANCELLED,
+};
+#endif
+
+typedef struct bqint_job
+{
+	int type;        // BQINT_JOB_*
+	int status;      // BQINT_JOB_RUNNING, BQINT_JOB_DONE or BQINT_JOB_CANCELLED
+	uint64_t done;   // Word operations done so far
+	uint64_t total;  // Estimate of the word operations of the whole job
+	size_t length;   // Return value of bqint_get_string() for string jobs
+
+	// Internal state
+	bqint *result;
+	char *buffer;
+	size_t size, pos, pending;
+	int phase, index, param;
+	bqint_word word;
+	bqint values[5];
+} bqint_job;
+
+// Set up a job computing result = a * b
+void bqint_job_mul(bqint_job *job, bqint *result, const bqint *a, const bqint *b);
+
+// Set up a job computing result = base^exp mod |mod|, see bqint_powmod().
+// The base is reduced (and inverted for negative exponents) during the setup.
+void bqint_job_powmod(bqint_job *job, bqint *result, const bqint *base,
+		const bqint *exp, const bqint *mod);
+
+// Set up a job writing `a` to `buffer`, see bqint_get_string()
+void bqint_job_get_string(bqint_job *job, char *buffer, size_t size, const bqint *a, int base);
+
+// Run the job for about `budget` word operations (at least one unit of
+// progress, such as a row of a multiplication, is made even if `budget` is
+// zero). Returns the status of the job.
+int bqint_job_step(bqint_job *job, uint64_t budget);
+
+// Stop a running job and release its memory, the result is not touched
+void bqint_job_cancel(bqint_job *job);
 
 #endif
 
@@ -226,25 +1306,10 @@ void bqint_set_allocators(bqint_alloc_fn alloc_fn, bqint_free_fn free_fn, bqint_
 #include <string.h>
 #include <stdlib.h>
 
-#define BQINT__HI(dw) ((dw) >> BQINT_WORD_BITS)
-#define BQINT__LO(dw) ((dw) & (((bqint_dword)1 << BQINT_WORD_BITS) - 1))
-
-#define BQINT__BYTESWAP_32(w) ((w) << 24 | ((w) & 0x0000FF00U) << 8 \
-		| ((w) & 0x00FF0000U) >> 8 | ((w) >> 24))
-#define BQINT__BYTESWAP_16(w) ((w) << 8 | (w) >> 8)
-
-#if BQINT_WORD_BITS == 32
-#define BQINT__BYTESWAP_WORD(w) BQINT__BYTESWAP_32(w)
-#elif BQINT_WORD_BITS == 16
-#define BQINT__BYTESWAP_WORD(w) BQINT__BYTESWAP_16(w)
-#elif BQINT_WORD_BITS == 8
-#define BQINT__BYTESWAP_WORD(w) (w)
-#endif
-
-static void* bqint__stdlib_realloc(void *memory, size_t copy_size, size_t new_size)
-{
-	return realloc(memory, new_size);
-}
+static void* bqint__stdlib_realloc(void *memory, size_t copy_size, size_t new_size)
+{
+	return realloc(memory, new_size);
+}
 
 static bqint_alloc_fn bqint_alloc_memory = malloc;
 static bqint_free_fn bqint_free_memory = free;
@@ -269,12 +1334,554 @@ void bqint_set_allocators(bqint_alloc_fn alloc_fn, bqint_free_fn free_fn, bqint_
 	bqint_realloc_memory = realloc_fn ? realloc_fn : bqint__default_user_realloc;
 }
 
+#ifdef BQINT_POOL
+
+#ifndef BQINT_THREAD_LOCAL
+	#if defined(_MSC_VER)
+		#define BQINT_THREAD_LOCAL __declspec(thread)
+	#elif defined(__GNUC__)
+		#define BQINT_THREAD_LOCAL __thread
+	#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+		#define BQINT_THREAD_LOCAL _Thread_local
+	#else
+		#error "No thread-local storage available, define BQINT_THREAD_LOCAL"
+	#endif
+#endif
+
+#define BQINT__POOL_MIN_CLASS 4
+#define BQINT__POOL_LARGE 0
+
+// Header in front of every block, the union keeps the user data aligned
+typedef union bqint__pool_header
+{
+	size_t size_class;
+	void *align_ptr;
+	double align_double;
+	long double align_long_double;
+	uint64_t align_u64;
+} bqint__pool_header;
+
+typedef struct bqint__pool_block
+{
+	struct bqint__pool_block *next;
+} bqint__pool_block;
+
+static BQINT_THREAD_LOCAL bqint__pool_block *bqint__pool_lists[BQINT_POOL_MAX_CLASS + 1];
+static BQINT_THREAD_LOCAL unsigned bqint__pool_counts[BQINT_POOL_MAX_CLASS + 1];
+
+static size_t bqint__pool_class(size_t size)
+{
+	size_t size_class = BQINT__POOL_MIN_CLASS;
+	while (((size_t)1 << size_class) < size) {
+		size_class++;
+		if (size_class > BQINT_POOL_MAX_CLASS)
+			return BQINT__POOL_LARGE;
+	}
+	return size_class;
+}
+
+void *bqint_pool_alloc(size_t size)
+{
+	size_t size_class = bqint__pool_class(size);
+	bqint__pool_header *hdr;
+
+	if (size_class != BQINT__POOL_LARGE) {
+		bqint__pool_block *block = bqint__pool_lists[size_class];
+		if (block) {
+			bqint__pool_lists[size_class] = block->next;
+			bqint__pool_counts[size_class]--;
+			return block;
+		}
+		size = (size_t)1 << size_class;
+	}
+
+	hdr = (bqint__pool_header*)malloc(sizeof(bqint__pool_header) + size);
+	if (!hdr)
+		return 0;
+
+	hdr->size_class = size_class;
+	return hdr + 1;
+}
+
+void bqint_pool_free(void *memory)
+{
+	bqint__pool_header *hdr;
+	size_t size_class;
+
+	if (!memory)
+		return;
+
+	hdr = (bqint__pool_header*)memory - 1;
+	size_class = hdr->size_class;
+
+	if (size_class != BQINT__POOL_LARGE && bqint__pool_counts[size_class] < BQINT_POOL_MAX_CACHED) {
+		bqint__pool_block *block = (bqint__pool_block*)memory;
+		block->next = bqint__pool_lists[size_class];
+		bqint__pool_lists[size_class] = block;
+		bqint__pool_counts[size_class]++;
+	} else {
+		free(hdr);
+	}
+}
+
+void *bqint_pool_realloc(void *memory, size_t copy_size, size_t new_size)
+{
+	void *new_mem;
+
+	if (!memory)
+		return bqint_pool_alloc(new_size);
+
+	// Fits in the current size class: Nothing to do
+	{
+		bqint__pool_header *hdr = (bqint__pool_header*)memory - 1;
+		size_t size_class = hdr->size_class;
+		if (size_class != BQINT__POOL_LARGE && new_size <= ((size_t)1 << size_class))
+			return memory;
+	}
+
+	new_mem = bqint_pool_alloc(new_size);
+	if (!new_mem)
+		return 0;
+
+	memcpy(new_mem, memory, new_size < copy_size ? new_size : copy_size);
+	bqint_pool_free(memory);
+	return new_mem;
+}
+
+void bqint_pool_trim(void)
+{
+	size_t size_class;
+	for (size_class = BQINT__POOL_MIN_CLASS; size_class <= BQINT_POOL_MAX_CLASS; size_class++) {
+		bqint__pool_block *block = bqint__pool_lists[size_class];
+		while (block) {
+			bqint__pool_block *next = block->next;
+			free((bqint__pool_header*)block - 1);
+			block = next;
+		}
+		bqint__pool_lists[size_class] = 0;
+		bqint__pool_counts[size_class] = 0;
+	}
+}
+
+#endif
+
+static const char *bqint__stat_op_names[] = {
+	"set",
+	"add",
+	"add_inplace",
+	"mul",
+	"mul_inplace",
+	"sub",
+	"shr",
+	"shl",
+	"and",
+	"or",
+	"xor",
+	"andnot",
+	"not",
+	"cmp",
+	"divmod",
+	"gcd",
+	"gcdext",
+	"invmod",
+	"pow",
+	"product",
+	"bsplit",
+	"sqrtrem",
+	"root",
+	"rns_set",
+	"rns_get",
+	"accumulate",
+	"accumulator_get",
+	"random",
+	"powmod",
+	"prime",
+	"next_prime",
+	"divexact",
+	"job_step",
+	"dot",
+	"sort",
+	"multi_powmod",
+};
+
+const char *bqint_stats_op_name(int op)
+{
+	if (op < 0 || op >= BQINT_STAT_NUM_OPS)
+		return "unknown";
+	return bqint__stat_op_names[op];
+}
+
+static const char *const bqint__threshold_names[] = {
+	"gcd_lehmer",
+	"sqr",
+};
+
+const char *bqint_threshold_name(int threshold)
+{
+	if (threshold < 0 || threshold >= BQINT_THRESHOLD_NUM)
+		return "unknown";
+	return bqint__threshold_names[threshold];
+}
+
+#ifdef BQINT_STATS
+
+#ifdef BQINT_STATS_CYCLES
+#ifndef BQINT_CYCLE_COUNTER
+	#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		#include <intrin.h>
+		#define BQINT_CYCLE_COUNTER() ((uint64_t)__rdtsc())
+	#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		#include <x86intrin.h>
+		#define BQINT_CYCLE_COUNTER() ((uint64_t)__rdtsc())
+	#elif defined(__GNUC__) && defined(__aarch64__)
+		static uint64_t bqint__read_cntvct()
+		{
+			uint64_t val;
+			__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+			return val;
+		}
+		#define BQINT_CYCLE_COUNTER() bqint__read_cntvct()
+	#else
+		#error "No cycle counter available, define BQINT_CYCLE_COUNTER()"
+	#endif
+#endif
+#endif
+
+static bqint_stats bqint__stats;
+
+static unsigned bqint__stats_bucket(uint64_t val, unsigned num_buckets)
+{
+	unsigned bucket = 0;
+	while (val) {
+		bucket++;
+		val >>= 1;
+	}
+	return bucket < num_buckets ? bucket : num_buckets - 1;
+}
+
+static uint64_t bqint__stats_begin(int op, bqint_size size)
+{
+	bqint_op_stats *s = &bqint__stats.ops[op];
+	s->calls++;
+	s->size_histogram[bqint__stats_bucket(size, BQINT_STATS_SIZE_BUCKETS)]++;
+
+#ifdef BQINT_STATS_CYCLES
+	return BQINT_CYCLE_COUNTER();
+#else
+	return 0;
+#endif
+}
+
+static void bqint__stats_end(int op, uint64_t begin)
+{
+#ifdef BQINT_STATS_CYCLES
+	bqint_op_stats *s = &bqint__stats.ops[op];
+	uint64_t cycles = BQINT_CYCLE_COUNTER() - begin;
+	s->cycles += cycles;
+	s->latency_histogram[bqint__stats_bucket(cycles, BQINT_STATS_LATENCY_BUCKETS)]++;
+#endif
+}
+
+static void bqint__stats_error(bqint_flags flags)
+{
+	if (flags & BQINT_TRUNCATED) bqint__stats.truncated++;
+	if (flags & BQINT_OUT_OF_MEMORY) bqint__stats.out_of_memory++;
+	if (flags & BQINT_DIV_BY_ZERO) bqint__stats.div_by_zero++;
+	if (flags & BQINT_PARSE_FAILED) bqint__stats.parse_failed++;
+	if (flags & BQINT_DOMAIN_ERROR) bqint__stats.domain_error++;
+}
+
+void bqint_stats_snapshot(bqint_stats *stats)
+{
+	*stats = bqint__stats;
+}
+
+void bqint_stats_reset(void)
+{
+	memset(&bqint__stats, 0, sizeof(bqint__stats));
+}
+
+// Declare the timer in the declarations of the function, then wrap the body
+// in BQINT__STAT_BEGIN() and BQINT__STAT_END()
+#define BQINT__STAT_TIMER uint64_t bqint__stat_begin;
+#define BQINT__STAT_BEGIN(op, size) (bqint__stat_begin = bqint__stats_begin((op), (size)))
+#define BQINT__STAT_END(op) bqint__stats_end((op), bqint__stat_begin)
+#define BQINT__STAT_ERROR(flags) bqint__stats_error(flags)
+#define BQINT__STAT_ALLOC(bytes) (bqint__stats.allocs++, bqint__stats.bytes_allocated += (bytes))
+#define BQINT__STAT_REALLOC(old_bytes, new_bytes) (bqint__stats.reallocs++, \
+		bqint__stats.bytes_freed += (old_bytes), bqint__stats.bytes_allocated += (new_bytes))
+#define BQINT__STAT_FREE(bytes) (bqint__stats.frees++, bqint__stats.bytes_freed += (bytes))
+
+#else
+
+void bqint_stats_snapshot(bqint_stats *stats)
+{
+	memset(stats, 0, sizeof(bqint_stats));
+}
+
+void bqint_stats_reset(void)
+{
+}
+
+#define BQINT__STAT_TIMER
+#define BQINT__STAT_BEGIN(op, size) ((void)0)
+#define BQINT__STAT_END(op) ((void)0)
+#define BQINT__STAT_ERROR(flags) ((void)0)
+#define BQINT__STAT_ALLOC(bytes) ((void)0)
+#define BQINT__STAT_REALLOC(old_bytes, new_bytes) ((void)0)
+#define BQINT__STAT_FREE(bytes) ((void)0)
+
+#endif
+
+// Atomically add `value` to the long at `ptr` and return the new value, define
+// for compilers without GCC or MSVC intrinsics
+#ifndef BQINT_ATOMIC_ADD
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define BQINT_ATOMIC_ADD(ptr, value) (_InterlockedExchangeAdd((ptr), (value)) + (value))
+	#elif defined(__GNUC__)
+		#define BQINT_ATOMIC_ADD(ptr, value) __sync_add_and_fetch((ptr), (value))
+	#else
+		#error "No atomic operations available, define BQINT_ATOMIC_ADD"
+	#endif
+#endif
+
+// Header in front of the words of shared storage, the union keeps the words
+// aligned
+typedef union bqint__shared
+{
+	struct {
+		volatile long refs;
+		size_t bytes;
+	} info;
+	void *align_ptr;
+	double align_double;
+	long double align_long_double;
+	uint64_t align_u64;
+} bqint__shared;
+
+#define BQINT__SHARED_HEADER(words) ((bqint__shared*)(void*)(words) - 1)
+
+// Drop a reference to shared storage, frees it when it was the last one
+static void bqint__shared_release(bqint__shared *shared)
+{
+	if (BQINT_ATOMIC_ADD(&shared->info.refs, -1) == 0) {
+		BQINT__STAT_FREE(shared->info.bytes);
+		bqint_free_memory(shared);
+	}
+}
+
+// Propagate the carries of the signed 32-bit chunk sums `t`, leaves every
+// chunk in [0, 2^32) and returns the carry out of the top one
+// Note: Assumes that right shifts of negative values are arithmetic
+static int64_t bqint__field_carry(int64_t *t, size_t num_chunks)
+{
+	int64_t carry = 0, v;
+	size_t i;
+
+	for (i = 0; i < num_chunks; i++) {
+		v = t[i] + carry;
+		t[i] = (int64_t)(uint32_t)v;
+		carry = (v - t[i]) >> 32;
+	}
+	return carry;
+}
+
+// The reductions of the 16 or 24 chunk products `c` to 8 or 12 chunks `t`
+// below 2^N. The carries out of the top are folded back with 2^N mod p until
+// there are none. 2^255 - 19 is reduced on whole words instead.
+
+// p = 2^256 - 2^32 - 977: 2^256 = 2^32 + 977 (mod p), the top chunk of the
+// shifted half is folded again directly
+static void bqint__field_reduce_secp256k1(int64_t *t, const uint32_t *c)
+{
+	int64_t k;
+	int i;
+
+	t[0] = c[0] + 977 * ((int64_t)c[8] + c[15]);
+	t[1] = c[1] + 977 * (int64_t)c[9] + c[8] + c[15];
+	for (i = 2; i < 8; i++)
+		t[i] = c[i] + 977 * (int64_t)c[i + 8] + c[i + 7];
+	while ((k = bqint__field_carry(t, 8)) != 0) {
+		t[0] += 977 * k;
+		t[1] += k;
+	}
+}
+
+// p = 2^256 - 2^224 + 2^192 + 2^96 - 1 (FIPS 186-4 D.2.3):
+// 2^256 = 2^224 - 2^192 - 2^96 + 1 (mod p)
+static void bqint__field_reduce_p256(int64_t *t, const uint32_t *c)
+{
+	int64_t k;
+
+	t[0] = (int64_t)c[0] + c[8] + c[9] - c[11] - c[12] - c[13] - c[14];
+	t[1] = (int64_t)c[1] + c[9] + c[10] - c[12] - c[13] - c[14] - c[15];
+	t[2] = (int64_t)c[2] + c[10] + c[11] - c[13] - c[14] - c[15];
+	t[3] = (int64_t)c[3] - c[8] - c[9] + 2 * (int64_t)c[11] + 2 * (int64_t)c[12] + c[13] - c[15];
+	t[4] = (int64_t)c[4] - c[9] - c[10] + 2 * (int64_t)c[12] + 2 * (int64_t)c[13] + c[14];
+	t[5] = (int64_t)c[5] - c[10] - c[11] + 2 * (int64_t)c[13] + 2 * (int64_t)c[14] + c[15];
+	t[6] = (int64_t)c[6] - c[8] - c[9] + c[13] + 3 * (int64_t)c[14] + 2 * (int64_t)c[15];
+	t[7] = (int64_t)c[7] + c[8] - c[10] - c[11] - c[12] - c[13] + 3 * (int64_t)c[15];
+	while ((k = bqint__field_carry(t, 8)) != 0) {
+		t[0] += k;
+		t[3] -= k;
+		t[6] -= k;
+		t[7] += k;
+	}
+}
+
+// p = 2^384 - 2^128 - 2^96 + 2^32 - 1 (FIPS 186-4 D.2.4):
+// 2^384 = 2^128 + 2^96 - 2^32 + 1 (mod p)
+static void bqint__field_reduce_p384(int64_t *t, const uint32_t *c)
+{
+	int64_t k;
+
+	t[0] = (int64_t)c[0] + c[12] + c[20] + c[21] - c[23];
+	t[1] = (int64_t)c[1] - c[12] + c[13] - c[20] + c[22] + c[23];
+	t[2] = (int64_t)c[2] - c[13] + c[14] - c[21] + c[23];
+	t[3] = (int64_t)c[3] + c[12] - c[14] + c[15] + c[20] + c[21] - c[22] - c[23];
+	t[4] = (int64_t)c[4] + c[12] + c[13] - c[15] + c[16] + c[20] + 2 * (int64_t)c[21] + c[22] - 2 * (int64_t)c[23];
+	t[5] = (int64_t)c[5] + c[13] + c[14] - c[16] + c[17] + c[21] + 2 * (int64_t)c[22] + c[23];
+	t[6] = (int64_t)c[6] + c[14] + c[15] - c[17] + c[18] + c[22] + 2 * (int64_t)c[23];
+	t[7] = (int64_t)c[7] + c[15] + c[16] - c[18] + c[19] + c[23];
+	t[8] = (int64_t)c[8] + c[16] + c[17] - c[19] + c[20];
+	t[9] = (int64_t)c[9] + c[17] + c[18] - c[20] + c[21];
+	t[10] = (int64_t)c[10] + c[18] + c[19] - c[21] + c[22];
+	t[11] = (int64_t)c[11] + c[19] + c[20] - c[22] + c[23];
+	while ((k = bqint__field_carry(t, 12)) != 0) {
+		t[0] += k;
+		t[1] -= k;
+		t[3] += k;
+		t[4] += k;
+	}
+}
+
+#endif
+
+#ifdef BQINT__IMPLEMENT
+
+#define BQINT__HI(dw) ((dw) >> BQINT_WORD_BITS)
+#define BQINT__LO(dw) ((dw) & (((bqint_dword)1 << BQINT_WORD_BITS) - 1))
+
+// Signed double word for cofactor arithmetic
+#if BQINT_WORD_BITS == 64
+__extension__ typedef __int128 bqint__sdword;
+#elif BQINT_WORD_BITS == 32
+typedef int64_t bqint__sdword;
+#elif BQINT_WORD_BITS == 16
+typedef int32_t bqint__sdword;
+#elif BQINT_WORD_BITS == 8
+typedef int16_t bqint__sdword;
+#endif
+
+// Wide word for the multi-row multiplication kernels, holds the product of a
+// word and BQINT__WIDE_ROWS words plus a carry
+#undef BQINT__WIDE_ROWS
+#undef BQINT__MUL_ROWS
+#if BQINT_WORD_BITS <= 16
+typedef uint64_t bqint__wide;
+#define BQINT__WIDE_ROWS (32 / BQINT_WORD_BITS)
+#elif BQINT_WORD_BITS == 32 && defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 bqint__wide;
+#define BQINT__WIDE_ROWS 2
+#endif
+
+// Maximum rows per pass of the schoolbook multiplication, with 64-bit words
+// the chained kernels don't beat a single row on the emulated double words
+#if BQINT_WORD_BITS == 64
+#define BQINT__MUL_ROWS 1
+#else
+#define BQINT__MUL_ROWS 4
+#endif
+
+#define BQINT__BYTESWAP_32(w) ((w) << 24 | ((w) & 0x0000FF00U) << 8 \
+		| ((w) & 0x00FF0000U) >> 8 | ((w) >> 24))
+#define BQINT__BYTESWAP_16(w) ((w) << 8 | (w) >> 8)
+#define BQINT__BYTESWAP_64(w) ((bqint_word)BQINT__BYTESWAP_32((uint32_t)(w)) << 32 \
+		| (bqint_word)BQINT__BYTESWAP_32((uint32_t)((w) >> 32)))
+
+#undef BQINT__BYTESWAP_WORD
+#if BQINT_WORD_BITS == 64
+#define BQINT__BYTESWAP_WORD(w) BQINT__BYTESWAP_64(w)
+#elif BQINT_WORD_BITS == 32
+#define BQINT__BYTESWAP_WORD(w) BQINT__BYTESWAP_32(w)
+#elif BQINT_WORD_BITS == 16
+#define BQINT__BYTESWAP_WORD(w) BQINT__BYTESWAP_16(w)
+#elif BQINT_WORD_BITS == 8
+#define BQINT__BYTESWAP_WORD(w) (w)
+#endif
+
 static int bqint__is_big_endian()
 {
 	uint32_t one = 1;
 	return *(unsigned char*)&one != 1;
 }
 
+// All the flags must be representable in `bqint_flags`
+typedef char bqint__flags_fit[(bqint_flags)(BQINT_NEGATIVE | BQINT_STORAGE | BQINT_ERROR)
+	== (BQINT_NEGATIVE | BQINT_STORAGE | BQINT_ERROR) ? 1 : -1];
+
+// Clamp a word count to the representable size
+inline static bqint_size bqint__clamp_size(size_t size)
+{
+	return size > BQINT_MAX_WORDS ? BQINT_MAX_WORDS : (bqint_size)size;
+}
+
+// Add word counts saturating to BQINT_MAX_WORDS, results that don't fit will
+// be truncated later as the storage can't be reserved
+inline static bqint_size bqint__add_size(bqint_size a, bqint_size b)
+{
+	bqint_size sum = (bqint_size)(a + b);
+	return sum >= a ? sum : BQINT_MAX_WORDS;
+}
+
+static size_t bqint__thresholds[BQINT_THRESHOLD_NUM] = {
+	BQINT_GCD_LEHMER_THRESHOLD,
+	BQINT_SQR_THRESHOLD,
+};
+
+void bqint_load_thresholds(void)
+{
+	const char *env = getenv("BQINT" BQINT__STRING(BQINT__SUFFIX) "_THRESHOLDS");
+	size_t thresholds[BQINT_THRESHOLD_NUM];
+
+	thresholds[BQINT_THRESHOLD_GCD_LEHMER] = BQINT_GCD_LEHMER_THRESHOLD;
+	thresholds[BQINT_THRESHOLD_SQR] = BQINT_SQR_THRESHOLD;
+
+	// Comma separated `name=words` pairs, unknown names are skipped
+	while (env && *env) {
+		size_t len = strcspn(env, "=,");
+		int i;
+
+		if (env[len] == '=') {
+			for (i = 0; i < BQINT_THRESHOLD_NUM; i++) {
+				if (strlen(bqint__threshold_names[i]) == len
+						&& !memcmp(env, bqint__threshold_names[i], len)) {
+					thresholds[i] = (size_t)strtoul(env + len + 1, 0, 10);
+				}
+			}
+		}
+
+		env = strchr(env, ',');
+		if (env)
+			env++;
+	}
+
+	memcpy(bqint__thresholds, thresholds, sizeof(thresholds));
+}
+
+size_t bqint_get_threshold(int threshold)
+{
+	BQINT_ASSERT(threshold >= 0 && threshold < BQINT_THRESHOLD_NUM);
+	return bqint__thresholds[threshold];
+}
+
+void bqint_set_threshold(int threshold, size_t words)
+{
+	BQINT_ASSERT(threshold >= 0 && threshold < BQINT_THRESHOLD_NUM);
+	bqint__thresholds[threshold] = words;
+}
+
 bqint bqint_dynamic()
 {
 	bqint result;
@@ -290,7 +1897,7 @@ bqint bqint_static(void *buffer, size_t size)
 	bqint result;
 	result.data.words = (bqint_word*)buffer;
 	result.size = 0;
-	result.capacity = size / sizeof(bqint_word);
+	result.capacity = bqint__clamp_size(size / sizeof(bqint_word));
 	result.flags = BQINT_STATIC;
 	return result;
 }
@@ -300,15 +1907,58 @@ bqint bqint_dynamic_initial(void *buffer, size_t size)
 	bqint result;
 	result.data.words = (bqint_word*)buffer;
 	result.size = 0;
-	result.capacity = size / sizeof(bqint_word);
+	result.capacity = bqint__clamp_size(size / sizeof(bqint_word));
 	result.flags = BQINT_DYNAMIC;
 	return result;
 }
 
+bqint bqint_view(const bqint_word *words, size_t count)
+{
+	bqint result;
+	bqint_size size = bqint__clamp_size(count);
+	result.data.words = (bqint_word*)words;
+	result.capacity = 0;
+	result.flags = BQINT_VIEW;
+
+	if (size < count) {
+		result.flags |= BQINT_TRUNCATED;
+		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
+	}
+
+	// Remove high zeroes
+	while (size > 0 && !words[size - 1]) {
+		size--;
+	}
+
+	result.size = size;
+	return result;
+}
+
+bqint bqint_view_le(const void *data, size_t size, int negative)
+{
+	bqint result;
+
+	BQINT_ASSERT(!bqint__is_big_endian());
+	BQINT_ASSERT((uintptr_t)data % sizeof(bqint_word) == 0);
+	result = bqint_view((const bqint_word*)data, size / sizeof(bqint_word));
+	if (size % sizeof(bqint_word)) {
+		result.flags |= BQINT_TRUNCATED;
+		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
+	}
+	if (negative && result.size > 0)
+		result.flags |= BQINT_NEGATIVE;
+	return result;
+}
+
 void bqint_free(bqint *a)
 {
 	if (a->flags & BQINT_ALLOCATED) {
+		BQINT__STAT_FREE(sizeof(bqint_word) * a->capacity);
 		bqint_free_memory(a->data.words);
+	} else if (a->flags & BQINT_SHARED) {
+		bqint__shared_release(BQINT__SHARED_HEADER(a->data.words));
 	}
 	a->data.words = 0;
 	a->size = 0;
@@ -316,11 +1966,19 @@ void bqint_free(bqint *a)
 	a->flags = 0;
 }
 
+static void bqint__detach(bqint *a);
+
 static bqint_word *bqint__reserve(bqint *a, bqint_size* size)
 {
-	bqint_flags flags = a->flags;
+	bqint_flags flags;
 	bqint_size sz = *size;
 
+	// Views and shared storage are never written to, the value is copied
+	// since the result may alias an input
+	if (a->flags & (BQINT_VIEW | BQINT_SHARED))
+		bqint__detach(a);
+	flags = a->flags;
+
 	// Fits in current storage
 	if (sz <= a->capacity) {
 		if (flags & BQINT_INLINED) {
@@ -351,15 +2009,17 @@ static bqint_word *bqint__reserve(bqint *a, bqint_size* size)
 #endif
 	{
 		bqint_word *new_words;
-		bqint_size new_size = a->capacity * 2;
+		bqint_size new_size = bqint__add_size(a->capacity, a->capacity);
 		new_size = new_size >= sz ? new_size : sz;
 
 		if (flags & BQINT_ALLOCATED) {
+			BQINT__STAT_FREE(sizeof(bqint_word) * a->capacity);
 			bqint_free_memory(a->data.words);
 		}
 
 		new_words = (bqint_word*)bqint_alloc_memory(sizeof(bqint_word) * new_size);
 		if (new_words) {
+			BQINT__STAT_ALLOC(sizeof(bqint_word) * new_size);
 			a->data.words = new_words;
 			a->capacity = new_size;
 
@@ -370,6 +2030,7 @@ static bqint_word *bqint__reserve(bqint *a, bqint_size* size)
 			// Out of memory: The old buffer is already freed so just return the
 			// inline buffer below
 			BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+			BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
 			a->flags |= BQINT_OUT_OF_MEMORY;
 			a->flags &= ~BQINT_ALLOCATED;
 		}
@@ -384,9 +2045,13 @@ static bqint_word *bqint__reserve(bqint *a, bqint_size* size)
 
 static bqint_word *bqint__grow(bqint *a, bqint_size* size)
 {
-	bqint_flags flags = a->flags;
+	bqint_flags flags;
 	bqint_size sz = *size;
 
+	if (a->flags & (BQINT_VIEW | BQINT_SHARED))
+		bqint__detach(a);
+	flags = a->flags;
+
 	// Fits in current storage
 	if (sz <= a->capacity) {
 		if (flags & BQINT_INLINED) {
@@ -420,16 +2085,20 @@ static bqint_word *bqint__grow(bqint *a, bqint_size* size)
 #endif
 	{
 		bqint_word *new_words;
-		bqint_size new_size = a->capacity * 2;
+		bqint_size new_size = bqint__add_size(a->capacity, a->capacity);
 		new_size = new_size >= sz ? new_size : sz;
 
 		if (flags & BQINT_ALLOCATED) {
 			new_words = (bqint_word*)bqint_realloc_memory(a->data.words,
 					sizeof(bqint_word) * a->size,
 					sizeof(bqint_word) * new_size);
+			if (new_words) {
+				BQINT__STAT_REALLOC(sizeof(bqint_word) * a->capacity, sizeof(bqint_word) * new_size);
+			}
 		} else {
 			new_words = (bqint_word*)bqint_alloc_memory(sizeof(bqint_word) * new_size);
 			if (new_words) {
+				BQINT__STAT_ALLOC(sizeof(bqint_word) * new_size);
 				memcpy(new_words, bqint_get_words(a), sizeof(bqint_word) * a->size);
 			}
 		}
@@ -443,6 +2112,7 @@ static bqint_word *bqint__grow(bqint *a, bqint_size* size)
 			return new_words;
 		} else {
 			// Failed to grow, truncate to current storage (if any)
+			BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
 			a->flags |= BQINT_OUT_OF_MEMORY;
 			if (a->capacity > 0) {
 				*size = a->capacity;
@@ -458,6 +2128,50 @@ static bqint_word *bqint__grow(bqint *a, bqint_size* size)
 	return a->data.inline_words;
 }
 
+void bqint_reserve(bqint *a, bqint_size words)
+{
+	if (words <= a->capacity || (a->flags & BQINT_STATIC))
+		return;
+
+	bqint__grow(a, &words);
+}
+
+void bqint_shrink_to_fit(bqint *a)
+{
+	bqint_word *words;
+
+	if (!(a->flags & BQINT_ALLOCATED))
+		return;
+	if (a->size > BQINT_INLINE_CAPACITY && a->size == a->capacity)
+		return;
+
+	words = a->data.words;
+
+	if (a->size <= BQINT_INLINE_CAPACITY) {
+		// Note: `words` and `inline_words` overlap so copy via a temporary
+		bqint_word tmp[BQINT_INLINE_CAPACITY];
+		memcpy(tmp, words, sizeof(bqint_word) * a->size);
+		BQINT__STAT_FREE(sizeof(bqint_word) * a->capacity);
+		bqint_free_memory(words);
+
+		memcpy(a->data.inline_words, tmp, sizeof(bqint_word) * a->size);
+		a->capacity = BQINT_INLINE_CAPACITY;
+		a->flags &= ~BQINT_ALLOCATED;
+		a->flags |= BQINT_INLINED;
+	} else {
+		bqint_word *new_words = (bqint_word*)bqint_realloc_memory(words,
+				sizeof(bqint_word) * a->size,
+				sizeof(bqint_word) * a->size);
+
+		// Failing to shrink is not an error, just keep the old buffer
+		if (new_words) {
+			BQINT__STAT_REALLOC(sizeof(bqint_word) * a->capacity, sizeof(bqint_word) * a->size);
+			a->data.words = new_words;
+			a->capacity = a->size;
+		}
+	}
+}
+
 inline static void bqint__truncate(bqint *a, bqint_size size)
 {
 	bqint_size cap = a->capacity;
@@ -467,29 +2181,104 @@ inline static void bqint__truncate(bqint *a, bqint_size size)
 		a->size = cap;
 		a->flags |= BQINT_TRUNCATED;
 		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
 	}
 }
 
-inline static bqint_flags bqint__combine_flags(bqint_flags result, bqint_flags a, bqint_flags mask)
+// Copy the value of a view or shared storage to storage owned by `a`
+static void bqint__detach(bqint *a)
 {
-	return (result & ~mask) | (a & mask);
+	const bqint_word *view_words = a->data.words;
+	bqint_size view_size = a->size;
+	bqint_size size = view_size;
+	bqint_flags shared = a->flags & BQINT_SHARED;
+	bqint_word *words;
+
+	a->flags &= ~(BQINT_VIEW | BQINT_SHARED);
+	a->data.words = 0;
+	a->size = 0;
+	a->capacity = 0;
+
+	words = bqint__reserve(a, &size);
+	memcpy(words, view_words, size * sizeof(bqint_word));
+	bqint__truncate(a, view_size);
+
+	if (shared)
+		bqint__shared_release(BQINT__SHARED_HEADER(view_words));
 }
 
-void bqint_set(bqint *result, const bqint *a)
+void bqint_share(bqint *a)
 {
+	bqint__shared *shared;
 	bqint_size size = a->size;
-	bqint_word *a_words = bqint_get_words(a);
-	bqint_word *words = bqint__reserve(result, &size);
+	// Can't overflow: the words are already allocated in `a`
+	size_t bytes = sizeof(bqint__shared) + (size_t)size * sizeof(bqint_word);
+	bqint_flags flags = a->flags & (BQINT_NEGATIVE | BQINT_DYNAMIC | BQINT_ERROR);
+
+	if ((a->flags & BQINT_SHARED) || size <= BQINT_INLINE_CAPACITY)
+		return;
+
+	// Failing to share is not an error, the value just stays as is
+	shared = (bqint__shared*)bqint_alloc_memory(bytes);
+	if (!shared)
+		return;
+	BQINT__STAT_ALLOC(bytes);
+
+	shared->info.refs = 1;
+	shared->info.bytes = bytes;
+	memcpy(shared + 1, bqint_get_words(a), size * sizeof(bqint_word));
+
+	bqint_free(a);
+	a->data.words = (bqint_word*)(shared + 1);
+	a->size = size;
+	a->capacity = 0;
+	a->flags = flags | BQINT_SHARED;
+}
+
+inline static bqint_flags bqint__combine_flags(bqint_flags result, bqint_flags a, bqint_flags mask)
+{
+	return (result & ~mask) | (a & mask);
+}
+
+static int bqint__cmp(const bqint *a, const bqint *b);
+
+void bqint_set(bqint *result, const bqint *a)
+{
+	bqint_size size = a->size;
+	bqint_word *a_words = bqint_get_words(a);
+	bqint_word *words;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SET, size);
+
+	// Copies of shared storage take a reference to it, static buffers are
+	// still filled as they are owned by the caller
+	if ((a->flags & BQINT_SHARED) && !(result->flags & BQINT_STATIC)) {
+		if (result != a) {
+			bqint_flags flags = result->flags & BQINT_DYNAMIC;
+			BQINT_ATOMIC_ADD(&BQINT__SHARED_HEADER(a_words)->info.refs, 1);
+			bqint_free(result);
+			result->data.words = a_words;
+			result->size = size;
+			result->capacity = 0;
+			result->flags = flags | (a->flags & (BQINT_SHARED | BQINT_NEGATIVE | BQINT_ERROR));
+		}
+		BQINT__STAT_END(BQINT_STAT_SET);
+		return;
+	}
+
+	words = bqint__reserve(result, &size);
 
 	memcpy(words, a_words, size * sizeof(bqint_word));
 
 	result->flags = bqint__combine_flags(result->flags, a->flags, BQINT_NEGATIVE|BQINT_ERROR);
 	bqint__truncate(result, a->size);
+	BQINT__STAT_END(BQINT_STAT_SET);
 }
 
 static void bqint__set_raw_u32(bqint *a, uint32_t val)
 {
-	bqint_size size = 0, cap = sizeof(uint32_t) / sizeof(bqint_word);
+	bqint_size size = 0, cap = (sizeof(uint32_t) + sizeof(bqint_word) - 1) / sizeof(bqint_word);
 	bqint_word *words;
 
 	if (val == 0) {
@@ -499,7 +2288,7 @@ static void bqint__set_raw_u32(bqint *a, uint32_t val)
 
 	words = bqint__reserve(a, &cap);
 
-#if BQINT_WORD_BITS == 32
+#if BQINT_WORD_BITS >= 32
 	size = 1;
 	if (cap > 0)
 		words[0] = val;
@@ -542,7 +2331,7 @@ void bqint_set_u32(bqint *a, uint32_t val)
 
 void bqint_set_i32(bqint *a, int32_t val)
 {
-	bqint__set_raw_u32(a, (uint32_t)(val & 0x7FFFFFFF));
+	bqint__set_raw_u32(a, val < 0 ? (uint32_t)0 - (uint32_t)val : (uint32_t)val);
 	if (val < 0) {
 		a->flags |= BQINT_NEGATIVE;
 	} else {
@@ -550,41 +2339,67 @@ void bqint_set_i32(bqint *a, int32_t val)
 	}
 }
 
-void bqint_set_raw(bqint *a, const void *data, size_t size)
+// Load `num_words` words from the bytes of `data`, missing high bytes are zero.
+// Note: The shifts are independent of the host byte order and compile to
+// plain loads or byte swaps.
+static void bqint__load_bytes(bqint_word *words, bqint_size num_words,
+		const unsigned char *data, size_t size, int big_endian)
+{
+	bqint_size i;
+	size_t k;
+
+	for (i = 0; i < num_words; i++) {
+		size_t base = (size_t)i * sizeof(bqint_word);
+		size_t num = size - base < sizeof(bqint_word) ? size - base : sizeof(bqint_word);
+		bqint_word word = 0;
+
+		if (big_endian) {
+			const unsigned char *src = data + (size - base - 1);
+			for (k = 0; k < num; k++) {
+				word |= (bqint_word)((bqint_word)*(src - k) << (k * 8));
+			}
+		} else {
+			const unsigned char *src = data + base;
+			for (k = 0; k < num; k++) {
+				word |= (bqint_word)((bqint_word)src[k] << (k * 8));
+			}
+		}
+
+		words[i] = word;
+	}
+}
+
+static void bqint__set_bytes(bqint *a, const void *data, size_t size, int order)
 {
-	size_t num_words, size_to_copy;
+	size_t num_words;
 	bqint_size sz;
 	bqint_word *words;
 
 	num_words = (size + sizeof(bqint_word) - 1) / sizeof(bqint_word);
 
 	// Clamp to representable size
-	if (num_words > BQINT_MAX_WORDS) {
-		sz = BQINT_MAX_WORDS;
-	} else {
-		sz = (bqint_size)num_words;
-	}
+	sz = bqint__clamp_size(num_words);
 	words = bqint__reserve(a, &sz);
 
-	size_to_copy = sz * sizeof(bqint_word);
-	if (size_to_copy > size) {
-		size_to_copy = size;
-		// Pad the end with zeroes
-		words[sz - 1] = (bqint_word)0;
-	}
-	memcpy(words, data, size_to_copy);
-
-	if (bqint__is_big_endian()) {
-		bqint_size i;
-		for (i = 0; i < sz; i++) {
-			words[i] = BQINT__BYTESWAP_WORD(words[i]);
+	if (!(order & BQINT_BYTES_BIG_ENDIAN) && !bqint__is_big_endian()) {
+		// Native layout: Copy directly
+		size_t size_to_copy = sz * sizeof(bqint_word);
+		if (size_to_copy > size) {
+			size_to_copy = size;
+			// Pad the end with zeroes
+			words[sz - 1] = (bqint_word)0;
 		}
+		memcpy(words, data, size_to_copy);
+	} else {
+		bqint__load_bytes(words, sz, (const unsigned char*)data, size,
+				order & BQINT_BYTES_BIG_ENDIAN);
 	}
 
 	// If we copied less than the requested mark the value truncated
-	if (size_to_copy < size) {
+	if (sz < num_words) {
 		a->flags |= BQINT_TRUNCATED;
 		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
 	}
 
 	// Remove high zeroes
@@ -595,6 +2410,74 @@ void bqint_set_raw(bqint *a, const void *data, size_t size)
 	a->size = sz;
 }
 
+void bqint_set_raw(bqint *a, const void *data, size_t size)
+{
+	bqint__set_bytes(a, data, size, BQINT_BYTES_LITTLE_ENDIAN);
+}
+
+void bqint_set_bytes(bqint *a, const void *data, size_t size, int order)
+{
+	bqint__set_bytes(a, data, size, order);
+	a->flags &= ~BQINT_NEGATIVE;
+}
+
+size_t bqint_byte_size(const bqint *a)
+{
+	bqint_word top;
+	size_t size;
+
+	if (a->size == 0)
+		return 0;
+
+	size = (size_t)(a->size - 1) * sizeof(bqint_word);
+	top = bqint_get_words(a)[a->size - 1];
+	while (top) {
+		size++;
+		top = (bqint_word)(top >> 8);
+	}
+	return size;
+}
+
+size_t bqint_get_bytes(const bqint *a, void *data, size_t size, int order)
+{
+	const bqint_word *words = bqint_get_words(a);
+	unsigned char *dst = (unsigned char*)data;
+	size_t num_bytes = bqint_byte_size(a);
+	size_t out_size = (order & BQINT_BYTES_PAD) ? size : num_bytes;
+	size_t base, k;
+	bqint_size i;
+
+	if (num_bytes > size)
+		return num_bytes;
+
+	if (order & BQINT_BYTES_BIG_ENDIAN) {
+		for (i = 0; i < a->size; i++) {
+			bqint_word word = words[i];
+			unsigned char *d = dst + (out_size - 1);
+			base = (size_t)i * sizeof(bqint_word);
+			for (k = 0; k < sizeof(bqint_word) && base + k < num_bytes; k++) {
+				*(d - (base + k)) = (unsigned char)(word >> (k * 8));
+			}
+		}
+		memset(dst, 0, out_size - num_bytes);
+	} else {
+		if (!bqint__is_big_endian()) {
+			memcpy(dst, words, num_bytes);
+		} else {
+			for (i = 0; i < a->size; i++) {
+				bqint_word word = words[i];
+				base = (size_t)i * sizeof(bqint_word);
+				for (k = 0; k < sizeof(bqint_word) && base + k < num_bytes; k++) {
+					dst[base + k] = (unsigned char)(word >> (k * 8));
+				}
+			}
+		}
+		memset(dst + num_bytes, 0, out_size - num_bytes);
+	}
+
+	return out_size;
+}
+
 bqint_size bqint__add_words(
 		bqint_word *r_words, bqint_size r_size,
 		const bqint_word *a_words, bqint_size a_size,
@@ -667,9 +2550,198 @@ bqint_size bqint__add_words(
 
 	// Note: Return ~0 if we truncated indicating the algorithm didn't calculate
 	// the correct length of the number.
-	return truncated ? ~(bqint_size)0 : pos;
+	return truncated ? BQINT_MAX_WORDS : pos;
+}
+
+// r += a * y over `a_size` words, returns the carry out of the top word
+bqint_word bqint__addmul_1_words(bqint_word *r_words,
+		const bqint_word *a_words, bqint_size a_size, bqint_word y)
+{
+	bqint_word carry = 0;
+	bqint_size i;
+
+	for (i = 0; i < a_size; i++) {
+		bqint_dword mul
+			= (bqint_dword)y
+			* (bqint_dword)a_words[i]
+			+ (bqint_dword)r_words[i]
+			+ (bqint_dword)carry;
+
+		r_words[i] = BQINT__LO(mul);
+		carry = BQINT__HI(mul);
+	}
+	return carry;
+}
+
+// r -= a * y over `a_size` words, returns the borrow out of the top word
+bqint_word bqint__submul_1_words(bqint_word *r_words,
+		const bqint_word *a_words, bqint_size a_size, bqint_word y)
+{
+	bqint_word carry = 0;
+	bqint_size i;
+
+	for (i = 0; i < a_size; i++) {
+		bqint_dword mul
+			= (bqint_dword)y
+			* (bqint_dword)a_words[i]
+			+ (bqint_dword)carry;
+		bqint_word lo = BQINT__LO(mul);
+
+		// The high word of the product is at most 2^BQINT_WORD_BITS - 2 so
+		// adding the borrow never overflows
+		carry = (bqint_word)(BQINT__HI(mul) + (r_words[i] < lo));
+		r_words[i] = (bqint_word)(r_words[i] - lo);
+	}
+	return carry;
+}
+
+// The multi-row kernels add the product of `a` and a short multiplier of 2 or
+// 4 words in one pass, keeping the rows in registers so every result word is
+// loaded and stored once per block instead of once per row. They read
+// `a_size` words of `r`, write `a_size + rows - 1` words and return the top
+// word of the product.
+
+#ifdef BQINT__WIDE_ROWS
+
+// Multiplies by `rows` words at once as a single wide word
+static bqint_word bqint__addmul_wide_words(bqint_word *r_words,
+		const bqint_word *a_words, bqint_size a_size,
+		const bqint_word *y_words, unsigned rows)
+{
+	bqint__wide y = 0, carry = 0;
+	bqint_size i;
+	unsigned k;
+
+	for (k = rows; k > 0; k--) {
+		y = y << BQINT_WORD_BITS | y_words[k - 1];
+	}
+
+	for (i = 0; i < a_size; i++) {
+		bqint__wide mul = y * a_words[i] + r_words[i] + carry;
+		r_words[i] = (bqint_word)mul;
+		carry = mul >> BQINT_WORD_BITS;
+	}
+
+	for (k = 1; k < rows; k++, i++) {
+		r_words[i] = (bqint_word)carry;
+		carry >>= BQINT_WORD_BITS;
+	}
+	return (bqint_word)carry;
+}
+
+#endif
+
+// Row `k` adds `y[k] * a[i - k]` to the word `i`. The rows are chained so that
+// each one adds to the low half of the previous one and keeps its own carry,
+// so every step fits in a double word.
+#define BQINT__ADDMUL_ROW(y, aw, c) \
+	p = (bqint_dword)(aw) * (y) + BQINT__LO(p) + (c); \
+	(c) = (bqint_word)BQINT__HI(p);
+
+// r += a * (y[0] + y[1] B)
+bqint_word bqint__addmul_2_words(bqint_word *r_words,
+		const bqint_word *a_words, bqint_size a_size, const bqint_word *y_words)
+{
+#ifdef BQINT__WIDE_ROWS
+	return bqint__addmul_wide_words(r_words, a_words, a_size, y_words, 2);
+#else
+	bqint_word y0 = y_words[0], y1 = y_words[1];
+	bqint_word a0, a1 = 0, c0 = 0, c1 = 0;
+	bqint_dword p;
+	bqint_size i;
+
+	for (i = 0; i < a_size; i++) {
+		a0 = a_words[i];
+		p = r_words[i];
+		BQINT__ADDMUL_ROW(y0, a0, c0)
+		BQINT__ADDMUL_ROW(y1, a1, c1)
+		r_words[i] = (bqint_word)BQINT__LO(p);
+		a1 = a0;
+	}
+
+	p = (bqint_dword)a1 * y1 + c0 + c1;
+	r_words[i] = (bqint_word)BQINT__LO(p);
+	return (bqint_word)BQINT__HI(p);
+#endif
+}
+
+// r += a * (y[0] + y[1] B + y[2] B^2 + y[3] B^3)
+bqint_word bqint__addmul_4_words(bqint_word *r_words,
+		const bqint_word *a_words, bqint_size a_size, const bqint_word *y_words)
+{
+#if BQINT__WIDE_ROWS >= 4
+	return bqint__addmul_wide_words(r_words, a_words, a_size, y_words, 4);
+#elif defined(BQINT__WIDE_ROWS)
+	// Two wide rows of two words each, chained like below
+	bqint__wide y01 = (bqint__wide)y_words[1] << BQINT_WORD_BITS | y_words[0];
+	bqint__wide y23 = (bqint__wide)y_words[3] << BQINT_WORD_BITS | y_words[2];
+	bqint__wide p, c0 = 0, c1 = 0;
+	bqint_word a0, a1 = 0, a2 = 0;
+	bqint_size i, end = a_size + 3;
+
+	for (i = 0; i < a_size; i++) {
+		a0 = a_words[i];
+		p = y01 * a0 + r_words[i] + c0;
+		c0 = p >> BQINT_WORD_BITS;
+		p = y23 * a2 + (bqint_word)p + c1;
+		c1 = p >> BQINT_WORD_BITS;
+		r_words[i] = (bqint_word)p;
+		a2 = a1;
+		a1 = a0;
+	}
+
+	// Flush the rows still in flight
+	for (; i < end; i++) {
+		p = y23 * a2 + (bqint_word)c0 + c1;
+		c0 >>= BQINT_WORD_BITS;
+		c1 = p >> BQINT_WORD_BITS;
+		r_words[i] = (bqint_word)p;
+		a2 = a1;
+		a1 = 0;
+	}
+
+	return (bqint_word)(c0 + c1);
+#else
+	bqint_word y0 = y_words[0], y1 = y_words[1], y2 = y_words[2], y3 = y_words[3];
+	bqint_word a0, a1 = 0, a2 = 0, a3 = 0;
+	bqint_word c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+	bqint_dword p;
+	bqint_size i, end = a_size + 3;
+
+	for (i = 0; i < a_size; i++) {
+		a0 = a_words[i];
+		p = r_words[i];
+		BQINT__ADDMUL_ROW(y0, a0, c0)
+		BQINT__ADDMUL_ROW(y1, a1, c1)
+		BQINT__ADDMUL_ROW(y2, a2, c2)
+		BQINT__ADDMUL_ROW(y3, a3, c3)
+		r_words[i] = (bqint_word)BQINT__LO(p);
+		a3 = a2;
+		a2 = a1;
+		a1 = a0;
+	}
+
+	// Flush the rows still in flight
+	for (; i < end; i++) {
+		p = c0;
+		c0 = 0;
+		BQINT__ADDMUL_ROW(y1, a1, c1)
+		BQINT__ADDMUL_ROW(y2, a2, c2)
+		BQINT__ADDMUL_ROW(y3, a3, c3)
+		r_words[i] = (bqint_word)BQINT__LO(p);
+		a3 = a2;
+		a2 = a1;
+		a1 = 0;
+	}
+
+	// The carries are all into the top word of the product so they can't
+	// overflow it
+	return (bqint_word)(c1 + c2 + c3);
+#endif
 }
 
+#undef BQINT__ADDMUL_ROW
+
 bqint_size bqint__mul_words_inplace(
 		bqint_word *r_words, bqint_size r_cap, bqint_size r_size,
 		const bqint_word *a_words, bqint_size a_size)
@@ -689,12 +2761,64 @@ bqint_size bqint__mul_words_inplace(
 	// are not multiplied yet
 	for (r_i = r_size - 1; r_i < r_size; r_i--) {
 		bqint_size a_i;
-		bqint_word *r_words_ri = r_words + r_i;
-		bqint_word rw = *r_words_ri;
+		bqint_word *r_words_ri;
+		bqint_word rw;
 		bqint_word carry = 0;
-		bqint_size a_cap = r_cap - r_i;
+		bqint_size a_cap;
 		bqint_size a_num = a_size;
+		bqint_size rows = BQINT__MUL_ROWS >= 4 && r_i >= 3 ? 4
+			: BQINT__MUL_ROWS >= 2 && r_i >= 1 ? 2 : 1;
+
+		// The row starts past the result
+		if (r_i >= r_cap) {
+			truncated = 1;
+			continue;
+		}
+
+		// Multiply a block of rows at once if the product fits, the kernel
+		// overwrites the words above `a` so they are added back after it
+		if (rows > 1 && r_i + a_size < r_cap) {
+			bqint_word rows_words[4], top_words[4];
+			bqint_size i;
+
+			r_i -= rows - 1;
+			r_words_ri = r_words + r_i;
+			a_cap = r_cap - r_i;
+			for (i = 0; i < rows; i++) {
+				rows_words[i] = r_words_ri[i];
+				r_words_ri[i] = 0;
+			}
+			for (i = 0; i < rows; i++) {
+				top_words[i] = r_words_ri[a_size + i];
+			}
+
+			if (rows == 4) {
+				r_words_ri[a_size + 3] = bqint__addmul_4_words(
+						r_words_ri, a_words, a_size, rows_words);
+			} else {
+				r_words_ri[a_size + 1] = bqint__addmul_2_words(
+						r_words_ri, a_words, a_size, rows_words);
+			}
+
+			for (a_i = a_size, i = 0; a_i < a_cap && (i < rows || carry); a_i++, i++) {
+				bqint_dword sum
+					= (bqint_dword)r_words_ri[a_i]
+					+ (bqint_dword)(i < rows ? top_words[i] : 0)
+					+ (bqint_dword)carry;
+
+				r_words_ri[a_i] = BQINT__LO(sum);
+				carry = BQINT__HI(sum);
+			}
 
+			if (carry) {
+				truncated = 1;
+			}
+			continue;
+		}
+
+		r_words_ri = r_words + r_i;
+		rw = *r_words_ri;
+		a_cap = r_cap - r_i;
 		*r_words_ri = 0;
 
 		if (a_num > a_cap) {
@@ -735,7 +2859,7 @@ bqint_size bqint__mul_words_inplace(
 			size--;
 		return size;
 	} else {
-		return ~(bqint_size)0;
+		return BQINT_MAX_WORDS;
 	}
 }
 
@@ -771,21 +2895,43 @@ bqint_size bqint__mul_words(
 	}
 
 	// Do the longer one in the inner loop to keep the inner-loop setup overhead
-	// minimal
-	for (short_i = 0; short_i < short_size; short_i++) {
+	// minimal, and as many rows per pass as fit in the result
+	for (short_i = 0; short_i < short_size; ) {
 		bqint_size long_i;
-		bqint_word *r_words_si = r_words + short_i;
-		bqint_word sw = short_words[short_i];
+		bqint_word *r_words_si;
+		bqint_word sw;
 		bqint_word carry = 0;
-		bqint_size long_cap = r_size - short_i;
+		bqint_size long_cap;
 		bqint_size long_num = long_size;
 
+		// The remaining rows start past the result
+		if (short_i >= r_size) {
+			truncated = 1;
+			break;
+		}
+		r_words_si = r_words + short_i;
+		sw = short_words[short_i];
+		long_cap = r_size - short_i;
+
+		if (BQINT__MUL_ROWS >= 4 && short_size - short_i >= 4 && long_size + 4 <= long_cap) {
+			r_words_si[long_size + 3] = bqint__addmul_4_words(
+					r_words_si, long_words, long_size, short_words + short_i);
+			short_i += 4;
+			continue;
+		} else if (BQINT__MUL_ROWS >= 2 && short_size - short_i >= 2 && long_size + 2 <= long_cap) {
+			r_words_si[long_size + 1] = bqint__addmul_2_words(
+					r_words_si, long_words, long_size, short_words + short_i);
+			short_i += 2;
+			continue;
+		}
+		short_i++;
+
 		if (long_num > long_cap) {
 			long_num = long_cap;
 			truncated = 1;
 		}
 
-		for (long_i = 0; long_i < long_size; long_i++) {
+		for (long_i = 0; long_i < long_num; long_i++) {
 			bqint_dword mul
 				= (bqint_dword)sw
 				* (bqint_dword)long_words[long_i]
@@ -818,8 +2964,77 @@ bqint_size bqint__mul_words(
 			size--;
 		return size;
 	} else {
-		return ~(bqint_size)0;
+		return BQINT_MAX_WORDS;
+	}
+}
+
+// Squaring computes each cross product a[i] a[j] (i < j) once, doubles the
+// sum and adds the squares of the words: about half of the multiplications of
+// the general bqint__mul_words()
+bqint_size bqint__sqr_words(
+		bqint_word *r_words, bqint_size r_size,
+		const bqint_word *a_words, bqint_size a_size)
+{
+	bqint_size i, j, size = 2 * a_size;
+	bqint_word carry;
+
+	if (r_size == 0 || a_size == 0)
+		return 0;
+
+	// The truncation checks are in the general version, which is also faster
+	// for small operands
+	if (r_size / 2 < a_size || a_size < bqint_get_threshold(BQINT_THRESHOLD_SQR))
+		return bqint__mul_words(r_words, r_size, a_words, a_size, a_words, a_size);
+
+	for (i = 0; i < r_size; i++) {
+		r_words[i] = 0;
 	}
+
+	// 1. Sum of the cross products, row `i` ends at word `i + a_size`
+	for (i = 0; i + 1 < a_size; i++) {
+		bqint_word aw = a_words[i];
+		carry = 0;
+
+		for (j = i + 1; j < a_size; j++) {
+			bqint_dword mul
+				= (bqint_dword)aw
+				* (bqint_dword)a_words[j]
+				+ (bqint_dword)r_words[i + j]
+				+ (bqint_dword)carry;
+
+			r_words[i + j] = BQINT__LO(mul);
+			carry = BQINT__HI(mul);
+		}
+		r_words[i + a_size] = carry;
+	}
+
+	// 2. Double the cross products, they are less than a^2 / 2 so the top bit
+	// is never shifted out
+	for (i = size - 1; i > 0; i--) {
+		r_words[i] = (bqint_word)(r_words[i] << 1 | r_words[i - 1] >> (BQINT_WORD_BITS - 1));
+	}
+	r_words[0] = (bqint_word)(r_words[0] << 1);
+
+	// 3. Add the squares of the words on the diagonal
+	carry = 0;
+	for (i = 0; i < a_size; i++) {
+		bqint_dword sq = (bqint_dword)a_words[i] * (bqint_dword)a_words[i];
+		bqint_dword sum
+			= (bqint_dword)r_words[2 * i]
+			+ BQINT__LO(sq)
+			+ (bqint_dword)carry;
+
+		r_words[2 * i] = BQINT__LO(sum);
+		sum = (bqint_dword)r_words[2 * i + 1]
+			+ BQINT__HI(sq)
+			+ BQINT__HI(sum);
+		r_words[2 * i + 1] = BQINT__LO(sum);
+		carry = BQINT__HI(sum);
+	}
+
+	while (size > 0 && !r_words[size - 1])
+		size--;
+	return size;
 }
 
 bqint_size bqint__sub_words(
@@ -839,7 +3054,7 @@ bqint_size bqint__sub_words(
 		r_words[i] = a_words[i];
 	}
 
-	for (i = 0; i < b_size; i++) {
+	for (i = 0; i < b_num; i++) {
 		bqint_word aw = r_words[i];
 		bqint_word bw = b_words[i];
 
@@ -852,7 +3067,8 @@ bqint_size bqint__sub_words(
 				if (borrow != 0)
 					break;
 			}
-			BQINT_ASSERT(borrow_i < r_size);
+			// The borrow can only run out of a truncated result
+			BQINT_ASSERT(borrow_i < r_size || r_size < a_size);
 		}
 	}
 
@@ -862,174 +3078,4151 @@ bqint_size bqint__sub_words(
 			size--;
 		return size;
 	} else {
-		return ~(bqint_size)0;
+		return BQINT_MAX_WORDS;
 	}
 }
 
-bqint_size bqint__shr_words_inplace(
+// Note: `r_words` may be equal to `a_words`
+bqint_size bqint__shr_words(
 		bqint_word *r_words, bqint_size r_size,
-		bqint_size shift)
+		const bqint_word *a_words, bqint_size a_size,
+		size_t shift)
 {
-	bqint_size word_shift = shift / BQINT_WORD_BITS;
-	bqint_size bit_shift = shift % BQINT_WORD_BITS;
-	bqint_size i;
+	bqint_size word_shift, bit_shift, size, num, i;
 
-	if (word_shift >= r_size)
+	if (shift / BQINT_WORD_BITS >= a_size)
 		return 0;
 
+	word_shift = (bqint_size)(shift / BQINT_WORD_BITS);
+	bit_shift = (bqint_size)(shift % BQINT_WORD_BITS);
+
+	// Calculate the exact resulting size
+	size = a_size - word_shift;
+	if (bit_shift && !(a_words[a_size - 1] >> bit_shift))
+		size--;
+	num = size < r_size ? size : r_size;
+
 	if (bit_shift) {
 		bqint_size bit_shift_hi = BQINT_WORD_BITS - bit_shift;
-		bqint_word prev_word = r_words[word_shift];
-		for (i = 0; i + word_shift + 1 < r_size; i++) {
-			bqint_word next_word = r_words[i + word_shift + 1];
-			r_words[i] = prev_word >> bit_shift | next_word << bit_shift_hi;
-			prev_word = next_word;
+		for (i = 0; i < num && i + word_shift + 1 < a_size; i++) {
+			r_words[i] = a_words[i + word_shift] >> bit_shift
+				| (bqint_word)(a_words[i + word_shift + 1] << bit_shift_hi);
 		}
-		r_words[i] = prev_word >> bit_shift;
-		i++;
-
-		while (i > 0 && !r_words[i - 1])
-			i--;
-		return i;
-	} else {
-		if (word_shift == 0)
-			return r_size;
-
-		for (i = 0; i + word_shift < r_size; i++) {
-			r_words[i] = r_words[i + word_shift];
+		if (i < num) {
+			r_words[i] = a_words[i + word_shift] >> bit_shift;
+		}
+	} else if (!(word_shift == 0 && r_words == a_words)) {
+		for (i = 0; i < num; i++) {
+			r_words[i] = a_words[i + word_shift];
 		}
-		return i;
 	}
+
+	return size <= r_size ? size : BQINT_MAX_WORDS;
 }
 
-void bqint_add_inplace(bqint *result, const bqint *a)
+// Returns non-zero if any of the bits shifted out by `shift` are set
+int bqint__shr_words_lost(
+		const bqint_word *a_words, bqint_size a_size,
+		size_t shift)
 {
-	// TODO: Signs
-	bqint_size res_size = (a->size > result->size ? a->size : result->size) + 1;
-	bqint_word *res_words = bqint__grow(result, &res_size);
-	bqint_size size;
-
-	size = bqint__add_words(
-			res_words, res_size,
-			res_words, result->size,
-			bqint_get_words(a), a->size);
+	bqint_size word_shift, bit_shift, i;
 
-	// `result` affects the result of the calculation propagate it's error also
-	result->flags |= a->flags & BQINT_ERROR;
-	bqint__truncate(result, size);
-}
+	if (shift / BQINT_WORD_BITS >= a_size)
+		return a_size > 0;
 
-void bqint_add(bqint *result, const bqint *a, const bqint *b)
-{
-	// TODO: Signs
-	bqint_size res_size;
-	bqint_word *res_words;
-	bqint_size size;
+	word_shift = (bqint_size)(shift / BQINT_WORD_BITS);
+	bit_shift = (bqint_size)(shift % BQINT_WORD_BITS);
 
-	if (result == a) {
-		bqint_add_inplace(result, b);
-		return;
-	} else if (result == b) {
-		bqint_add_inplace(result, a);
-		return;
+	for (i = 0; i < word_shift; i++) {
+		if (a_words[i])
+			return 1;
 	}
 
-	res_size = (a->size > b->size ? a->size : b->size) + 1;
-	res_words = bqint__reserve(result, &res_size);
-
-	size = bqint__add_words(
-			res_words, res_size,
-			bqint_get_words(a), a->size,
-			bqint_get_words(b), b->size);
+	if (bit_shift) {
+		bqint_word mask = (bqint_word)(((bqint_word)1 << bit_shift) - 1);
+		return (a_words[word_shift] & mask) != 0;
+	}
 
-	// Propagate error flags, note: this overwrites the error of `result` because it's
-	// result doesn't matter at this point anymore
-	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
-	bqint__truncate(result, size);
+	return 0;
 }
 
-void bqint_mul_inplace(bqint *result, const bqint *a)
+// Note: `r_words` may be equal to `a_words`, the words are processed from
+// the most significant down to not overwrite the unprocessed ones.
+bqint_size bqint__shl_words(
+		bqint_word *r_words, bqint_size r_size,
+		const bqint_word *a_words, bqint_size a_size,
+		size_t shift)
 {
-	// TODO: Signs
-	bqint_size res_size = result->size + a->size + 1;
-	bqint_word *res_words = bqint__grow(result, &res_size);
-	bqint_size size;
-
-	size = bqint__mul_words_inplace(
-			res_words, res_size, result->size,
-			bqint_get_words(a), a->size);
+	bqint_size word_shift, bit_shift, size, num, i;
 
-	result->flags |= a->flags & BQINT_ERROR;
-	bqint__truncate(result, size);
-}
+	if (a_size == 0)
+		return 0;
+	if (shift / BQINT_WORD_BITS > (size_t)(BQINT_MAX_WORDS - a_size))
+		return BQINT_MAX_WORDS;
 
-void bqint_mul(bqint *result, const bqint *a, const bqint *b)
-{
-	// TODO: Signs
-	bqint_size res_size;
-	bqint_word *res_words;
-	bqint_size size;
+	word_shift = (bqint_size)(shift / BQINT_WORD_BITS);
+	bit_shift = (bqint_size)(shift % BQINT_WORD_BITS);
 
-	if (result == a) {
-		bqint_mul_inplace(result, b);
-		return;
-	} else if (result == b) {
-		bqint_mul_inplace(result, a);
-		return;
+	// Calculate the exact resulting size
+	size = a_size + word_shift;
+	if (bit_shift) {
+		bqint_size bit_shift_lo = BQINT_WORD_BITS - bit_shift;
+		if (a_words[a_size - 1] >> bit_shift_lo)
+			size = bqint__add_size(size, 1);
 	}
 
-	res_size = a->size + b->size + 1;
-	res_words = bqint__reserve(result, &res_size);
+	// Number of source words that fit in the result
+	num = a_size;
+	if (word_shift >= r_size) {
+		num = 0;
+	} else if (num > r_size - word_shift) {
+		num = r_size - word_shift;
+	}
 
-	size = bqint__mul_words(
+	if (bit_shift) {
+		bqint_size bit_shift_lo = BQINT_WORD_BITS - bit_shift;
+		if (num > 0) {
+			if (num + word_shift < r_size)
+				r_words[num + word_shift] = a_words[num - 1] >> bit_shift_lo;
+			for (i = num - 1; i > 0; i--) {
+				r_words[i + word_shift] = (bqint_word)(a_words[i] << bit_shift)
+					| a_words[i - 1] >> bit_shift_lo;
+			}
+			r_words[word_shift] = (bqint_word)(a_words[0] << bit_shift);
+		}
+	} else {
+		for (i = num; i > 0; i--) {
+			r_words[i - 1 + word_shift] = a_words[i - 1];
+		}
+	}
+
+	for (i = 0; i < word_shift && i < r_size; i++) {
+		r_words[i] = 0;
+	}
+
+	return size <= r_size ? size : BQINT_MAX_WORDS;
+}
+
+// Returns the new size of the incremented value, may grow by one word
+bqint_size bqint__inc_words(
+		bqint_word *r_words, bqint_size r_cap, bqint_size r_size)
+{
+	bqint_size i;
+	for (i = 0; i < r_size; i++) {
+		if (++r_words[i] != 0)
+			return r_size;
+	}
+
+	if (r_size < r_cap) {
+		r_words[r_size] = 1;
+		return r_size + 1;
+	}
+	return BQINT_MAX_WORDS;
+}
+
+#ifndef BQINT__BITOP_DEFINED
+#define BQINT__BITOP_DEFINED
+enum
+{
+	BQINT__BITOP_AND,
+	BQINT__BITOP_OR,
+	BQINT__BITOP_XOR,
+	BQINT__BITOP_ANDNOT,
+};
+#endif
+
+inline static bqint_word bqint__bitop_word(int op, bqint_word a, bqint_word b)
+{
+	switch (op) {
+	case BQINT__BITOP_AND: return a & b;
+	case BQINT__BITOP_OR: return a | b;
+	case BQINT__BITOP_XOR: return a ^ b;
+	default: return a & (bqint_word)~b;
+	}
+}
+
+// Bitwise operation on non-negative values
+// Note: `r_words` may be equal to `a_words` or `b_words`
+bqint_size bqint__bitop_words(int op,
+		bqint_word *r_words, bqint_size r_size,
+		const bqint_word *a_words, bqint_size a_size,
+		const bqint_word *b_words, bqint_size b_size)
+{
+	const bqint_word *tail = a_size > b_size ? a_words : b_words;
+	bqint_size min_size = a_size < b_size ? a_size : b_size;
+	bqint_size size, num, i;
+
+	switch (op) {
+	case BQINT__BITOP_AND: size = min_size; break;
+	case BQINT__BITOP_ANDNOT: size = a_size; break;
+	default: size = a_size > b_size ? a_size : b_size; break;
+	}
+
+	num = min_size < r_size ? min_size : r_size;
+
+	// Separate loop per operation so that every one of them is a plain
+	// vectorizable word loop
+	switch (op) {
+	case BQINT__BITOP_AND:
+		for (i = 0; i < num; i++)
+			r_words[i] = a_words[i] & b_words[i];
+		break;
+	case BQINT__BITOP_OR:
+		for (i = 0; i < num; i++)
+			r_words[i] = a_words[i] | b_words[i];
+		break;
+	case BQINT__BITOP_XOR:
+		for (i = 0; i < num; i++)
+			r_words[i] = a_words[i] ^ b_words[i];
+		break;
+	default:
+		for (i = 0; i < num; i++)
+			r_words[i] = a_words[i] & (bqint_word)~b_words[i];
+		break;
+	}
+
+	// Copy the tail of the longer operand
+	num = size < r_size ? size : r_size;
+	for (i = min_size; i < num; i++)
+		r_words[i] = tail[i];
+
+	// Check if any of the words that didn't fit are non-zero
+	if (size > r_size) {
+		for (i = r_size; i < size; i++) {
+			bqint_word w = i < min_size
+				? bqint__bitop_word(op, a_words[i], b_words[i])
+				: tail[i];
+			if (w)
+				return BQINT_MAX_WORDS;
+		}
+		size = r_size;
+	}
+
+	while (size > 0 && !r_words[size - 1])
+		size--;
+	return size;
+}
+
+// Bitwise operation on signed values using two's complement semantics
+// Converts the magnitudes to two's complement and back on the fly.
+// Note: `r_words` may be equal to `a_words` or `b_words`
+bqint_size bqint__bitop_words_signed(int op,
+		bqint_word *r_words, bqint_size r_size,
+		const bqint_word *a_words, bqint_size a_size, int a_neg,
+		const bqint_word *b_words, bqint_size b_size, int b_neg,
+		int *r_neg)
+{
+	bqint_word a_sign = a_neg ? (bqint_word)~(bqint_word)0 : 0;
+	bqint_word b_sign = b_neg ? (bqint_word)~(bqint_word)0 : 0;
+	bqint_word a_borrow = 1, b_borrow = 1, r_carry = 1;
+	bqint_size num = (a_size > b_size ? a_size : b_size) + 1;
+	bqint_size size = 0, i;
+	int neg = bqint__bitop_word(op, a_sign, b_sign) != 0;
+
+	for (i = 0; i < num; i++) {
+		bqint_word aw = i < a_size ? a_words[i] : 0;
+		bqint_word bw = i < b_size ? b_words[i] : 0;
+		bqint_word rw;
+
+		if (a_neg) {
+			bqint_word d = aw - a_borrow;
+			a_borrow = aw < a_borrow;
+			aw = (bqint_word)~d;
+		}
+		if (b_neg) {
+			bqint_word d = bw - b_borrow;
+			b_borrow = bw < b_borrow;
+			bw = (bqint_word)~d;
+		}
+
+		rw = bqint__bitop_word(op, aw, bw);
+
+		if (neg) {
+			bqint_word n = (bqint_word)~rw;
+			rw = n + r_carry;
+			r_carry = rw < n;
+		}
+
+		if (rw) {
+			if (i >= r_size)
+				return BQINT_MAX_WORDS;
+			size = i + 1;
+		}
+		if (i < r_size)
+			r_words[i] = rw;
+	}
+
+	*r_neg = neg;
+	return size;
+}
+
+// Number of leading zero bits in a non-zero word
+inline static unsigned bqint__clz_word(bqint_word w)
+{
+#if defined(__GNUC__) && BQINT_WORD_BITS == 64
+	return (unsigned)__builtin_clzll((unsigned long long)w);
+#elif defined(__GNUC__)
+	return (unsigned)__builtin_clz((unsigned)w) - (unsigned)(sizeof(unsigned) * 8 - BQINT_WORD_BITS);
+#else
+	unsigned n = 0;
+	while (!(w >> (BQINT_WORD_BITS - 1))) {
+		w = (bqint_word)(w << 1);
+		n++;
+	}
+	return n;
+#endif
+}
+
+// Number of trailing zero bits in a non-zero word
+inline static unsigned bqint__ctz_word(bqint_word w)
+{
+#if defined(__GNUC__) && BQINT_WORD_BITS == 64
+	return (unsigned)__builtin_ctzll((unsigned long long)w);
+#elif defined(__GNUC__)
+	return (unsigned)__builtin_ctz((unsigned)w);
+#else
+	unsigned n = 0;
+	while (!(w & 1)) {
+		w >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+// Remainder of the magnitude in `a_words` divided by the word `d`
+bqint_word bqint__mod_word(const bqint_word *a_words, bqint_size a_size, bqint_word d)
+{
+	bqint_dword rem = 0;
+	bqint_size i;
+
+	for (i = a_size; i-- > 0; ) {
+		rem = (bqint_dword)(rem << BQINT_WORD_BITS | a_words[i]) % d;
+	}
+	return (bqint_word)rem;
+}
+
+// Divide the magnitude in `a_words` by the word `d` in place, returns the
+// remainder
+bqint_word bqint__div_word_words(bqint_word *a_words, bqint_size a_size, bqint_word d)
+{
+	bqint_dword rem = 0, num;
+	bqint_size i;
+
+	for (i = a_size; i-- > 0; ) {
+		num = (bqint_dword)(rem << BQINT_WORD_BITS | a_words[i]);
+		a_words[i] = (bqint_word)(num / d);
+		rem = num % d;
+	}
+	return (bqint_word)rem;
+}
+
+// Divide `u_words` by `v_words` (Knuth, TAOCP Vol. 2, 4.3.1 Algorithm D)
+// The operands must be normalized so that the top bit of `v_words` is set,
+// `u_words` has `u_size + 1` words (the top one may be zero) and
+// `u_size >= v_size`. Writes `u_size - v_size + 1` quotient words to
+// `q_words` and leaves the remainder in the low `v_size` words of `u_words`.
+void bqint__divmod_words(bqint_word *q_words,
+		bqint_word *u_words, bqint_size u_size,
+		const bqint_word *v_words, bqint_size v_size)
+{
+	bqint_dword base = (bqint_dword)1 << BQINT_WORD_BITS;
+	bqint_word v_hi = v_words[v_size - 1];
+	bqint_word v_lo = v_size > 1 ? v_words[v_size - 2] : 0;
+	bqint_size i, j;
+
+	for (j = u_size - v_size + 1; j-- > 0; ) {
+		bqint_dword num = (bqint_dword)((bqint_dword)u_words[j + v_size] << BQINT_WORD_BITS
+				| u_words[j + v_size - 1]);
+		bqint_dword qhat = num / v_hi;
+		bqint_dword rhat = num - qhat * v_hi;
+		bqint_dword carry = 0, borrow = 0, t;
+
+		// Estimate the quotient word from the top words, this is at most one
+		// too large after the correction
+		while (qhat >= base || (v_size > 1 && qhat * v_lo
+				> (bqint_dword)(rhat << BQINT_WORD_BITS | u_words[j + v_size - 2]))) {
+			qhat--;
+			rhat += v_hi;
+			if (rhat >= base)
+				break;
+		}
+
+		// Multiply and subtract
+		for (i = 0; i < v_size; i++) {
+			bqint_dword p = qhat * v_words[i] + carry;
+			carry = BQINT__HI(p);
+			t = (bqint_dword)(u_words[i + j] - BQINT__LO(p) - borrow);
+			u_words[i + j] = (bqint_word)t;
+			borrow = BQINT__HI(t) ? 1 : 0;
+		}
+		t = (bqint_dword)(u_words[j + v_size] - carry - borrow);
+		u_words[j + v_size] = (bqint_word)t;
+		q_words[j] = (bqint_word)qhat;
+
+		// The estimate was one too large: Add back
+		if (BQINT__HI(t)) {
+			q_words[j]--;
+			carry = 0;
+			for (i = 0; i < v_size; i++) {
+				t = (bqint_dword)u_words[i + j] + v_words[i] + carry;
+				u_words[i + j] = (bqint_word)t;
+				carry = BQINT__HI(t);
+			}
+			u_words[j + v_size] = (bqint_word)(u_words[j + v_size] + carry);
+		}
+	}
+}
+
+// Inverse of an odd word modulo 2^BQINT_WORD_BITS. Newton's iteration doubles
+// the correct bits starting from x = a which is correct to 3 bits as
+// a^2 = 1 (mod 8).
+bqint_word bqint__inverse_word(bqint_word a)
+{
+	bqint_word x = a;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		x = (bqint_word)((bqint_dword)x * (bqint_word)(2 - (bqint_dword)a * x));
+	return x;
+}
+
+// Exact division from the low words up (Jebelean): replaces the low `q_size`
+// words of `u_words` with the quotient u / v modulo 2^(W q_size), which is
+// the full quotient if `v` divides `u`. `v_words` must be odd and `v_inv` the
+// inverse of its low word.
+void bqint__divexact_words(bqint_word *u_words, bqint_size q_size,
+		const bqint_word *v_words, bqint_size v_size, bqint_word v_inv)
+{
+	bqint_dword p, t, borrow, carry = 0;
+	bqint_size i, j, size;
+
+	for (i = 0; i < q_size; i++) {
+		bqint_word q = (bqint_word)((bqint_dword)u_words[i] * v_inv);
+
+		// Subtract q v from the words still needed, the low word cancels
+		size = q_size - i < v_size ? q_size - i : v_size;
+		borrow = 0;
+		for (j = 0; j < size; j++) {
+			p = (bqint_dword)q * v_words[j] + borrow;
+			t = (bqint_dword)((bqint_dword)u_words[i + j] - BQINT__LO(p));
+			u_words[i + j] = (bqint_word)t;
+			borrow = BQINT__HI(p) + (BQINT__HI(t) ? 1 : 0);
+		}
+
+		// The borrow out of the top word is deferred to the next round
+		if (i + size < q_size) {
+			t = (bqint_dword)((bqint_dword)u_words[i + size] - borrow - carry);
+			u_words[i + size] = (bqint_word)t;
+			carry = BQINT__HI(t) ? 1 : 0;
+		}
+		u_words[i] = q;
+	}
+}
+
+// r = x * a + y * b, or r = x * a - y * b if `sub` is set in which case the
+// result must be non-negative. `r_words` needs room for max(a_size, b_size) + 2
+// words and may be equal to either of the inputs.
+bqint_size bqint__lincomb_words(bqint_word *r_words,
+		const bqint_word *a_words, bqint_size a_size, bqint_word x,
+		const bqint_word *b_words, bqint_size b_size, bqint_word y, int sub)
+{
+	bqint_size i, size = a_size > b_size ? a_size : b_size;
+	bqint_dword a_carry = 0, b_carry = 0, carry = 0, t;
+
+	for (i = 0; i < size; i++) {
+		bqint_dword pa = (bqint_dword)x * (i < a_size ? a_words[i] : 0) + a_carry;
+		bqint_dword pb = (bqint_dword)y * (i < b_size ? b_words[i] : 0) + b_carry;
+		a_carry = BQINT__HI(pa);
+		b_carry = BQINT__HI(pb);
+
+		if (sub) {
+			t = (bqint_dword)(BQINT__LO(pa) - BQINT__LO(pb) - carry);
+			carry = BQINT__HI(t) ? 1 : 0;
+		} else {
+			t = BQINT__LO(pa) + BQINT__LO(pb) + carry;
+			carry = BQINT__HI(t);
+		}
+		r_words[i] = (bqint_word)t;
+	}
+
+	if (sub) {
+		r_words[size++] = (bqint_word)(a_carry - b_carry - carry);
+	} else {
+		t = a_carry + b_carry + carry;
+		r_words[size++] = (bqint_word)t;
+		r_words[size++] = (bqint_word)BQINT__HI(t);
+	}
+
+	while (size > 0 && !r_words[size - 1])
+		size--;
+	return size;
+}
+
+// r = a + b for `size` words, returns the carry, `r` may be `a` or `b`
+bqint_word bqint__add_n_words(bqint_word *r_words,
+		const bqint_word *a_words, const bqint_word *b_words, bqint_size size)
+{
+	bqint_dword t, carry = 0;
+	bqint_size i;
+
+	for (i = 0; i < size; i++) {
+		t = (bqint_dword)a_words[i] + b_words[i] + carry;
+		r_words[i] = (bqint_word)t;
+		carry = BQINT__HI(t);
+	}
+	return (bqint_word)carry;
+}
+
+// r = a - b for `size` words, returns the borrow, `r` may be `a` or `b`
+bqint_word bqint__sub_n_words(bqint_word *r_words,
+		const bqint_word *a_words, const bqint_word *b_words, bqint_size size)
+{
+	bqint_dword t, borrow = 0;
+	bqint_size i;
+
+	for (i = 0; i < size; i++) {
+		t = (bqint_dword)((bqint_dword)a_words[i] - b_words[i] - borrow);
+		r_words[i] = (bqint_word)t;
+		borrow = BQINT__HI(t) ? 1 : 0;
+	}
+	return (bqint_word)borrow;
+}
+
+// Compare two `size` word magnitudes, returns -1, 0 or 1
+int bqint__cmp_n_words(const bqint_word *a_words, const bqint_word *b_words, bqint_size size)
+{
+	bqint_size i;
+
+	for (i = size; i-- > 0; ) {
+		if (a_words[i] != b_words[i])
+			return a_words[i] < b_words[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+// Montgomery multiplication r = a b 2^(-W size) mod n (CIOS), the modulus
+// must be odd, `a, b < n` and `n_inv = -n^-1 mod 2^W`. `t_words` is scratch
+// space of `size + 2` words, `r` may be `a` or `b`.
+void bqint__montmul_words(bqint_word *r_words,
+		const bqint_word *a_words, const bqint_word *b_words,
+		const bqint_word *n_words, bqint_size size, bqint_word n_inv,
+		bqint_word *t_words)
+{
+	bqint_size i, j;
+
+	for (i = 0; i < size + 2; i++)
+		t_words[i] = 0;
+
+	for (i = 0; i < size; i++) {
+		bqint_word a = a_words[i], m;
+		bqint_dword t, carry = 0;
+
+		// t += a[i] b
+		for (j = 0; j < size; j++) {
+			t = (bqint_dword)a * b_words[j] + t_words[j] + carry;
+			t_words[j] = (bqint_word)t;
+			carry = BQINT__HI(t);
+		}
+		t = (bqint_dword)t_words[size] + carry;
+		t_words[size] = (bqint_word)t;
+		t_words[size + 1] = (bqint_word)BQINT__HI(t);
+
+		// t = (t + m n) / 2^W where m is picked so that the low word cancels
+		m = (bqint_word)((bqint_dword)t_words[0] * n_inv);
+		t = (bqint_dword)m * n_words[0] + t_words[0];
+		carry = BQINT__HI(t);
+		for (j = 1; j < size; j++) {
+			t = (bqint_dword)m * n_words[j] + t_words[j] + carry;
+			t_words[j - 1] = (bqint_word)t;
+			carry = BQINT__HI(t);
+		}
+		t = (bqint_dword)t_words[size] + carry;
+		t_words[size - 1] = (bqint_word)t;
+		t_words[size] = (bqint_word)(t_words[size + 1] + BQINT__HI(t));
+	}
+
+	// t < 2n: Subtract n once if needed
+	if (t_words[size] || bqint__cmp_n_words(t_words, n_words, size) >= 0) {
+		bqint__sub_n_words(r_words, t_words, n_words, size);
+	} else {
+		memcpy(r_words, t_words, size * sizeof(bqint_word));
+	}
+}
+
+void bqint_add_inplace(bqint *result, const bqint *a)
+{
+	// TODO: Signs
+	bqint_size res_size = bqint__add_size(a->size > result->size ? a->size : result->size, 1);
+	bqint_word *res_words;
+	bqint_size size;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_ADD_INPLACE, res_size - 1);
+	res_words = bqint__grow(result, &res_size);
+
+	size = bqint__add_words(
+			res_words, res_size,
+			res_words, result->size,
+			bqint_get_words(a), a->size);
+
+	// `result` affects the result of the calculation propagate it's error also
+	result->flags |= a->flags & BQINT_ERROR;
+	bqint__truncate(result, size);
+	BQINT__STAT_END(BQINT_STAT_ADD_INPLACE);
+}
+
+void bqint_add(bqint *result, const bqint *a, const bqint *b)
+{
+	// TODO: Signs
+	bqint_size res_size;
+	bqint_word *res_words;
+	bqint_size size;
+	BQINT__STAT_TIMER
+
+	if (result == a) {
+		bqint_add_inplace(result, b);
+		return;
+	} else if (result == b) {
+		bqint_add_inplace(result, a);
+		return;
+	}
+
+	res_size = bqint__add_size(a->size > b->size ? a->size : b->size, 1);
+	BQINT__STAT_BEGIN(BQINT_STAT_ADD, res_size - 1);
+	res_words = bqint__reserve(result, &res_size);
+
+	size = bqint__add_words(
 			res_words, res_size,
 			bqint_get_words(a), a->size,
 			bqint_get_words(b), b->size);
 
-	// Propagate error flags, note: this overwrites the error of `result` because it's
-	// result doesn't matter at this point anymore
-	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
-	bqint__truncate(result, size);
+	// Propagate error flags, note: this overwrites the error of `result` because it's
+	// result doesn't matter at this point anymore
+	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
+	bqint__truncate(result, size);
+	BQINT__STAT_END(BQINT_STAT_ADD);
+}
+
+void bqint_mul_inplace(bqint *result, const bqint *a)
+{
+	// TODO: Signs
+	bqint_size res_size = bqint__add_size(bqint__add_size(result->size, a->size), 1);
+	bqint_word *res_words;
+	bqint_size size;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_MUL_INPLACE, a->size > result->size ? a->size : result->size);
+	res_words = bqint__grow(result, &res_size);
+
+	size = bqint__mul_words_inplace(
+			res_words, res_size, result->size,
+			bqint_get_words(a), a->size);
+
+	result->flags |= a->flags & BQINT_ERROR;
+	bqint__truncate(result, size);
+	BQINT__STAT_END(BQINT_STAT_MUL_INPLACE);
+}
+
+void bqint_mul(bqint *result, const bqint *a, const bqint *b)
+{
+	// TODO: Signs
+	bqint_size res_size;
+	bqint_word *res_words;
+	bqint_size size;
+	BQINT__STAT_TIMER
+
+	if (result == a) {
+		bqint_mul_inplace(result, b);
+		return;
+	} else if (result == b) {
+		bqint_mul_inplace(result, a);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_MUL, a->size > b->size ? a->size : b->size);
+	res_size = bqint__add_size(bqint__add_size(a->size, b->size), 1);
+	res_words = bqint__reserve(result, &res_size);
+
+	if (a == b) {
+		size = bqint__sqr_words(
+				res_words, res_size,
+				bqint_get_words(a), a->size);
+	} else {
+		size = bqint__mul_words(
+				res_words, res_size,
+				bqint_get_words(a), a->size,
+				bqint_get_words(b), b->size);
+	}
+
+	// Propagate error flags, note: this overwrites the error of `result` because it's
+	// result doesn't matter at this point anymore
+	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
+	bqint__truncate(result, size);
+	BQINT__STAT_END(BQINT_STAT_MUL);
+}
+
+void bqint_sub(bqint *result, const bqint *a, const bqint *b)
+{
+	int cmp;
+	bqint_size size = 0;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SUB, a->size > b->size ? a->size : b->size);
+	cmp = bqint__cmp(a, b);
+
+	if (cmp > 0) {
+		bqint_size res_size = a->size;
+		bqint_word *res_words = bqint__reserve(result, &res_size);
+		size = bqint__sub_words(
+				res_words, res_size,
+				bqint_get_words(a), a->size,
+				bqint_get_words(b), b->size);
+	} else if (cmp < 0) {
+		// A - B = -(A - B)
+		bqint_size res_size = b->size;
+		bqint_word *res_words = bqint__reserve(result, &res_size);
+		size = bqint__sub_words(
+				res_words, res_size,
+				bqint_get_words(b), b->size,
+				bqint_get_words(a), a->size);
+
+		result->flags |= BQINT_NEGATIVE;
+	} else {
+		// A - A = 0
+		bqint_set_zero(result);
+	}
+
+	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
+	bqint__truncate(result, size);
+	BQINT__STAT_END(BQINT_STAT_SUB);
+}
+
+static void bqint__shr(bqint *result, const bqint *a, size_t shift)
+{
+	int neg = (a->flags & BQINT_NEGATIVE) && a->size > 0;
+	int lost = neg && bqint__shr_words_lost(bqint_get_words(a), a->size, shift);
+	bqint_size res_size = a->size;
+	bqint_word *res_words;
+	bqint_size size;
+
+	if (result == a) {
+		res_words = bqint__grow(result, &res_size);
+	} else {
+		res_words = bqint__reserve(result, &res_size);
+	}
+
+	size = bqint__shr_words(res_words, res_size, bqint_get_words(a), a->size, shift);
+
+	// Round negative values towards negative infinity: -x >> s = -((x >> s) + 1)
+	// if any of the set bits were shifted out.
+	// Note: This never needs more words than the original value.
+	if (lost && size != BQINT_MAX_WORDS) {
+		size = bqint__inc_words(res_words, res_size, size);
+	}
+
+	result->flags = bqint__combine_flags(result->flags, a->flags, BQINT_NEGATIVE|BQINT_ERROR);
+	bqint__truncate(result, size);
+}
+
+void bqint_shr_inplace(bqint *result, size_t shift)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SHR, result->size);
+	bqint__shr(result, result, shift);
+	BQINT__STAT_END(BQINT_STAT_SHR);
+}
+
+void bqint_shr(bqint *result, const bqint *a, size_t shift)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SHR, a->size);
+	bqint__shr(result, a, shift);
+	BQINT__STAT_END(BQINT_STAT_SHR);
+}
+
+static void bqint__shl(bqint *result, const bqint *a, size_t shift)
+{
+	bqint_size a_size = a->size;
+	bqint_size res_size = bqint__add_size(a_size, bqint__clamp_size(shift / BQINT_WORD_BITS));
+	bqint_word *res_words;
+	bqint_size size;
+
+	// Reserve an extra word only if the top bits are shifted over the edge
+	if (a_size > 0 && shift % BQINT_WORD_BITS) {
+		bqint_word top = bqint_get_words(a)[a_size - 1];
+		if (top >> (BQINT_WORD_BITS - shift % BQINT_WORD_BITS))
+			res_size = bqint__add_size(res_size, 1);
+	}
+
+	if (result == a) {
+		res_words = bqint__grow(result, &res_size);
+	} else {
+		res_words = bqint__reserve(result, &res_size);
+	}
+
+	size = bqint__shl_words(res_words, res_size, bqint_get_words(a), a_size, shift);
+
+	result->flags = bqint__combine_flags(result->flags, a->flags, BQINT_NEGATIVE|BQINT_ERROR);
+	bqint__truncate(result, size);
+}
+
+void bqint_shl_inplace(bqint *result, size_t shift)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SHL, result->size);
+	bqint__shl(result, result, shift);
+	BQINT__STAT_END(BQINT_STAT_SHL);
+}
+
+void bqint_shl(bqint *result, const bqint *a, size_t shift)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SHL, a->size);
+	bqint__shl(result, a, shift);
+	BQINT__STAT_END(BQINT_STAT_SHL);
+}
+
+static void bqint__bitop(bqint *result, const bqint *a, const bqint *b, int op)
+{
+	int a_neg = (a->flags & BQINT_NEGATIVE) && a->size > 0;
+	int b_neg = (b->flags & BQINT_NEGATIVE) && b->size > 0;
+	int r_neg = 0;
+	bqint_flags err = (a->flags | b->flags) & BQINT_ERROR;
+	bqint_size res_size = bqint__add_size(a->size > b->size ? a->size : b->size, 1);
+	bqint_word *res_words;
+	bqint_size size;
+
+	// The kernels work in place so if the result is one of the operands just
+	// make sure the storage is large enough without losing the value
+	if (result == a || result == b) {
+		res_words = bqint__grow(result, &res_size);
+	} else {
+		res_words = bqint__reserve(result, &res_size);
+	}
+
+	if (!a_neg && !b_neg) {
+		size = bqint__bitop_words(op, res_words, res_size,
+				bqint_get_words(a), a->size,
+				bqint_get_words(b), b->size);
+	} else {
+		size = bqint__bitop_words_signed(op, res_words, res_size,
+				bqint_get_words(a), a->size, a_neg,
+				bqint_get_words(b), b->size, b_neg,
+				&r_neg);
+	}
+
+	result->flags = bqint__combine_flags(result->flags, err, BQINT_ERROR);
+	result->flags = bqint__combine_flags(result->flags, r_neg ? BQINT_NEGATIVE : 0, BQINT_NEGATIVE);
+	bqint__truncate(result, size);
+}
+
+void bqint_and(bqint *result, const bqint *a, const bqint *b)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_AND, a->size > b->size ? a->size : b->size);
+	bqint__bitop(result, a, b, BQINT__BITOP_AND);
+	BQINT__STAT_END(BQINT_STAT_AND);
+}
+
+void bqint_and_inplace(bqint *result, const bqint *a)
+{
+	bqint_and(result, result, a);
+}
+
+void bqint_or(bqint *result, const bqint *a, const bqint *b)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_OR, a->size > b->size ? a->size : b->size);
+	bqint__bitop(result, a, b, BQINT__BITOP_OR);
+	BQINT__STAT_END(BQINT_STAT_OR);
+}
+
+void bqint_or_inplace(bqint *result, const bqint *a)
+{
+	bqint_or(result, result, a);
+}
+
+void bqint_xor(bqint *result, const bqint *a, const bqint *b)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_XOR, a->size > b->size ? a->size : b->size);
+	bqint__bitop(result, a, b, BQINT__BITOP_XOR);
+	BQINT__STAT_END(BQINT_STAT_XOR);
+}
+
+void bqint_xor_inplace(bqint *result, const bqint *a)
+{
+	bqint_xor(result, result, a);
+}
+
+void bqint_andnot(bqint *result, const bqint *a, const bqint *b)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_ANDNOT, a->size > b->size ? a->size : b->size);
+	bqint__bitop(result, a, b, BQINT__BITOP_ANDNOT);
+	BQINT__STAT_END(BQINT_STAT_ANDNOT);
+}
+
+void bqint_andnot_inplace(bqint *result, const bqint *a)
+{
+	bqint_andnot(result, result, a);
+}
+
+void bqint_not(bqint *result, const bqint *a)
+{
+	// ~a = a ^ -1
+	bqint minus_one = bqint_dynamic();
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_NOT, a->size);
+	bqint_set_i32(&minus_one, -1);
+	bqint__bitop(result, a, &minus_one, BQINT__BITOP_XOR);
+	BQINT__STAT_END(BQINT_STAT_NOT);
+}
+
+// Compare the magnitudes of a and b
+static int bqint__cmp_mag(const bqint *a, const bqint *b)
+{
+	const bqint_word *aws, *bws;
+	bqint_size i;
+
+	if (a->size != b->size)
+		return a->size > b->size ? 1 : -1;
+
+	aws = bqint_get_words(a);
+	bws = bqint_get_words(b);
+	for (i = a->size; i-- > 0; ) {
+		if (aws[i] != bws[i])
+			return aws[i] > bws[i] ? 1 : -1;
+	}
+	return 0;
+}
+
+inline static void bqint__swap(bqint *a, bqint *b)
+{
+	bqint tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+// Set the sign of `a` keeping zero non-negative
+inline static void bqint__set_sign(bqint *a, int negative)
+{
+	if (negative && a->size > 0) {
+		a->flags |= BQINT_NEGATIVE;
+	} else {
+		a->flags &= ~BQINT_NEGATIVE;
+	}
+}
+
+// Set `a` to zero with error `flags`, NULL is ignored
+static void bqint__set_error(bqint *a, bqint_flags flags)
+{
+	if (!a)
+		return;
+	a->size = 0;
+	a->flags &= ~BQINT_NEGATIVE;
+	a->flags |= flags;
+}
+
+size_t bqint_bit_length(const bqint *a)
+{
+	if (a->size == 0)
+		return 0;
+	return (size_t)a->size * BQINT_WORD_BITS - bqint__clz_word(bqint_get_words(a)[a->size - 1]);
+}
+
+// Number of set bits in 64 bits
+inline static unsigned bqint__popcount64(uint64_t x)
+{
+#if defined(__GNUC__)
+	return (unsigned)__builtin_popcountll(x);
+#else
+	x = x - (x >> 1 & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + (x >> 2 & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned)(x * 0x0101010101010101ULL >> 56);
+#endif
+}
+
+size_t bqint_popcount(const bqint *a)
+{
+	const bqint_word *words = bqint_get_words(a);
+	size_t i, count = 0, size = a->size;
+	size_t per_block = sizeof(uint64_t) / sizeof(bqint_word);
+
+	// Count 64 bits at a time regardless of the word size
+	for (i = 0; i + per_block <= size; i += per_block) {
+		uint64_t block;
+		memcpy(&block, words + i, sizeof(block));
+		count += bqint__popcount64(block);
+	}
+	for (; i < size; i++) {
+		count += bqint__popcount64(words[i]);
+	}
+	return count;
+}
+
+size_t bqint_ctz(const bqint *a)
+{
+	const bqint_word *words = bqint_get_words(a);
+	bqint_size i = 0;
+
+	if (a->size == 0)
+		return 0;
+	while (!words[i])
+		i++;
+	return (size_t)i * BQINT_WORD_BITS + bqint__ctz_word(words[i]);
+}
+
+int bqint_test_bit(const bqint *a, size_t bit)
+{
+	size_t i = bit / BQINT_WORD_BITS;
+
+	if (i >= a->size)
+		return 0;
+	return bqint_get_words(a)[i] >> (bit % BQINT_WORD_BITS) & 1;
+}
+
+void bqint_set_bit(bqint *a, size_t bit)
+{
+	size_t i = bit / BQINT_WORD_BITS;
+	bqint_size size = a->size, new_size;
+	bqint_word *words;
+
+	if (i >= size) {
+		new_size = bqint__clamp_size(i + 1);
+		words = bqint__grow(a, &new_size);
+		if (i >= new_size) {
+			bqint__truncate(a, BQINT_MAX_WORDS);
+			return;
+		}
+		for (; size <= i; size++) {
+			words[size] = 0;
+		}
+		a->size = size;
+	} else {
+		words = bqint__grow(a, &size);
+	}
+
+	words[i] |= (bqint_word)1 << (bit % BQINT_WORD_BITS);
+}
+
+void bqint_clear_bit(bqint *a, size_t bit)
+{
+	size_t i = bit / BQINT_WORD_BITS;
+	bqint_size size = a->size;
+	bqint_word *words;
+
+	if (i >= size)
+		return;
+
+	words = bqint__grow(a, &size);
+	words[i] &= (bqint_word)~((bqint_word)1 << (bit % BQINT_WORD_BITS));
+	while (size > 0 && !words[size - 1])
+		size--;
+	a->size = size;
+	bqint__set_sign(a, (a->flags & BQINT_NEGATIVE) != 0);
+}
+
+size_t bqint_scan1(const bqint *a, size_t start)
+{
+	const bqint_word *words = bqint_get_words(a);
+	size_t i = start / BQINT_WORD_BITS;
+	bqint_word w;
+
+	if (i >= a->size)
+		return BQINT_BIT_NONE;
+
+	w = (bqint_word)(words[i] & ((bqint_word)~(bqint_word)0 << (start % BQINT_WORD_BITS)));
+	while (!w) {
+		if (++i >= a->size)
+			return BQINT_BIT_NONE;
+		w = words[i];
+	}
+	return i * BQINT_WORD_BITS + bqint__ctz_word(w);
+}
+
+size_t bqint_scan0(const bqint *a, size_t start)
+{
+	const bqint_word *words = bqint_get_words(a);
+	size_t i = start / BQINT_WORD_BITS;
+	bqint_word w;
+
+	if (i >= a->size)
+		return start;
+
+	w = (bqint_word)(~words[i] & ((bqint_word)~(bqint_word)0 << (start % BQINT_WORD_BITS)));
+	while (!w) {
+		if (++i >= a->size)
+			return i * BQINT_WORD_BITS;
+		w = (bqint_word)~words[i];
+	}
+	return i * BQINT_WORD_BITS + bqint__ctz_word(w);
+}
+
+// The word of the magnitude of `a` starting at bit `pos`
+static bqint_word bqint__word_at_bit(const bqint *a, size_t pos)
+{
+	const bqint_word *words = bqint_get_words(a);
+	size_t i = pos / BQINT_WORD_BITS;
+	unsigned shift = (unsigned)(pos % BQINT_WORD_BITS);
+	bqint_word word;
+
+	if (i >= a->size)
+		return 0;
+
+	word = (bqint_word)(words[i] >> shift);
+	if (shift && i + 1 < a->size)
+		word |= (bqint_word)(words[i + 1] << (BQINT_WORD_BITS - shift));
+	return word;
+}
+
+static void bqint__divmod(bqint *quot, bqint *rem, const bqint *a, const bqint *b)
+{
+	bqint_flags err = (a->flags | b->flags) & BQINT_ERROR;
+	int q_neg = ((a->flags ^ b->flags) & BQINT_NEGATIVE) != 0;
+	int r_neg = (a->flags & BQINT_NEGATIVE) != 0;
+	bqint_size a_size = a->size, b_size = b->size;
+	bqint un = bqint_dynamic(), vn = bqint_dynamic(), qt = bqint_dynamic();
+	bqint_size un_size, vn_size, q_size, r_size, size;
+	bqint_word *un_words, *vn_words, *q_words;
+	unsigned shift;
+
+	BQINT_ASSERT(!quot || quot != rem);
+
+	if (b_size == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(quot, err | BQINT_DIV_BY_ZERO);
+		bqint__set_error(rem, err | BQINT_DIV_BY_ZERO);
+		return;
+	}
+
+	// |a| < |b|: The quotient is zero and the remainder is a
+	// Note: Set the remainder first as `quot` may be equal to `a`
+	if (bqint__cmp_mag(a, b) < 0) {
+		if (rem && rem != a)
+			bqint_set(rem, a);
+		if (quot)
+			bqint__set_error(quot, err);
+		if (rem)
+			rem->flags |= err;
+		return;
+	}
+
+	// Normalize the operands so that the top bit of the divisor is set
+	shift = bqint__clz_word(bqint_get_words(b)[b_size - 1]);
+	un_size = a_size + 1;
+	vn_size = b_size;
+	q_size = a_size - b_size + 1;
+	un_words = bqint__reserve(&un, &un_size);
+	vn_words = bqint__reserve(&vn, &vn_size);
+	q_words = bqint__reserve(&qt, &q_size);
+
+	if (un_size <= a_size || vn_size < b_size || q_size < a_size - b_size + 1) {
+		// Out of memory: Already flagged by the failed reservation
+		bqint__set_error(quot, err | BQINT_OUT_OF_MEMORY);
+		bqint__set_error(rem, err | BQINT_OUT_OF_MEMORY);
+	} else {
+		bqint__shl_words(vn_words, b_size, bqint_get_words(b), b_size, shift);
+		size = bqint__shl_words(un_words, un_size, bqint_get_words(a), a_size, shift);
+		if (size <= a_size)
+			un_words[a_size] = 0;
+
+		bqint__divmod_words(q_words, un_words, a_size, vn_words, b_size);
+
+		// Note: `a` and `b` are not used after this so the results may alias them
+		if (rem) {
+			bqint_size res_size;
+			bqint_word *res_words;
+
+			r_size = b_size;
+			while (r_size > 0 && !un_words[r_size - 1])
+				r_size--;
+
+			res_size = r_size;
+			res_words = bqint__reserve(rem, &res_size);
+			size = bqint__shr_words(res_words, res_size, un_words, r_size, shift);
+
+			rem->flags = bqint__combine_flags(rem->flags, err, BQINT_ERROR);
+			bqint__truncate(rem, size);
+			bqint__set_sign(rem, r_neg);
+		}
+
+		if (quot) {
+			while (q_size > 0 && !q_words[q_size - 1])
+				q_size--;
+			qt.size = q_size;
+
+			bqint_set(quot, &qt);
+			quot->flags |= err;
+			bqint__set_sign(quot, q_neg);
+		}
+	}
+
+	bqint_free(&un);
+	bqint_free(&vn);
+	bqint_free(&qt);
+}
+
+void bqint_divmod(bqint *quot, bqint *rem, const bqint *a, const bqint *b)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_DIVMOD, a->size);
+	bqint__divmod(quot, rem, a, b);
+	BQINT__STAT_END(BQINT_STAT_DIVMOD);
+}
+
+void bqint_div(bqint *result, const bqint *a, const bqint *b)
+{
+	bqint_divmod(result, 0, a, b);
+}
+
+void bqint_mod(bqint *result, const bqint *a, const bqint *b)
+{
+	bqint_divmod(0, result, a, b);
+}
+
+// Exact division by a non-zero `b`, the factors of two are shifted out of
+// both operands to make the divisor odd
+static void bqint__divexact(bqint *result, const bqint *a, const bqint *b)
+{
+	int negative = ((a->flags ^ b->flags) & BQINT_NEGATIVE) != 0;
+	size_t zeros = bqint_ctz(b);
+	bqint d = bqint_dynamic();
+	bqint_size size, q_size;
+	bqint_word *words;
+
+	// The odd part of the divisor is a view unless it needs a shift or
+	// `result` is the divisor
+	if (zeros > 0 || result == b) {
+		bqint__shr(&d, b, zeros);
+	} else {
+		d = bqint_view(bqint_get_words(b), b->size);
+	}
+	bqint__shr(result, a, zeros);
+	result->flags |= d.flags & BQINT_ERROR;
+
+	if (result->size < d.size) {
+		bqint__truncate(result, 0);
+	} else {
+		q_size = result->size - d.size + 1;
+		size = result->size;
+		words = bqint__grow(result, &size);
+		bqint__divexact_words(words, q_size, bqint_get_words(&d), d.size,
+				bqint__inverse_word(bqint_get_words(&d)[0]));
+		while (q_size > 0 && !words[q_size - 1])
+			q_size--;
+		bqint__truncate(result, q_size);
+	}
+	bqint__set_sign(result, negative);
+	bqint_free(&d);
+}
+
+void bqint_divexact(bqint *result, const bqint *a, const bqint *b)
+{
+	BQINT__STAT_TIMER
+
+	if (b->size == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(result, ((a->flags | b->flags) & BQINT_ERROR) | BQINT_DIV_BY_ZERO);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_DIVEXACT, a->size);
+	bqint__divexact(result, a, b);
+	BQINT__STAT_END(BQINT_STAT_DIVEXACT);
+}
+
+void bqint_divexact_word(bqint *result, const bqint *a, bqint_word d)
+{
+	bqint b = bqint_view(&d, 1);
+	BQINT__STAT_TIMER
+
+	if (d == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(result, (a->flags & BQINT_ERROR) | BQINT_DIV_BY_ZERO);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_DIVEXACT, a->size);
+	bqint__divexact(result, a, &b);
+	BQINT__STAT_END(BQINT_STAT_DIVEXACT);
+}
+
+// Binary GCD of the non-negative u and v, the result is left in u
+static void bqint__gcd_binary(bqint *u, bqint *v)
+{
+	size_t u_zeros, v_zeros;
+
+	if (v->size == 0)
+		return;
+	if (u->size == 0) {
+		bqint__swap(u, v);
+		return;
+	}
+
+	u_zeros = bqint_ctz(u);
+	v_zeros = bqint_ctz(v);
+	bqint__shr(u, u, u_zeros);
+	bqint__shr(v, v, v_zeros);
+
+	// Both are odd: Replace the larger one with the (even) difference and
+	// remove its factors of two until the values are equal
+	for (;;) {
+		bqint_word *v_words;
+		int cmp = bqint__cmp_mag(u, v);
+		if (cmp == 0)
+			break;
+		if (cmp > 0)
+			bqint__swap(u, v);
+
+		v_words = bqint_get_words(v);
+		v->size = bqint__sub_words(v_words, v->size, v_words, v->size,
+				bqint_get_words(u), u->size);
+		bqint__shr(v, v, bqint_ctz(v));
+	}
+
+	bqint__shl(u, u, u_zeros < v_zeros ? u_zeros : v_zeros);
+}
+
+// r = x * a + y * b, or r = x * a - y * b if `sub` is set
+static void bqint__lincomb(bqint *r, const bqint *a, bqint_word x,
+		const bqint *b, bqint_word y, int sub)
+{
+	bqint_size size = a->size > b->size ? a->size : b->size;
+	bqint_size needed = bqint__add_size(size, 2);
+	bqint_size res_size = needed;
+	bqint_word *res_words = bqint__reserve(r, &res_size);
+
+	if (res_size < needed) {
+		r->size = 0;
+		return;
+	}
+
+	r->size = bqint__lincomb_words(res_words,
+			bqint_get_words(a), a->size, x,
+			bqint_get_words(b), b->size, y, sub);
+}
+
+// [v0, v1] = [m0 v0 + m1 v1, m2 v0 + m3 v1] where the signs of the products
+// in each row are opposite for the remainders (`sub`) and equal for the
+// cofactor magnitudes
+static void bqint__gcd_apply(bqint *v, bqint *tmp, const bqint__sdword *m, int sub)
+{
+	int row;
+
+	for (row = 0; row < 2; row++) {
+		bqint__sdword x = m[row * 2], y = m[row * 2 + 1];
+		bqint_word ax = (bqint_word)(x < 0 ? -x : x);
+		bqint_word ay = (bqint_word)(y < 0 ? -y : y);
+
+		if (!sub || x > 0 || y < 0) {
+			bqint__lincomb(&tmp[row], &v[0], ax, &v[1], ay, sub);
+		} else {
+			bqint__lincomb(&tmp[row], &v[1], ay, &v[0], ax, sub);
+		}
+	}
+
+	bqint__swap(&v[0], &tmp[0]);
+	bqint__swap(&v[1], &tmp[1]);
+}
+
+// v[1] = v[0] + q v[1], v[0] = old v[1]
+static void bqint__gcd_cofactor_step(bqint *v, const bqint *q, bqint *tmp)
+{
+	bqint_mul(tmp, q, &v[1]);
+	bqint_add_inplace(tmp, &v[0]);
+	bqint__swap(&v[0], &v[1]);
+	bqint__swap(&v[1], tmp);
+}
+
+// Euclid's algorithm on the non-negative r[0] and r[1] using Lehmer's method
+// (Knuth, TAOCP Vol. 2, 4.5.2 Algorithm L): The quotients are simulated with
+// the leading words of the operands for as long as they are guaranteed to
+// match the full precision ones and then applied at once as a 2x2 matrix.
+// Afterwards r[0] is the GCD and r[1] zero. If `s` or `t` is not NULL it
+// points to two cofactor magnitudes (initialized by the caller) that are
+// updated by each step, the n:th cofactor in the sequence has the sign (-1)^n.
+// Returns the number of steps taken.
+static size_t bqint__gcd_lehmer(bqint *r, bqint *s, bqint *t)
+{
+	const bqint__sdword word_max = ((bqint__sdword)1 << BQINT_WORD_BITS) - 1;
+	bqint tmp[2], q = bqint_dynamic();
+	size_t steps = 0;
+
+	tmp[0] = bqint_dynamic();
+	tmp[1] = bqint_dynamic();
+
+	while (r[1].size > 0) {
+		bqint__sdword m[4] = { 1, 0, 0, 1 };
+		size_t num = 0;
+
+		if (r[1].size >= 2 && bqint__cmp_mag(&r[0], &r[1]) >= 0) {
+			size_t pos = bqint_bit_length(&r[0]) - BQINT_WORD_BITS;
+			bqint__sdword x = bqint__word_at_bit(&r[0], pos);
+			bqint__sdword y = bqint__word_at_bit(&r[1], pos);
+
+			for (;;) {
+				bqint__sdword qw, n2, n3;
+				bqint__sdword a0 = m[0] < 0 ? -m[0] : m[0], a1 = m[1] < 0 ? -m[1] : m[1];
+				bqint__sdword a2 = m[2] < 0 ? -m[2] : m[2], a3 = m[3] < 0 ? -m[3] : m[3];
+
+				if (y + m[2] <= 0 || y + m[3] <= 0)
+					break;
+				qw = (x + m[0]) / (y + m[2]);
+				if (qw != (x + m[1]) / (y + m[3]))
+					break;
+
+				// Keep the matrix within single words
+				if ((a2 && qw > (word_max - a0) / a2) || (a3 && qw > (word_max - a1) / a3))
+					break;
+
+				n2 = m[0] - qw * m[2];
+				n3 = m[1] - qw * m[3];
+				m[0] = m[2];
+				m[1] = m[3];
+				m[2] = n2;
+				m[3] = n3;
+
+				n2 = x - qw * y;
+				x = y;
+				y = n2;
+				num++;
+			}
+		}
+
+		if (num == 0) {
+			// Full precision step
+			bqint__divmod(&q, &r[0], &r[0], &r[1]);
+			bqint__swap(&r[0], &r[1]);
+			if (s)
+				bqint__gcd_cofactor_step(s, &q, &tmp[0]);
+			if (t)
+				bqint__gcd_cofactor_step(t, &q, &tmp[0]);
+			steps++;
+		} else {
+			bqint__gcd_apply(r, tmp, m, 1);
+			if (s)
+				bqint__gcd_apply(s, tmp, m, 0);
+			if (t)
+				bqint__gcd_apply(t, tmp, m, 0);
+			steps += num;
+		}
+	}
+
+	r[0].flags |= (tmp[0].flags | tmp[1].flags | q.flags) & BQINT_ERROR;
+
+	bqint_free(&tmp[0]);
+	bqint_free(&tmp[1]);
+	bqint_free(&q);
+	return steps;
+}
+
+// Copy the magnitude of `a` to `result`, the words are always owned by
+// `result` as the callers modify them in place
+static void bqint__set_abs(bqint *result, const bqint *a)
+{
+	bqint_set(result, a);
+	if (result->flags & BQINT_SHARED)
+		bqint__detach(result);
+	result->flags &= ~BQINT_NEGATIVE;
+}
+
+void bqint_gcd(bqint *result, const bqint *a, const bqint *b)
+{
+	bqint r[2];
+	size_t threshold;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_GCD, a->size > b->size ? a->size : b->size);
+	r[0] = bqint_dynamic();
+	r[1] = bqint_dynamic();
+	bqint__set_abs(&r[0], a);
+	bqint__set_abs(&r[1], b);
+
+	threshold = bqint_get_threshold(BQINT_THRESHOLD_GCD_LEHMER);
+	if (r[0].size <= threshold && r[1].size <= threshold) {
+		bqint__gcd_binary(&r[0], &r[1]);
+	} else {
+		bqint__gcd_lehmer(r, 0, 0);
+	}
+
+	bqint_set(result, &r[0]);
+	result->flags |= (r[1].flags | a->flags | b->flags) & BQINT_ERROR;
+
+	bqint_free(&r[0]);
+	bqint_free(&r[1]);
+	BQINT__STAT_END(BQINT_STAT_GCD);
+}
+
+void bqint_gcdext(bqint *g, bqint *s, bqint *t, const bqint *a, const bqint *b)
+{
+	bqint r[2], sc[2], tc[2];
+	bqint_flags err;
+	size_t steps;
+	int i;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_GCDEXT, a->size > b->size ? a->size : b->size);
+	for (i = 0; i < 2; i++) {
+		r[i] = bqint_dynamic();
+		sc[i] = bqint_dynamic();
+		tc[i] = bqint_dynamic();
+	}
+	bqint__set_abs(&r[0], a);
+	bqint__set_abs(&r[1], b);
+	bqint_set_u32(&sc[0], 1);
+	bqint_set_u32(&tc[1], 1);
+
+	steps = bqint__gcd_lehmer(r, s ? sc : 0, t ? tc : 0);
+	err = (a->flags | b->flags | r[0].flags | sc[0].flags | tc[0].flags) & BQINT_ERROR;
+
+	// The cofactor of `a` is negative after an odd number of steps and the
+	// one of `b` after an even number, flipped for negative inputs. The error
+	// flags of the outputs are replaced so stale errors don't survive.
+	if (s) {
+		bqint_set(s, &sc[0]);
+		s->flags = bqint__combine_flags(s->flags, err, BQINT_ERROR);
+		bqint__set_sign(s, (int)(steps & 1) ^ ((a->flags & BQINT_NEGATIVE) != 0));
+	}
+	if (t) {
+		bqint_set(t, &tc[0]);
+		t->flags = bqint__combine_flags(t->flags, err, BQINT_ERROR);
+		bqint__set_sign(t, (int)(~steps & 1) ^ ((b->flags & BQINT_NEGATIVE) != 0));
+	}
+	if (g) {
+		bqint_set(g, &r[0]);
+		g->flags = bqint__combine_flags(g->flags, err, BQINT_ERROR);
+	}
+
+	for (i = 0; i < 2; i++) {
+		bqint_free(&r[i]);
+		bqint_free(&sc[i]);
+		bqint_free(&tc[i]);
+	}
+	BQINT__STAT_END(BQINT_STAT_GCDEXT);
+}
+
+int bqint_invmod(bqint *result, const bqint *a, const bqint *m)
+{
+	bqint mod = bqint_dynamic(), r[2], tc[2];
+	bqint_flags err = (a->flags | m->flags) & BQINT_ERROR;
+	size_t steps;
+	int i, ok;
+	BQINT__STAT_TIMER
+
+	if (m->size == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(result, err | BQINT_DIV_BY_ZERO);
+		return 0;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_INVMOD, a->size > m->size ? a->size : m->size);
+	for (i = 0; i < 2; i++) {
+		r[i] = bqint_dynamic();
+		tc[i] = bqint_dynamic();
+	}
+
+	// Run Euclid on (|m|, a mod |m|) tracking the cofactor of the latter
+	bqint__set_abs(&mod, m);
+	bqint__set_abs(&r[0], m);
+	bqint__divmod(0, &r[1], a, &mod);
+	if (r[1].flags & BQINT_NEGATIVE) {
+		r[1].flags &= ~BQINT_NEGATIVE;
+		bqint_sub(&tc[0], &mod, &r[1]);
+		bqint__swap(&r[1], &tc[0]);
+		bqint_set_zero(&tc[0]);
+	}
+	bqint_set_u32(&tc[1], 1);
+
+	steps = bqint__gcd_lehmer(r, 0, tc);
+	err |= (r[0].flags | r[1].flags | tc[0].flags) & BQINT_ERROR;
+	ok = r[0].size == 1 && bqint_get_words(&r[0])[0] == 1;
+
+	if (!ok) {
+		bqint__set_error(result, err);
+	} else if (!(steps & 1) && tc[0].size > 0) {
+		// Negative cofactor: result = |m| - |t|, computed in a temporary as
+		// `result` may be too small to hold |m|
+		bqint_set_zero(&tc[1]);
+		bqint_sub(&tc[1], &mod, &tc[0]);
+		bqint_set(result, &tc[1]);
+		result->flags |= err;
+	} else {
+		bqint_set(result, &tc[0]);
+		result->flags |= err;
+	}
+
+	bqint_free(&mod);
+	for (i = 0; i < 2; i++) {
+		bqint_free(&r[i]);
+		bqint_free(&tc[i]);
+	}
+	BQINT__STAT_END(BQINT_STAT_INVMOD);
+	return ok;
+}
+
+void bqint_pow(bqint *result, const bqint *base, uint32_t exp)
+{
+	bqint m = bqint_dynamic(), x = bqint_dynamic(), t = bqint_dynamic();
+	bqint table[8];
+	bqint_flags err = base->flags & BQINT_ERROR;
+	int negative = (base->flags & BQINT_NEGATIVE) && (exp & 1);
+	size_t zeros, bits, m_bits, res_bits, shift, num_table = 1;
+	unsigned window = 1, exp_bits = 0;
+	int i;
+	BQINT__STAT_TIMER
+
+	if (exp == 0 || base->size == 0) {
+		bqint_set_u32(result, exp == 0);
+		result->flags |= err;
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_POW, base->size);
+
+	// base^exp = m^exp 2^(zeros exp) where m is odd
+	zeros = bqint_ctz(base);
+	bits = bqint_bit_length(base);
+	m_bits = bits - zeros;
+	bqint__shr(&m, base, zeros);
+	m.flags &= ~BQINT_NEGATIVE;
+
+	while (exp_bits < 32 && exp >> exp_bits)
+		exp_bits++;
+
+	// m^exp < 2^(m_bits exp), saturate at the largest representable size to
+	// let the multiplications flag the truncation
+	if (m_bits > ((size_t)BQINT_MAX_WORDS * BQINT_WORD_BITS) / exp) {
+		res_bits = (size_t)BQINT_MAX_WORDS * BQINT_WORD_BITS;
+	} else {
+		res_bits = m_bits * exp;
+	}
+
+	// Enough for the partial products as bqint_mul() reserves an extra word
+	// Note: The table of the window (up to m^15) is only used when exp >= 16
+	bqint_reserve(&x, bqint__add_size(bqint__clamp_size(res_bits / BQINT_WORD_BITS), 3));
+	bqint_reserve(&t, x.capacity);
+
+	// Odd powers m, m^3, ..., m^(2^window - 1) for the sliding window
+	if (exp_bits > 24) {
+		window = 4;
+	} else if (exp_bits > 12) {
+		window = 3;
+	} else if (exp_bits > 4) {
+		window = 2;
+	}
+	if (m_bits == 1)
+		window = 1;
+
+	table[0] = m;
+	if (window > 1) {
+		num_table = (size_t)1 << (window - 1);
+		bqint_mul(&t, &m, &m);
+		for (i = 1; i < (int)num_table; i++) {
+			table[i] = bqint_dynamic();
+			bqint_mul(&table[i], &table[i - 1], &t);
+		}
+	}
+
+	bqint_set_u32(&x, 1);
+	if (m_bits > 1) {
+		for (i = (int)exp_bits - 1; i >= 0; ) {
+			int low, first = i == (int)exp_bits - 1;
+			uint32_t value;
+
+			if (!(exp >> i & 1)) {
+				bqint_mul(&t, &x, &x);
+				bqint__swap(&x, &t);
+				i--;
+				continue;
+			}
+
+			// Longest window ending with a set bit
+			low = i - (int)window + 1;
+			if (low < 0)
+				low = 0;
+			while (!(exp >> low & 1))
+				low++;
+			value = (exp >> low) & (((uint32_t)2 << (i - low)) - 1);
+
+			if (first) {
+				bqint_set(&x, &table[value / 2]);
+			} else {
+				for (; i >= low; i--) {
+					bqint_mul(&t, &x, &x);
+					bqint__swap(&x, &t);
+				}
+				bqint_mul(&t, &x, &table[value / 2]);
+				bqint__swap(&x, &t);
+			}
+			i = low - 1;
+		}
+	}
+
+	shift = zeros > (size_t)-1 / exp ? (size_t)-1 : zeros * exp;
+	bqint__shl(result, &x, shift);
+	for (i = 0; i < (int)num_table; i++) {
+		err |= table[i].flags & BQINT_ERROR;
+	}
+	result->flags |= err | (t.flags & BQINT_ERROR);
+	bqint__set_sign(result, negative);
+
+	bqint_free(&x);
+	bqint_free(&t);
+	for (i = 0; i < (int)num_table; i++) {
+		bqint_free(&table[i]);
+	}
+	BQINT__STAT_END(BQINT_STAT_POW);
+}
+
+void bqint_pow_word(bqint *result, uint32_t base, uint32_t exp)
+{
+	bqint b = bqint_dynamic();
+
+	bqint_set_u32(&b, base);
+	bqint_pow(result, &b, exp);
+	bqint_free(&b);
+}
+
+// result = a * b with the sign of the product
+static void bqint__mul_signed(bqint *result, const bqint *a, const bqint *b)
+{
+	int negative = ((a->flags ^ b->flags) & BQINT_NEGATIVE) != 0;
+
+	bqint_mul(result, a, b);
+	bqint__set_sign(result, negative);
+}
+
+// result = a + b with signs, `result` must not be `a` or `b`
+static void bqint__add_signed(bqint *result, const bqint *a, const bqint *b)
+{
+	int a_neg = (a->flags & BQINT_NEGATIVE) != 0;
+	int b_neg = (b->flags & BQINT_NEGATIVE) != 0;
+	bqint_size res_size;
+	bqint_word *res_words;
+
+	if (a_neg == b_neg) {
+		bqint_add(result, a, b);
+		bqint__set_sign(result, a_neg);
+		return;
+	}
+
+	// Different signs: Subtract the smaller magnitude from the larger one
+	if (bqint__cmp_mag(a, b) < 0) {
+		const bqint *tmp = a;
+		a = b;
+		b = tmp;
+		a_neg = b_neg;
+	}
+
+	res_size = a->size;
+	res_words = bqint__reserve(result, &res_size);
+	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
+	bqint__truncate(result, bqint__sub_words(
+			res_words, res_size,
+			bqint_get_words(a), a->size,
+			bqint_get_words(b), b->size));
+	bqint__set_sign(result, a_neg);
+}
+
+// Number of levels of a balanced binary tree with `count` leaves
+static size_t bqint__tree_depth(size_t count)
+{
+	size_t depth = 1;
+	while (count > 1) {
+		count = (count + 1) / 2;
+		depth++;
+	}
+	return depth;
+}
+
+// Product of the magnitudes of `count > 0` factors, the two halves of each
+// level are stored in `scratch` (two values per level)
+static void bqint__product_tree(bqint *result, const bqint *factors, size_t count, bqint *scratch)
+{
+	size_t half = count / 2;
+
+	if (count == 1) {
+		bqint_set(result, &factors[0]);
+		return;
+	} else if (count == 2) {
+		bqint_mul(result, &factors[0], &factors[1]);
+		return;
+	}
+
+	bqint__product_tree(&scratch[0], factors, half, scratch + 2);
+	bqint__product_tree(&scratch[1], factors + half, count - half, scratch + 2);
+	bqint_mul(result, &scratch[0], &scratch[1]);
+}
+
+// Multiply the magnitudes of either `factors` or `words` in a balanced tree
+static void bqint__product(bqint *result, const bqint *factors,
+		const bqint_word *words, size_t count)
+{
+	size_t i, num_leaves = 0, num_scratch = 2 * bqint__tree_depth(count);
+	size_t bytes = (count + 1 + num_scratch) * sizeof(bqint) + (count + 1) * sizeof(bqint_word);
+	bqint *leaves, *scratch;
+	bqint_word *packed;
+	bqint_dword acc = 1;
+	bqint prod = bqint_dynamic();
+
+	leaves = (bqint*)bqint_alloc_memory(bytes);
+	if (!leaves) {
+		BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+		BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+		bqint__set_error(result, BQINT_OUT_OF_MEMORY);
+		return;
+	}
+	BQINT__STAT_ALLOC(bytes);
+	scratch = leaves + count + 1;
+	packed = (bqint_word*)(scratch + num_scratch);
+
+	// Pack runs of single word factors into words, the leaves are views to the
+	// packed words or the larger factors
+	for (i = 0; i < count; i++) {
+		bqint_size size = factors ? factors[i].size : 1;
+		bqint_word word = factors ? bqint_get_words(&factors[i])[0] : words[i];
+
+		if (size == 1 && !BQINT__HI(acc * word)) {
+			acc *= word;
+		} else if (size == 1) {
+			packed[num_leaves] = (bqint_word)acc;
+			leaves[num_leaves] = bqint_view(&packed[num_leaves], 1);
+			num_leaves++;
+			acc = word;
+		} else {
+			leaves[num_leaves++] = bqint_view(bqint_get_words(&factors[i]), factors[i].size);
+		}
+	}
+	if (acc > 1 || num_leaves == 0) {
+		packed[num_leaves] = (bqint_word)acc;
+		leaves[num_leaves] = bqint_view(&packed[num_leaves], 1);
+		num_leaves++;
+	}
+
+	for (i = 0; i < num_scratch; i++) {
+		scratch[i] = bqint_dynamic();
+	}
+
+	bqint__product_tree(&prod, leaves, num_leaves, scratch);
+	bqint_set(result, &prod);
+	result->flags |= prod.flags & BQINT_ERROR;
+
+	for (i = 0; i < num_scratch; i++) {
+		result->flags |= scratch[i].flags & BQINT_ERROR;
+		bqint_free(&scratch[i]);
+	}
+	bqint_free(&prod);
+	BQINT__STAT_FREE(bytes);
+	bqint_free_memory(leaves);
+}
+
+void bqint_product(bqint *result, const bqint *factors, size_t count)
+{
+	bqint_flags err = 0;
+	int negative = 0, zero = 0;
+	size_t i;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_PRODUCT, count > 0 ? factors[0].size : 0);
+	for (i = 0; i < count; i++) {
+		err |= factors[i].flags & BQINT_ERROR;
+		if (factors[i].flags & BQINT_NEGATIVE)
+			negative = !negative;
+		if (factors[i].size == 0)
+			zero = 1;
+	}
+
+	if (zero) {
+		bqint_set_zero(result);
+	} else {
+		bqint__product(result, factors, 0, count);
+		bqint__set_sign(result, negative);
+	}
+	result->flags |= err;
+	BQINT__STAT_END(BQINT_STAT_PRODUCT);
+}
+
+void bqint_product_words(bqint *result, const bqint_word *words, size_t count)
+{
+	size_t i;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_PRODUCT, 1);
+	for (i = 0; i < count; i++) {
+		if (!words[i])
+			break;
+	}
+
+	if (i < count) {
+		bqint_set_zero(result);
+	} else {
+		bqint__product(result, 0, words, count);
+		result->flags &= ~BQINT_NEGATIVE;
+	}
+	BQINT__STAT_END(BQINT_STAT_PRODUCT);
+}
+
+// Fold the carry lanes of the positive and negative terms into the two's
+// complement sum `r_words` and clear them, carries out of the top are dropped
+static void bqint__dot_fold(bqint_word *r_words, bqint_dword *lanes, bqint_size size)
+{
+	bqint_dword *pos = lanes, *neg = lanes + size;
+	bqint_dword carry = 0, borrow = 0, t;
+	bqint_size i;
+
+	for (i = 0; i < size; i++) {
+		t = (bqint_dword)r_words[i] + BQINT__LO(pos[i]) + carry;
+		carry = BQINT__HI(t) + BQINT__HI(pos[i]);
+		r_words[i] = BQINT__LO(t);
+
+		t = BQINT__LO(neg[i]) + borrow;
+		borrow = BQINT__HI(neg[i]) + BQINT__HI(t) + (BQINT__LO(t) > r_words[i]);
+		r_words[i] = (bqint_word)(r_words[i] - BQINT__LO(t));
+
+		pos[i] = 0;
+		neg[i] = 0;
+	}
+}
+
+void bqint_dot(bqint *result, const bqint *a, const bqint *b, size_t count)
+{
+	bqint tmp = bqint_dynamic();
+	bqint sq = bqint_dynamic();
+	bqint *acc = result;
+	bqint_word *r_words;
+	bqint_dword *lanes = 0;
+	bqint_flags err = 0;
+	bqint_size size = 0, res_size, i;
+	size_t n, k, pending = 0;
+	int negative;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_DOT, count > 0 ? a[0].size : 0);
+	for (n = 0; n < count; n++) {
+		err |= (a[n].flags | b[n].flags) & BQINT_ERROR;
+		if (a[n].size && b[n].size && bqint__add_size(a[n].size, b[n].size) > size)
+			size = bqint__add_size(a[n].size, b[n].size);
+		if (result == &a[n] || result == &b[n])
+			acc = &tmp;
+	}
+
+	if (size == 0) {
+		bqint_set_zero(result);
+		result->flags |= err;
+		BQINT__STAT_END(BQINT_STAT_DOT);
+		return;
+	}
+
+	// Room for the sum of `count` terms and a sign bit
+	for (k = count; k; k = k >> (BQINT_WORD_BITS - 1) >> 1)
+		size = bqint__add_size(size, 1);
+	size = bqint__add_size(size, 1);
+
+	res_size = size;
+	r_words = bqint__reserve(acc, &res_size);
+	if (res_size < size && acc == result) {
+		acc = &tmp;
+		res_size = size;
+		r_words = bqint__reserve(acc, &res_size);
+	}
+	if (res_size == size) {
+		lanes = (bqint_dword*)bqint_alloc_memory(2 * size * sizeof(bqint_dword));
+		if (lanes) {
+			BQINT__STAT_ALLOC(2 * size * sizeof(bqint_dword));
+		} else {
+			BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+			BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+		}
+	}
+	if (!lanes) {
+		bqint_set_zero(result);
+		bqint__set_error(result, err | BQINT_OUT_OF_MEMORY);
+		bqint_free(&tmp);
+		BQINT__STAT_END(BQINT_STAT_DOT);
+		return;
+	}
+
+	for (i = 0; i < size; i++) {
+		r_words[i] = 0;
+		lanes[i] = 0;
+		lanes[size + i] = 0;
+	}
+
+	for (n = 0; n < count; n++) {
+		const bqint *x = &a[n], *y = &b[n];
+		const bqint_word *x_words, *y_words;
+		int subtract = ((x->flags ^ y->flags) & BQINT_NEGATIVE) != 0;
+		bqint_dword *carries = lanes + (subtract ? size : 0);
+		bqint_word carry;
+
+		if (!x->size || !y->size)
+			continue;
+		if (x->size < y->size) {
+			const bqint *t = x;
+			x = y;
+			y = t;
+		}
+		x_words = bqint_get_words(x);
+		y_words = bqint_get_words(y);
+
+		// Every lane takes at most one carry word per term, fold them before
+		// they could overflow
+		if (pending >= (bqint_word)~(bqint_word)0 - 1) {
+			bqint__dot_fold(r_words, lanes, size);
+			pending = 0;
+		}
+		pending++;
+
+		if (x_words == y_words && x->size == y->size && x->size > 1) {
+			bqint_size sq_size = bqint__add_size(x->size, x->size);
+			bqint_word *sq_words = bqint__reserve(&sq, &sq_size);
+
+			if (sq_size < bqint__add_size(x->size, x->size)) {
+				err |= sq.flags & BQINT_ERROR;
+				continue;
+			}
+			bqint__sqr_words(sq_words, sq_size, x_words, x->size);
+			if (subtract)
+				carry = bqint__sub_n_words(r_words, r_words, sq_words, sq_size);
+			else
+				carry = bqint__add_n_words(r_words, r_words, sq_words, sq_size);
+			carries[sq_size] += carry;
+			continue;
+		}
+
+		for (i = 0; i < y->size; i++) {
+			if (subtract)
+				carry = bqint__submul_1_words(r_words + i, x_words, x->size, y_words[i]);
+			else
+				carry = bqint__addmul_1_words(r_words + i, x_words, x->size, y_words[i]);
+			carries[i + x->size] += carry;
+		}
+	}
+	bqint__dot_fold(r_words, lanes, size);
+
+	BQINT__STAT_FREE(2 * size * sizeof(bqint_dword));
+	bqint_free_memory(lanes);
+	bqint_free(&sq);
+
+	// Back from two's complement to sign and magnitude
+	negative = r_words[size - 1] >> (BQINT_WORD_BITS - 1);
+	if (negative) {
+		bqint_word carry = 1;
+		for (i = 0; i < size; i++) {
+			r_words[i] = (bqint_word)(~r_words[i] + carry);
+			carry = carry && !r_words[i];
+		}
+	}
+	i = size;
+	while (i > 0 && !r_words[i - 1])
+		i--;
+	bqint__truncate(acc, i);
+	acc->flags = bqint__combine_flags(acc->flags, err, BQINT_ERROR);
+	bqint__set_sign(acc, negative);
+
+	if (acc != result) {
+		bqint_set(result, acc);
+		result->flags |= acc->flags & BQINT_ERROR;
+	}
+	bqint_free(&tmp);
+	BQINT__STAT_END(BQINT_STAT_DOT);
+}
+
+// Binary splitting of the terms [begin, end) to p, q and t, the right half
+// of each level goes to `scratch` (five values per level)
+static void bqint__bsplit(bqint *p, bqint *q, bqint *t, size_t begin, size_t end,
+		bqint_series_fn term, void *user, bqint *scratch)
+{
+	bqint *p_right = &scratch[0], *q_right = &scratch[1], *t_right = &scratch[2];
+	bqint *x = &scratch[3], *y = &scratch[4];
+	size_t mid = begin + (end - begin) / 2;
+
+	if (end - begin == 1) {
+		// t = a(n) p(n)
+		term(user, begin, p, q, x);
+		bqint__mul_signed(t, x, p);
+		return;
+	}
+
+	// The left half can use the scratch of this level as it's done before
+	// the right half is stored there
+	bqint__bsplit(p, q, t, begin, mid, term, user, scratch);
+	bqint__bsplit(p_right, q_right, t_right, mid, end, term, user, scratch + 5);
+
+	// t = q_right t_left + p_left t_right
+	bqint__mul_signed(x, q_right, t);
+	bqint__mul_signed(y, p, t_right);
+	bqint__add_signed(t, x, y);
+
+	bqint__mul_signed(x, p, p_right);
+	bqint__swap(p, x);
+	bqint__mul_signed(x, q, q_right);
+	bqint__swap(q, x);
+}
+
+void bqint_bsplit(bqint *p, bqint *q, bqint *t, size_t begin, size_t end,
+		bqint_series_fn term, void *user)
+{
+	bqint res[3];
+	bqint *scratch;
+	bqint_flags err = 0;
+	size_t i, num_scratch = 0, bytes = 0;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_BSPLIT, end > begin ? end - begin : 0);
+	for (i = 0; i < 3; i++) {
+		res[i] = bqint_dynamic();
+	}
+
+	if (end <= begin) {
+		// Empty sum
+		bqint_set_u32(&res[0], 1);
+		bqint_set_u32(&res[1], 1);
+	} else {
+		num_scratch = 5 * bqint__tree_depth(end - begin);
+		bytes = num_scratch * sizeof(bqint);
+		scratch = (bqint*)bqint_alloc_memory(bytes);
+		if (scratch) {
+			BQINT__STAT_ALLOC(bytes);
+			for (i = 0; i < num_scratch; i++) {
+				scratch[i] = bqint_dynamic();
+			}
+
+			bqint__bsplit(&res[0], &res[1], &res[2], begin, end, term, user, scratch);
+
+			for (i = 0; i < num_scratch; i++) {
+				err |= scratch[i].flags & BQINT_ERROR;
+				bqint_free(&scratch[i]);
+			}
+			BQINT__STAT_FREE(bytes);
+			bqint_free_memory(scratch);
+		} else {
+			BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+			BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+			err |= BQINT_OUT_OF_MEMORY;
+		}
+	}
+
+	for (i = 0; i < 3; i++) {
+		bqint *r = i == 0 ? p : i == 1 ? q : t;
+		if (r) {
+			bqint_set(r, &res[i]);
+			r->flags |= err | (res[i].flags & BQINT_ERROR);
+		}
+		bqint_free(&res[i]);
+	}
+	BQINT__STAT_END(BQINT_STAT_BSPLIT);
+}
+
+// Floor of the k:th root of the non-negative `n`, `result` must not be `n`
+static void bqint__root(bqint *result, const bqint *n, uint32_t k)
+{
+	size_t bits = bqint_bit_length(n);
+	bqint x = bqint_dynamic(), y = bqint_dynamic(), q = bqint_dynamic();
+	bqint p = bqint_dynamic(), tmp = bqint_dynamic(), kb = bqint_dynamic();
+
+	if (bits == 0 || k == 1) {
+		bqint_set(result, n);
+		return;
+	}
+
+	if (bits <= (size_t)k * BQINT_WORD_BITS) {
+		// Small enough: Start from 2^ceil(bits / k)
+		bqint_set_u32(&x, 1);
+		bqint__shl(&x, &x, (bits + k - 1) / k);
+	} else {
+		// Root of the top half of the bits scaled back, rounded up to make
+		// sure the estimate is not below the root:
+		// (floor(root(n / 2^(k s))) + 1) 2^s > root(n)
+		size_t s = bits / (2 * (size_t)k);
+		bqint__shr(&tmp, n, s * k);
+		bqint__root(&x, &tmp, k);
+		bqint_set_u32(&tmp, 1);
+		bqint_add_inplace(&x, &tmp);
+		bqint__shl(&x, &x, s);
+	}
+
+	// Starting from above the root the iteration decreases monotonically
+	// until it reaches the floor of the root, which is the first estimate
+	// with x^k <= n:
+	// x' = ((k - 1) x + n / x^(k - 1)) / k
+	// Note: The initial estimate is always above the root.
+	bqint_set_u32(&kb, k);
+	for (;;) {
+		const bqint *xk1 = &x;
+		if (k > 2) {
+			bqint_pow(&p, &x, k - 1);
+			xk1 = &p;
+		}
+
+		bqint__divmod(&q, 0, n, xk1);
+		bqint_set_u32(&tmp, k - 1);
+		bqint_mul(&y, &x, &tmp);
+		bqint_add_inplace(&y, &q);
+		bqint__divmod(&x, 0, &y, &kb);
+
+		if (k > 2) {
+			bqint_pow(&p, &x, k);
+		} else {
+			bqint_mul(&p, &x, &x);
+		}
+		if (bqint__cmp_mag(&p, n) <= 0)
+			break;
+	}
+
+	bqint_set(result, &x);
+	result->flags |= (y.flags | q.flags | p.flags | tmp.flags) & BQINT_ERROR;
+
+	bqint_free(&x);
+	bqint_free(&y);
+	bqint_free(&q);
+	bqint_free(&p);
+	bqint_free(&tmp);
+	bqint_free(&kb);
+}
+
+// Flag a domain error in the non-NULL results
+static void bqint__domain_error(bqint *a, bqint *b, bqint_flags err)
+{
+	BQINT_ASSERT_FLAG_SET(BQINT_DOMAIN_ERROR);
+	BQINT__STAT_ERROR(BQINT_DOMAIN_ERROR);
+	bqint__set_error(a, err | BQINT_DOMAIN_ERROR);
+	bqint__set_error(b, err | BQINT_DOMAIN_ERROR);
+}
+
+void bqint_sqrtrem(bqint *root, bqint *rem, const bqint *a)
+{
+	bqint n = bqint_dynamic(), r = bqint_dynamic(), sq = bqint_dynamic();
+	bqint_flags err = a->flags & BQINT_ERROR;
+	BQINT__STAT_TIMER
+
+	if ((a->flags & BQINT_NEGATIVE) && a->size > 0) {
+		bqint__domain_error(root, rem, err);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SQRTREM, a->size);
+	bqint_set(&n, a);
+	bqint__root(&r, &n, 2);
+
+	if (rem) {
+		bqint_mul(&sq, &r, &r);
+		bqint_sub(rem, &n, &sq);
+		rem->flags |= (err | r.flags | sq.flags) & BQINT_ERROR;
+	}
+	if (root) {
+		bqint_set(root, &r);
+		root->flags |= err;
+	}
+
+	bqint_free(&n);
+	bqint_free(&r);
+	bqint_free(&sq);
+	BQINT__STAT_END(BQINT_STAT_SQRTREM);
+}
+
+void bqint_sqrt(bqint *result, const bqint *a)
+{
+	bqint_sqrtrem(result, 0, a);
+}
+
+void bqint_root(bqint *result, const bqint *a, uint32_t k)
+{
+	bqint n = bqint_dynamic();
+	bqint_flags err = a->flags & BQINT_ERROR;
+	int neg = (a->flags & BQINT_NEGATIVE) && a->size > 0;
+	BQINT__STAT_TIMER
+
+	if (k == 0 || (neg && k % 2 == 0)) {
+		bqint__domain_error(result, 0, err);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_ROOT, a->size);
+	bqint__set_abs(&n, a);
+	bqint__root(result, &n, k);
+	result->flags |= err;
+	bqint__set_sign(result, neg);
+
+	bqint_free(&n);
+	BQINT__STAT_END(BQINT_STAT_ROOT);
+}
+
+// Quadratic residue bitmasks
+static const uint32_t bqint__squares_mod64[] = { 0x02030213U, 0x02020212U };
+static const uint32_t bqint__squares_mod63[] = { 0x12450293U, 0x04024830U };
+static const uint32_t bqint__squares_mod65[] = { 0x66014613U, 0x218A0198U, 0x00000001U };
+static const uint32_t bqint__squares_mod11[] = { 0x0000023BU };
+
+#define BQINT__IS_RESIDUE(table, r) ((table)[(r) / 32] >> ((r) % 32) & 1)
+
+int bqint_is_square(const bqint *a)
+{
+	const bqint_word *words = bqint_get_words(a);
+	bqint rem = bqint_dynamic();
+	unsigned r63, r65, r11;
+	int square;
+
+	if ((a->flags & BQINT_NEGATIVE) && a->size > 0)
+		return 0;
+	if (a->size == 0)
+		return 1;
+
+	if (!BQINT__IS_RESIDUE(bqint__squares_mod64, words[0] & 63))
+		return 0;
+
+#if BQINT_WORD_BITS >= 16
+	{
+		// One pass modulo 63 * 65 * 11 = 45045
+		unsigned r = bqint__mod_word(words, a->size, 45045);
+		r63 = r % 63;
+		r65 = r % 65;
+		r11 = r % 11;
+	}
+#else
+	r63 = bqint__mod_word(words, a->size, 63);
+	r65 = bqint__mod_word(words, a->size, 65);
+	r11 = bqint__mod_word(words, a->size, 11);
+#endif
+
+	if (!BQINT__IS_RESIDUE(bqint__squares_mod63, r63)
+			|| !BQINT__IS_RESIDUE(bqint__squares_mod65, r65)
+			|| !BQINT__IS_RESIDUE(bqint__squares_mod11, r11))
+		return 0;
+
+	bqint_sqrtrem(0, &rem, a);
+	square = rem.size == 0;
+	bqint_free(&rem);
+	return square;
+}
+
+void bqint_random_bits(bqint *a, size_t bits, bqint_random_fn rng, void *user)
+{
+	bqint_size size = bqint__clamp_size((bits + BQINT_WORD_BITS - 1) / BQINT_WORD_BITS);
+	bqint_size res_size = size;
+	bqint_word *words;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_RANDOM, size);
+	words = bqint__reserve(a, &res_size);
+	a->flags &= ~BQINT_NEGATIVE;
+	if (res_size < size) {
+		bqint__truncate(a, BQINT_MAX_WORDS);
+		BQINT__STAT_END(BQINT_STAT_RANDOM);
+		return;
+	}
+
+	if (size > 0) {
+		rng(user, words, size * sizeof(bqint_word));
+		if (bits % BQINT_WORD_BITS)
+			words[size - 1] &= (bqint_word)(((bqint_word)1 << (bits % BQINT_WORD_BITS)) - 1);
+	}
+	while (size > 0 && !words[size - 1])
+		size--;
+	bqint__truncate(a, size);
+	BQINT__STAT_END(BQINT_STAT_RANDOM);
+}
+
+void bqint_random_below(bqint *a, const bqint *bound, bqint_random_fn rng, void *user)
+{
+	bqint copy = bqint_dynamic();
+	bqint_size size = bound->size, res_size = size, i;
+	const bqint_word *b_words;
+	bqint_word *words, top, mask;
+	BQINT__STAT_TIMER
+
+	if (size == 0) {
+		bqint__domain_error(a, 0, bound->flags & BQINT_ERROR);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_RANDOM, size);
+	if (a == bound) {
+		bqint_set(&copy, bound);
+		bound = &copy;
+	}
+	b_words = bqint_get_words(bound);
+	top = b_words[size - 1];
+	mask = (bqint_word)((bqint_word)~(bqint_word)0 >> bqint__clz_word(top));
+
+	words = bqint__reserve(a, &res_size);
+	a->flags &= ~BQINT_NEGATIVE;
+	if (res_size < size) {
+		bqint__truncate(a, BQINT_MAX_WORDS);
+		bqint_free(&copy);
+		BQINT__STAT_END(BQINT_STAT_RANDOM);
+		return;
+	}
+
+	// Draw the top word until it's not above the top word of the bound (at
+	// least half of the tries succeed), only if it's equal to the top of the
+	// bound the lower words can still reject the whole value
+	for (;;) {
+		rng(user, &words[size - 1], sizeof(bqint_word));
+		words[size - 1] &= mask;
+		if (words[size - 1] > top)
+			continue;
+
+		if (size > 1)
+			rng(user, words, (size - 1) * sizeof(bqint_word));
+		if (words[size - 1] < top)
+			break;
+
+		for (i = size - 1; i-- > 0; ) {
+			if (words[i] != b_words[i])
+				break;
+		}
+		if (i < size && words[i] < b_words[i])
+			break;
+	}
+
+	while (size > 0 && !words[size - 1])
+		size--;
+	a->flags |= bound->flags & BQINT_ERROR;
+	bqint__truncate(a, size);
+	bqint_free(&copy);
+	BQINT__STAT_END(BQINT_STAT_RANDOM);
+}
+
+// a^e mod m for words
+static bqint_word bqint__powmod_word(bqint_word a, bqint_word e, bqint_word m)
+{
+	bqint_dword r = 1, x = a % m;
+
+	for (; e; e >>= 1) {
+		if (e & 1)
+			r = r * x % m;
+		x = x * x % m;
+	}
+	return (bqint_word)r;
+}
+
+// Primality test for a single word: Miller-Rabin with the bases 2, 7 and 61
+// is deterministic for all n < 4759123141, 64-bit words use the seven bases
+// found by Jim Sinclair that are deterministic for all n < 2^64
+static int bqint__is_prime_word(bqint_word n)
+{
+#if BQINT_WORD_BITS == 64
+	static const bqint_word bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+#else
+	static const bqint_word bases[] = { 2, 7, 61 };
+#endif
+	bqint_word n_1 = (bqint_word)(n - 1), d = n_1;
+	unsigned s = 0, i, j;
+
+	if (n < 4)
+		return n >= 2;
+	if (!(n & 1) || n % 3 == 0 || n % 5 == 0 || n % 7 == 0)
+		return n == 5 || n == 7;
+
+	while (!(d & 1)) {
+		d >>= 1;
+		s++;
+	}
+
+	for (i = 0; i < sizeof(bases) / sizeof(*bases); i++) {
+		bqint_dword x;
+		if (bases[i] % n == 0)
+			continue;
+		x = bqint__powmod_word(bases[i], d, n);
+		if (x == 1 || x == n_1)
+			continue;
+		for (j = 1; j < s && x != n_1; j++) {
+			x = x * x % n;
+		}
+		if (x != n_1)
+			return 0;
+	}
+	return 1;
+}
+
+// The next prime below `p`, zero if there is none (2 is skipped to keep the
+// modulus odd)
+static bqint_word bqint__prev_prime_word(bqint_word p)
+{
+	do {
+		p--;
+	} while (p > 2 && !bqint__is_prime_word(p));
+	return p > 2 ? p : 0;
+}
+
+// Montgomery arithmetic modulo an odd `n` > 1 with R = 2^(W size), the values
+// are arrays of `size` words in range [0, n) holding x R mod n
+typedef struct bqint__mont
+{
+	const bqint_word *n; // Modulus, must outlive the context
+	bqint_word *one;     // R mod n, ie. 1 in Montgomery form
+	bqint_word *r2;      // R^2 mod n for converting to Montgomery form
+	bqint_word *unit;    // Plain 1 for converting from Montgomery form
+	bqint_word *scratch; // size + 2 words for bqint__montmul_words()
+	bqint_word *temps;   // Values for the caller
+	bqint_size size;
+	bqint_word n_inv;    // -n^-1 mod 2^W
+	bqint storage;
+} bqint__mont;
+
+// Point the arrays of `m` to `words` which has room for (num_temps + 4) size
+// + 2 words, used also to reattach a context whose storage has been moved
+static void bqint__mont_layout(bqint__mont *m, const bqint *n, bqint_word *words, size_t num_temps)
+{
+	bqint_size k = n->size;
+
+	m->n = bqint_get_words(n);
+	m->size = k;
+	m->one = words;
+	m->r2 = words + k;
+	m->unit = words + 2 * k;
+	m->temps = words + 3 * k;
+	m->scratch = words + (num_temps + 3) * k;
+}
+
+// Set up a context with `num_temps` values for the caller, returns zero (with
+// the error in `m->storage.flags`) if the memory allocation fails. The
+// context must be freed with bqint__mont_free() in either case.
+static int bqint__mont_init(bqint__mont *m, const bqint *n, size_t num_temps)
+{
+	bqint p = bqint_dynamic(), r = bqint_dynamic();
+	bqint_size k = n->size, size;
+	size_t total = (num_temps + 4) * (size_t)k + 2;
+	bqint_word *words;
+	int ok;
+
+	m->storage = bqint_dynamic();
+	size = bqint__clamp_size(total);
+	words = bqint__reserve(&m->storage, &size);
+	if (size < total) {
+		// The capacity may already be clamped to BQINT_MAX_WORDS in which
+		// case bqint__truncate() wouldn't flag it
+		m->storage.flags |= BQINT_TRUNCATED;
+		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
+		return 0;
+	}
+	memset(words, 0, total * sizeof(bqint_word));
+	bqint__mont_layout(m, n, words, num_temps);
+	m->unit[0] = 1;
+	m->n_inv = (bqint_word)(0 - bqint__inverse_word(m->n[0]));
+
+	bqint_set_u32(&p, 1);
+	bqint__shl(&r, &p, (size_t)k * BQINT_WORD_BITS);
+	bqint__divmod(0, &p, &r, n);
+	memcpy(m->one, bqint_get_words(&p), p.size * sizeof(bqint_word));
+	bqint_set_u32(&p, 1);
+	bqint__shl(&r, &p, (size_t)k * 2 * BQINT_WORD_BITS);
+	bqint__divmod(0, &p, &r, n);
+	memcpy(m->r2, bqint_get_words(&p), p.size * sizeof(bqint_word));
+
+	m->storage.flags |= (p.flags | r.flags) & BQINT_ERROR;
+	ok = !(m->storage.flags & BQINT_ERROR);
+	bqint_free(&p);
+	bqint_free(&r);
+	return ok;
+}
+
+static void bqint__mont_free(bqint__mont *m)
+{
+	bqint_free(&m->storage);
+}
+
+// r = a b
+static void bqint__mont_mul(const bqint__mont *m, bqint_word *r,
+		const bqint_word *a, const bqint_word *b)
+{
+	bqint__montmul_words(r, a, b, m->n, m->size, m->n_inv, m->scratch);
+}
+
+// r = a + b
+static void bqint__mont_add(const bqint__mont *m, bqint_word *r,
+		const bqint_word *a, const bqint_word *b)
+{
+	if (bqint__add_n_words(r, a, b, m->size) || bqint__cmp_n_words(r, m->n, m->size) >= 0)
+		bqint__sub_n_words(r, r, m->n, m->size);
+}
+
+// r = a - b
+static void bqint__mont_sub(const bqint__mont *m, bqint_word *r,
+		const bqint_word *a, const bqint_word *b)
+{
+	if (bqint__sub_n_words(r, a, b, m->size))
+		bqint__add_n_words(r, r, m->n, m->size);
+}
+
+// r = a / 2, odd values are made even by adding n
+static void bqint__mont_half(const bqint__mont *m, bqint_word *r, const bqint_word *a)
+{
+	bqint_word carry = 0;
+	bqint_size i;
+
+	if (a[0] & 1) {
+		carry = bqint__add_n_words(r, a, m->n, m->size);
+	} else if (r != a) {
+		memcpy(r, a, m->size * sizeof(bqint_word));
+	}
+	for (i = 0; i < m->size; i++) {
+		bqint_word hi = i + 1 < m->size ? r[i + 1] : carry;
+		r[i] = (bqint_word)(r[i] >> 1 | hi << (BQINT_WORD_BITS - 1));
+	}
+}
+
+static int bqint__mont_is_zero(const bqint__mont *m, const bqint_word *a)
+{
+	bqint_size i;
+
+	for (i = 0; i < m->size; i++) {
+		if (a[i])
+			return 0;
+	}
+	return 1;
+}
+
+static int bqint__mont_equal(const bqint__mont *m, const bqint_word *a, const bqint_word *b)
+{
+	return bqint__cmp_n_words(a, b, m->size) == 0;
+}
+
+// r = a in Montgomery form, 0 <= a < n
+static void bqint__mont_set(const bqint__mont *m, bqint_word *r, const bqint *a)
+{
+	memset(r, 0, m->size * sizeof(bqint_word));
+	memcpy(r, bqint_get_words(a), a->size * sizeof(bqint_word));
+	bqint__mont_mul(m, r, r, m->r2);
+}
+
+// r = v in Montgomery form for a small `v` with |v| < n
+static void bqint__mont_set_small(const bqint__mont *m, bqint_word *r, int32_t v)
+{
+	uint64_t mag = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+	bqint_size i;
+
+	for (i = 0; i < m->size; i++) {
+		r[i] = (bqint_word)mag;
+		mag = mag >> (BQINT_WORD_BITS - 1) >> 1;
+	}
+	bqint__mont_mul(m, r, r, m->r2);
+	if (v < 0 && !bqint__mont_is_zero(m, r))
+		bqint__sub_n_words(r, m->n, r, m->size);
+}
+
+// Convert `a` from Montgomery form to `result`
+static void bqint__mont_get(const bqint__mont *m, bqint *result, const bqint_word *a)
+{
+	bqint_size size = m->size;
+	bqint_word *words = bqint__reserve(result, &size);
+
+	result->flags &= ~BQINT_NEGATIVE;
+	if (size < m->size) {
+		bqint__truncate(result, BQINT_MAX_WORDS);
+		return;
+	}
+	bqint__mont_mul(m, words, a, m->unit);
+	while (size > 0 && !words[size - 1])
+		size--;
+	bqint__truncate(result, size);
+}
+
+// Sliding window size for an exponent of `bits` bits
+static unsigned bqint__pow_window(size_t bits)
+{
+	if (bits > 768)
+		return 6;
+	if (bits > 256)
+		return 5;
+	if (bits > 80)
+		return 4;
+	if (bits > 24)
+		return 3;
+	return bits > 6 ? 2 : 1;
+}
+
+// r = x^e for a non-negative `e` with a sliding window of odd powers, `r`
+// must not be `x`. Returns the error flags of the table allocation.
+static bqint_flags bqint__mont_pow(const bqint__mont *m, bqint_word *r,
+		const bqint_word *x, const bqint *e)
+{
+	bqint table = bqint_dynamic();
+	bqint_size k = m->size, size;
+	size_t bits = bqint_bit_length(e), i, low, j, num_table;
+	unsigned window = bqint__pow_window(bits), value;
+	bqint_word *t;
+	bqint_flags err;
+
+	// x^2 followed by the odd powers x, x^3, ..., x^(2^window - 1)
+	num_table = (size_t)1 << (window - 1);
+	size = bqint__clamp_size((num_table + 1) * k);
+	t = bqint__reserve(&table, &size);
+	if (size < (num_table + 1) * k) {
+		table.flags |= BQINT_TRUNCATED;
+		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
+		memcpy(r, m->one, k * sizeof(bqint_word));
+		err = table.flags & BQINT_ERROR;
+		bqint_free(&table);
+		return err;
+	}
+	memcpy(t + k, x, k * sizeof(bqint_word));
+	bqint__mont_mul(m, t, x, x);
+	for (j = 1; j < num_table; j++)
+		bqint__mont_mul(m, t + (j + 1) * k, t + j * k, t);
+
+	memcpy(r, m->one, k * sizeof(bqint_word));
+	for (i = bits; i > 0; ) {
+		if (!bqint_test_bit(e, i - 1)) {
+			bqint__mont_mul(m, r, r, r);
+			i--;
+			continue;
+		}
+
+		// Longest window ending with a set bit
+		low = i > window ? i - window : 0;
+		while (!bqint_test_bit(e, low))
+			low++;
+		value = 0;
+		for (j = i; j-- > low; )
+			value = value << 1 | (unsigned)bqint_test_bit(e, j);
+
+		if (i == bits) {
+			memcpy(r, t + (value / 2 + 1) * k, k * sizeof(bqint_word));
+		} else {
+			for (j = low; j < i; j++)
+				bqint__mont_mul(m, r, r, r);
+			bqint__mont_mul(m, r, r, t + (value / 2 + 1) * k);
+		}
+		i = low;
+	}
+
+	err = table.flags & BQINT_ERROR;
+	bqint_free(&table);
+	return err;
+}
+
+// b = base reduced to [0, n), inverted for negative exponents, `t` is a
+// temporary. Returns zero if the base is not invertible.
+static int bqint__powmod_base(bqint *b, bqint *t, const bqint *base, const bqint *exp, const bqint *n)
+{
+	bqint__divmod(0, b, base, n);
+	if ((b->flags & BQINT_NEGATIVE) && b->size > 0) {
+		b->flags &= ~BQINT_NEGATIVE;
+		bqint_sub(t, n, b);
+		bqint__swap(b, t);
+	}
+	if ((exp->flags & BQINT_NEGATIVE) && exp->size > 0) {
+		if (!bqint_invmod(t, b, n))
+			return 0;
+		bqint__swap(b, t);
+	}
+	return 1;
+}
+
+void bqint_powmod(bqint *result, const bqint *base, const bqint *exp, const bqint *mod)
+{
+	bqint n = bqint_dynamic(), b = bqint_dynamic(), x = bqint_dynamic(), t = bqint_dynamic();
+	bqint e = bqint_view(bqint_get_words(exp), exp->size);
+	bqint_flags err = (base->flags | exp->flags | mod->flags) & BQINT_ERROR;
+	size_t i;
+	BQINT__STAT_TIMER
+
+	if (mod->size == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(result, err | BQINT_DIV_BY_ZERO);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_POWMOD, mod->size);
+
+	bqint__set_abs(&n, mod);
+	if (!bqint__powmod_base(&b, &t, base, exp, &n)) {
+		bqint__domain_error(result, 0, err);
+		bqint_free(&n);
+		bqint_free(&b);
+		bqint_free(&t);
+		BQINT__STAT_END(BQINT_STAT_POWMOD);
+		return;
+	}
+
+	if (n.size == 1 && bqint_get_words(&n)[0] == 1) {
+		bqint_set_zero(&x);
+	} else if (bqint_get_words(&n)[0] & 1) {
+		bqint__mont m;
+
+		if (bqint__mont_init(&m, &n, 2)) {
+			bqint__mont_set(&m, m.temps, &b);
+			err |= bqint__mont_pow(&m, m.temps + m.size, m.temps, &e);
+			bqint__mont_get(&m, &x, m.temps + m.size);
+		}
+		err |= m.storage.flags & BQINT_ERROR;
+		bqint__mont_free(&m);
+	} else {
+		// Even modulus: Left-to-right binary powering with division
+		bqint_set_u32(&x, 1);
+		for (i = bqint_bit_length(&e); i-- > 0; ) {
+			bqint_mul(&t, &x, &x);
+			bqint__divmod(0, &x, &t, &n);
+			if (bqint_test_bit(&e, i)) {
+				bqint_mul(&t, &x, &b);
+				bqint__divmod(0, &x, &t, &n);
+			}
+		}
+	}
+
+	bqint_set(result, &x);
+	result->flags |= err | ((n.flags | b.flags | x.flags | t.flags) & BQINT_ERROR);
+
+	bqint_free(&n);
+	bqint_free(&b);
+	bqint_free(&x);
+	bqint_free(&t);
+	BQINT__STAT_END(BQINT_STAT_POWMOD);
+}
+
+// Largest digit size of Pippenger's buckets in bqint_multi_powmod()
+#define BQINT__MULTI_MAX_DIGIT_BITS 16
+
+// r = x[0]^e[0] x[1]^e[1] ... x[count - 1]^e[count - 1] by Straus interleaving,
+// `tables` has 2^(window - 1) values per base starting with the base which are
+// filled with the odd powers x, x^3, ..., x^(2^window - 1). The sliding windows
+// of all the exponents share one chain of squarings, `state` has room for
+// 2 count values tracking the pending window of each exponent.
+static void bqint__multi_straus(const bqint__mont *m, bqint_word *r, bqint_word *sq,
+		bqint_word *tables, const bqint *exps, size_t count, size_t bits,
+		unsigned window, size_t *state)
+{
+	bqint_size k = m->size;
+	size_t num_table = (size_t)1 << (window - 1), i, j, b, low, value;
+	int r_one = 1;
+
+	for (i = 0; i < count; i++) {
+		bqint_word *t = tables + i * num_table * k;
+
+		if (num_table > 1)
+			bqint__mont_mul(m, sq, t, t);
+		for (j = 1; j < num_table; j++)
+			bqint__mont_mul(m, t + j * k, t + (j - 1) * k, sq);
+		state[2 * i + 1] = 0;
+	}
+
+	for (i = bits; i-- > 0; ) {
+		if (!r_one)
+			bqint__mont_mul(m, r, r, r);
+
+		for (j = 0; j < count; j++) {
+			const bqint *e = &exps[j];
+
+			// Longest window from bit `i` down that ends with a set bit, it's
+			// multiplied in when the squarings reach its lowest bit
+			if (!state[2 * j + 1]) {
+				if (!bqint_test_bit(e, i))
+					continue;
+				low = i + 1 > window ? i + 1 - window : 0;
+				while (!bqint_test_bit(e, low))
+					low++;
+				value = 0;
+				for (b = i + 1; b-- > low; )
+					value = value << 1 | (size_t)bqint_test_bit(e, b);
+				state[2 * j] = low;
+				state[2 * j + 1] = value;
+			}
+			if (state[2 * j] != i)
+				continue;
+
+			value = state[2 * j + 1];
+			state[2 * j + 1] = 0;
+			if (r_one) {
+				memcpy(r, tables + (j * num_table + value / 2) * k, k * sizeof(bqint_word));
+				r_one = 0;
+			} else {
+				bqint__mont_mul(m, r, r, tables + (j * num_table + value / 2) * k);
+			}
+		}
+	}
+
+	if (r_one)
+		memcpy(r, m->one, k * sizeof(bqint_word));
+}
+
+// r = x[0]^e[0] x[1]^e[1] ... x[count - 1]^e[count - 1] by Pippenger's bucket
+// method: For each `digit_bits` bit digit of the exponents from the top the
+// bases are multiplied into the bucket of their digit and the buckets combined
+// as B[1] B[2]^2 ... B[max]^max with two running products. `buckets` has room
+// for 2^digit_bits + 1 values and `used` for 2^digit_bits - 1 flags.
+static void bqint__multi_pippenger(const bqint__mont *m, bqint_word *r,
+		const bqint_word *bases, bqint_word *buckets, const bqint *exps,
+		size_t count, size_t bits, unsigned digit_bits, size_t *used)
+{
+	bqint_size k = m->size;
+	size_t num_buckets = ((size_t)1 << digit_bits) - 1, pos, i, j, d;
+	bqint_word *s = buckets + num_buckets * k, *t = s + k;
+	int r_one = 1, s_one, t_one;
+
+	pos = (bits + digit_bits - 1) / digit_bits * digit_bits;
+	while (pos > 0) {
+		pos -= digit_bits;
+		if (!r_one) {
+			for (j = 0; j < digit_bits; j++)
+				bqint__mont_mul(m, r, r, r);
+		}
+
+		memset(used, 0, num_buckets * sizeof(size_t));
+		for (i = 0; i < count; i++) {
+			d = 0;
+			for (j = digit_bits; j-- > 0; )
+				d = d << 1 | (size_t)bqint_test_bit(&exps[i], pos + j);
+			if (!d)
+				continue;
+
+			if (used[d - 1]) {
+				bqint__mont_mul(m, buckets + (d - 1) * k, buckets + (d - 1) * k, bases + i * k);
+			} else {
+				memcpy(buckets + (d - 1) * k, bases + i * k, k * sizeof(bqint_word));
+				used[d - 1] = 1;
+			}
+		}
+
+		// s = B[d] B[d + 1] ... B[max], t = s_max s_(max - 1) ... s_1
+		s_one = t_one = 1;
+		for (d = num_buckets; d-- > 0; ) {
+			if (used[d]) {
+				if (s_one)
+					memcpy(s, buckets + d * k, k * sizeof(bqint_word));
+				else
+					bqint__mont_mul(m, s, s, buckets + d * k);
+				s_one = 0;
+			}
+			if (!s_one) {
+				if (t_one)
+					memcpy(t, s, k * sizeof(bqint_word));
+				else
+					bqint__mont_mul(m, t, t, s);
+				t_one = 0;
+			}
+		}
+
+		if (!t_one) {
+			if (r_one)
+				memcpy(r, t, k * sizeof(bqint_word));
+			else
+				bqint__mont_mul(m, r, r, t);
+			r_one = 0;
+		}
+	}
+
+	if (r_one)
+		memcpy(r, m->one, k * sizeof(bqint_word));
+}
+
+void bqint_multi_powmod(bqint *result, const bqint *bases, const bqint *exps, size_t count, const bqint *mod)
+{
+	bqint n = bqint_dynamic(), b = bqint_dynamic(), x = bqint_dynamic(), t = bqint_dynamic();
+	bqint_flags err = mod->flags & BQINT_ERROR;
+	size_t i, bits = 0, num_values, num_state, straus, pippenger, cost;
+	unsigned window, digit_bits = 1, c;
+	int mod_one;
+	BQINT__STAT_TIMER
+
+	for (i = 0; i < count; i++) {
+		size_t e_bits = bqint_bit_length(&exps[i]);
+		err |= (bases[i].flags | exps[i].flags) & BQINT_ERROR;
+		if (e_bits > bits)
+			bits = e_bits;
+	}
+
+	if (mod->size == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(result, err | BQINT_DIV_BY_ZERO);
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_MULTI_POWMOD, mod->size);
+	bqint__set_abs(&n, mod);
+	mod_one = n.size == 1 && bqint_get_words(&n)[0] == 1;
+
+	if (!(bqint_get_words(&n)[0] & 1) || mod_one) {
+		// Even modulus or one: Product of the separate powers
+		bqint_set_u32(&x, mod_one ? 0 : 1);
+		for (i = 0; i < count; i++) {
+			bqint_powmod(&b, &bases[i], &exps[i], &n);
+			if (b.flags & BQINT_DOMAIN_ERROR)
+				break;
+			bqint_mul(&t, &x, &b);
+			bqint__divmod(0, &x, &t, &n);
+		}
+	} else {
+		bqint__mont m;
+		bqint_size k = n.size;
+		bqint_word *xs = 0;
+		size_t *state = 0, stride, extra, bytes = 0;
+
+		// Multiplications apart from the shared squarings: Straus builds a
+		// table for each base and multiplies once per window. Pippenger
+		// multiplies each base into a bucket once per digit and the running
+		// products take one more per bucket, the first value of each bucket
+		// is copied which pays for the multiplication into `s`.
+		window = bqint__pow_window(bits);
+		straus = count * (((size_t)1 << (window - 1)) + bits / (window + 1));
+		pippenger = (size_t)-1;
+		for (c = 1; c <= BQINT__MULTI_MAX_DIGIT_BITS && c <= bits; c++) {
+			cost = (bits + c - 1) / c * (count + ((size_t)1 << c));
+			if (cost < pippenger) {
+				pippenger = cost;
+				digit_bits = c;
+			}
+		}
+
+		// The bases followed by their tables or by the buckets and the two
+		// running products, allocated separately from the Montgomery context
+		// as they can exceed BQINT_MAX_WORDS words
+		if (straus <= pippenger) {
+			stride = (size_t)1 << (window - 1);
+			extra = 0;
+			num_state = 2 * count;
+		} else {
+			stride = 1;
+			extra = ((size_t)1 << digit_bits) + 1;
+			num_state = ((size_t)1 << digit_bits) - 1;
+		}
+		num_values = count * stride + extra;
+
+		if (count <= ((size_t)-1 - extra) / stride
+				&& num_values <= (size_t)-1 / sizeof(bqint_word) / k
+				&& count <= (size_t)-1 / 2 / sizeof(size_t)) {
+			bytes = num_values * k * sizeof(bqint_word);
+			xs = num_values > 0 ? (bqint_word*)bqint_alloc_memory(bytes) : 0;
+			state = num_state > 0 ? (size_t*)bqint_alloc_memory(num_state * sizeof(size_t)) : 0;
+			if (xs)
+				BQINT__STAT_ALLOC(bytes);
+			if (state)
+				BQINT__STAT_ALLOC(num_state * sizeof(size_t));
+		}
+		if ((num_values > 0 && !xs) || (num_state > 0 && !state)) {
+			BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+			BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+			err |= BQINT_OUT_OF_MEMORY;
+		} else {
+			// r and x^2 or unused
+			if (bqint__mont_init(&m, &n, 2)) {
+				bqint_word *r = m.temps;
+
+				for (i = 0; i < count; i++) {
+					if (!bqint__powmod_base(&b, &t, &bases[i], &exps[i], &n)) {
+						b.flags |= BQINT_DOMAIN_ERROR;
+						break;
+					}
+					bqint__mont_set(&m, xs + i * stride * k, &b);
+				}
+
+				if (i == count) {
+					if (straus <= pippenger) {
+						bqint__multi_straus(&m, r, m.temps + k, xs, exps, count, bits,
+								window, state);
+					} else {
+						bqint__multi_pippenger(&m, r, xs, xs + count * k, exps, count,
+								bits, digit_bits, state);
+					}
+					bqint__mont_get(&m, &x, r);
+				}
+			}
+			err |= m.storage.flags & BQINT_ERROR;
+			bqint__mont_free(&m);
+		}
+
+		if (xs) {
+			BQINT__STAT_FREE(bytes);
+			bqint_free_memory(xs);
+		}
+		if (state) {
+			BQINT__STAT_FREE(num_state * sizeof(size_t));
+			bqint_free_memory(state);
+		}
+	}
+
+	if (b.flags & BQINT_DOMAIN_ERROR) {
+		bqint__domain_error(result, 0, err);
+	} else {
+		bqint_set(result, &x);
+		result->flags |= err | ((n.flags | b.flags | x.flags | t.flags) & BQINT_ERROR);
+	}
+
+	bqint_free(&n);
+	bqint_free(&b);
+	bqint_free(&x);
+	bqint_free(&t);
+	BQINT__STAT_END(BQINT_STAT_MULTI_POWMOD);
+}
+
+// Odd primes below 1024 for trial division and sieving
+static const uint16_t bqint__small_primes[] = {
+	3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71,
+	73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151,
+	157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223, 227, 229, 233,
+	239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311, 313, 317,
+	331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409, 419,
+	421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503,
+	509, 521, 523, 541, 547, 557, 563, 569, 571, 577, 587, 593, 599, 601, 607,
+	613, 617, 619, 631, 641, 643, 647, 653, 659, 661, 673, 677, 683, 691, 701,
+	709, 719, 727, 733, 739, 743, 751, 757, 761, 769, 773, 787, 797, 809, 811,
+	821, 823, 827, 829, 839, 853, 857, 859, 863, 877, 881, 883, 887, 907, 911,
+	919, 929, 937, 941, 947, 953, 967, 971, 977, 983, 991, 997, 1009, 1013,
+	1019, 1021
+};
+
+#define BQINT__NUM_SMALL_PRIMES (sizeof(bqint__small_primes) / sizeof(*bqint__small_primes))
+
+// Residues of the magnitude of `a` modulo the small primes that fit in a
+// word, returns their count. The primes are multiplied to groups that fit in a
+// word so that `a` is reduced only once per group.
+static size_t bqint__small_prime_residues(const bqint *a, bqint_word *residues)
+{
+	const bqint_word *words = bqint_get_words(a);
+	bqint_word max = (bqint_word)~(bqint_word)0, rem;
+	size_t i = 0, begin;
+
+	while (i < BQINT__NUM_SMALL_PRIMES && bqint__small_primes[i] <= max) {
+		bqint_dword group = bqint__small_primes[i];
+
+		begin = i++;
+		while (i < BQINT__NUM_SMALL_PRIMES && bqint__small_primes[i] <= max
+				&& group * bqint__small_primes[i] <= max) {
+			group *= bqint__small_primes[i++];
+		}
+		rem = bqint__mod_word(words, a->size, (bqint_word)group);
+		for (; begin < i; begin++)
+			residues[begin] = (bqint_word)(rem % bqint__small_primes[begin]);
+	}
+	return i;
+}
+
+// Returns 1 if `a` (positive) is prime, 0 if it's composite and -1 if trial
+// division can't decide. Values below (p + 2)^2, where `p` is the largest
+// prime tested, are always decided.
+static int bqint__trial_division(const bqint *a)
+{
+	bqint_word residues[BQINT__NUM_SMALL_PRIMES];
+	const bqint_word *words = bqint_get_words(a);
+	size_t bits = bqint_bit_length(a), num, i;
+	uint64_t value = 0, limit;
+
+	if (bits <= 40) {
+		for (i = a->size; i-- > 0; )
+			value = value << (BQINT_WORD_BITS - 1) << 1 | words[i];
+		if (value < 4)
+			return value >= 2;
+	}
+	if (!(words[0] & 1))
+		return 0;
+
+	num = bqint__small_prime_residues(a, residues);
+	for (i = 0; i < num; i++) {
+		if (residues[i] == 0)
+			return bits <= 40 && value == bqint__small_primes[i];
+	}
+
+	limit = (uint64_t)bqint__small_primes[num - 1] + 2;
+	return bits <= 40 && value < limit * limit ? 1 : -1;
+}
+
+// Jacobi symbol (d / n) for an odd n > |d| and a small odd `d`
+static int bqint__jacobi_small(int32_t d, const bqint *n)
+{
+	const bqint_word *words = bqint_get_words(n);
+	uint32_t a = d < 0 ? 0 - (uint32_t)d : (uint32_t)d, b = 0, t;
+	int result = 1;
+
+	// (-1 / n) = -1 if n = 3 (mod 4)
+	if (d < 0 && (words[0] & 3) == 3)
+		result = -result;
+
+	// Quadratic reciprocity: (a / n) = (n / a), negated if both are 3 (mod 4)
+	if ((a & 3) == 3 && (words[0] & 3) == 3)
+		result = -result;
+#if BQINT_WORD_BITS >= 32
+	b = (uint32_t)bqint__mod_word(words, n->size, a);
+#else
+	{
+		bqint_size i;
+		for (i = n->size; i-- > 0; )
+			b = (uint32_t)(((uint64_t)b << BQINT_WORD_BITS | words[i]) % a);
+	}
+#endif
+
+	// (b / a) with word arithmetic
+	while (b != 0) {
+		while (!(b & 1)) {
+			b >>= 1;
+			if ((a & 7) == 3 || (a & 7) == 5)
+				result = -result;
+		}
+		t = a;
+		a = b;
+		b = t;
+		if ((a & 3) == 3 && (b & 3) == 3)
+			result = -result;
+		b %= a;
+	}
+	return a == 1 ? result : 0;
+}
+
+// Baillie-PSW: Strong probable prime test to base 2 followed by a strong
+// Lucas probable prime test with Selfridge's parameters. `n` must be odd and
+// have no small factors. Allocation failures are added to `err`.
+static int bqint__bpsw(const bqint *n, bqint_flags *err)
+{
+	bqint d = bqint_dynamic(), t = bqint_dynamic();
+	bqint__mont m;
+	bqint_word *x, *y, *minus_one, *u, *v, *qk, *dm, *qm;
+	size_t s, r, i;
+	int32_t disc = 5, q;
+	int prime = 0, tries = 0, jacobi;
+
+	if (!bqint__mont_init(&m, n, 8)) {
+		*err |= m.storage.flags & BQINT_ERROR;
+		bqint__mont_free(&m);
+		return 0;
+	}
+	x = m.temps;
+	y = x + m.size;
+	minus_one = y + m.size;
+	u = minus_one + m.size;
+	v = u + m.size;
+	qk = v + m.size;
+	dm = qk + m.size;
+	qm = dm + m.size;
+
+	// n - 1 = d 2^s, test that 2^d = 1 or 2^(d 2^r) = -1 for some r < s
+	bqint__sub_n_words(minus_one, m.n, m.one, m.size);
+	bqint_set(&t, n);
+	bqint_clear_bit(&t, 0);
+	s = bqint_ctz(&t);
+	bqint__shr(&d, &t, s);
+	bqint__mont_add(&m, x, m.one, m.one);
+	*err |= bqint__mont_pow(&m, y, x, &d);
+	if (bqint__mont_equal(&m, y, m.one) || bqint__mont_equal(&m, y, minus_one)) {
+		prime = 1;
+	} else {
+		for (r = 1; r < s && !prime; r++) {
+			bqint__mont_mul(&m, y, y, y);
+			if (bqint__mont_equal(&m, y, m.one))
+				break;
+			prime = bqint__mont_equal(&m, y, minus_one);
+		}
+	}
+
+	// First D in 5, -7, 9, -11, ... with (D / n) = -1, perfect squares have
+	// none so they are checked after a few tries
+	while (prime) {
+		jacobi = bqint__jacobi_small(disc, n);
+		if (jacobi == -1)
+			break;
+		if (jacobi == 0 || (++tries == 5 && bqint_is_square(n))) {
+			prime = 0;
+			break;
+		}
+		disc = disc > 0 ? -(disc + 2) : -disc + 2;
+	}
+
+	if (prime) {
+		// n + 1 = d 2^s, test that U_d = 0 or V_(d 2^r) = 0 for some r < s
+		// with P = 1, Q = (1 - D) / 4
+		q = (1 - disc) / 4;
+		bqint_set_u32(&d, 1);
+		bqint_add(&t, n, &d);
+		s = bqint_ctz(&t);
+		bqint__shr(&d, &t, s);
+
+		bqint__mont_set_small(&m, dm, disc);
+		bqint__mont_set_small(&m, qm, q);
+		memcpy(u, m.one, m.size * sizeof(bqint_word));
+		memcpy(v, m.one, m.size * sizeof(bqint_word));
+		memcpy(qk, qm, m.size * sizeof(bqint_word));
+
+		for (i = bqint_bit_length(&d) - 1; i-- > 0; ) {
+			// U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k
+			bqint__mont_mul(&m, u, u, v);
+			bqint__mont_mul(&m, v, v, v);
+			bqint__mont_sub(&m, v, v, qk);
+			bqint__mont_sub(&m, v, v, qk);
+			bqint__mont_mul(&m, qk, qk, qk);
+
+			if (bqint_test_bit(&d, i)) {
+				// U_k+1 = (P U_k + V_k) / 2, V_k+1 = (D U_k + P V_k) / 2
+				bqint__mont_mul(&m, x, dm, u);
+				bqint__mont_add(&m, u, u, v);
+				bqint__mont_half(&m, u, u);
+				bqint__mont_add(&m, v, v, x);
+				bqint__mont_half(&m, v, v);
+				bqint__mont_mul(&m, qk, qk, qm);
+			}
+		}
+
+		prime = bqint__mont_is_zero(&m, u) || bqint__mont_is_zero(&m, v);
+		for (r = 1; r < s && !prime; r++) {
+			bqint__mont_mul(&m, v, v, v);
+			bqint__mont_sub(&m, v, v, qk);
+			bqint__mont_sub(&m, v, v, qk);
+			bqint__mont_mul(&m, qk, qk, qk);
+			prime = bqint__mont_is_zero(&m, v);
+		}
+	}
+
+	*err |= (d.flags | t.flags) & BQINT_ERROR;
+	bqint_free(&d);
+	bqint_free(&t);
+	bqint__mont_free(&m);
+	return prime && !*err;
+}
+
+int bqint_is_probable_prime(const bqint *a)
+{
+	bqint_flags err = 0;
+	int prime;
+	BQINT__STAT_TIMER
+
+	if ((a->flags & BQINT_NEGATIVE) || a->size == 0)
+		return 0;
+
+	BQINT__STAT_BEGIN(BQINT_STAT_PRIME, a->size);
+	prime = bqint__trial_division(a);
+	if (prime < 0)
+		prime = bqint__bpsw(a, &err);
+	BQINT__STAT_END(BQINT_STAT_PRIME);
+	return err ? -1 : prime;
+}
+
+void bqint_next_prime(bqint *result, const bqint *a)
+{
+	bqint c = bqint_dynamic(), x = bqint_dynamic(), t = bqint_dynamic();
+	bqint_word residues[BQINT__NUM_SMALL_PRIMES];
+	bqint_flags err = a->flags & BQINT_ERROR, fail = 0;
+	unsigned char *sieve;
+	size_t window, num, i, j;
+	int prime;
+	BQINT__STAT_TIMER
+
+	if ((a->flags & BQINT_NEGATIVE) || bqint_bit_length(a) < 2) {
+		bqint_set_u32(result, 2);
+		result->flags |= err;
+		return;
+	}
+
+	BQINT__STAT_BEGIN(BQINT_STAT_NEXT_PRIME, a->size);
+
+	// First odd candidate above `a`
+	bqint_set_u32(&t, (bqint_get_words(a)[0] & 1) + 1);
+	bqint_add(&c, a, &t);
+	bqint_set_u32(&t, 2);
+	c.flags &= ~BQINT_ERROR;
+
+	// Small values are decided by trial division (and at most a few tests)
+	if (bqint_bit_length(&c) <= 32) {
+		while ((prime = bqint_is_probable_prime(&c)) == 0) {
+			bqint_add(&x, &c, &t);
+			bqint__swap(&c, &x);
+		}
+		if (prime < 0) {
+			BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+			BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+			bqint__set_error(result, err | BQINT_OUT_OF_MEMORY);
+		} else {
+			bqint_set(result, &c);
+			result->flags |= err | ((c.flags | x.flags | t.flags) & BQINT_ERROR);
+		}
+		bqint_free(&c);
+		bqint_free(&x);
+		bqint_free(&t);
+		BQINT__STAT_END(BQINT_STAT_NEXT_PRIME);
+		return;
+	}
+
+	// Sieve a window of odd candidates c + 2 j against the small primes, the
+	// average gap between the primes is about 0.7 bits
+	window = bqint_bit_length(&c) * 8;
+	if (window > 65536)
+		window = 65536;
+	sieve = (unsigned char*)bqint_alloc_memory(window);
+	if (!sieve) {
+		BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+		BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+		fail = BQINT_OUT_OF_MEMORY;
+	} else {
+		BQINT__STAT_ALLOC(window);
+	}
+
+	while (!fail) {
+		num = bqint__small_prime_residues(&c, residues);
+		memset(sieve, 0, window);
+		for (i = 0; i < num; i++) {
+			size_t p = bqint__small_primes[i];
+
+			// c + 2 j = 0 (mod p) for j = -c / 2 = (p - c) (p + 1) / 2
+			for (j = (p - residues[i]) % p * ((p + 1) / 2) % p; j < window; j += p)
+				sieve[j] = 1;
+		}
+
+		for (j = 0; j < window && !fail; j++) {
+			if (sieve[j])
+				continue;
+			bqint_set_u32(&t, (uint32_t)(2 * j));
+			bqint_add(&x, &c, &t);
+			fail |= x.flags & BQINT_ERROR;
+			if (bqint__bpsw(&x, &fail))
+				break;
+		}
+		if (j < window)
+			break;
+
+		bqint_set_u32(&t, (uint32_t)(2 * window));
+		bqint_add(&x, &c, &t);
+		bqint__swap(&c, &x);
+		fail |= c.flags & BQINT_ERROR;
+	}
+
+	if (fail) {
+		bqint__set_error(result, err | fail);
+	} else {
+		bqint_set(result, &x);
+		result->flags |= err;
+	}
+
+	if (sieve) {
+		BQINT__STAT_FREE(window);
+		bqint_free_memory(sieve);
+	}
+	bqint_free(&c);
+	bqint_free(&x);
+	bqint_free(&t);
+	BQINT__STAT_END(BQINT_STAT_NEXT_PRIME);
+}
+
+int bqint_rns_init(bqint_rns *rns, size_t bits)
+{
+	size_t i, j, count = 0;
+	bqint_word p = 0;
+	bqint tmp = bqint_dynamic();
+	bqint_flags err;
+
+	rns->primes = 0;
+	rns->inverses = 0;
+	rns->count = 0;
+	rns->modulus = bqint_dynamic();
+	rns->half = bqint_dynamic();
+
+	// The product of all primes below 2^BQINT_WORD_BITS has less than
+	// 1.5 * 2^BQINT_WORD_BITS bits, fail early instead of searching them all
+	if ((bqint_dword)(bits / 3) >= ((bqint_dword)1 << BQINT_WORD_BITS) / 2)
+		return 0;
+	if (bits / BQINT_WORD_BITS >= BQINT_MAX_WORDS)
+		return 0;
+
+	// Largest primes first until the modulus exceeds 2^(bits + 1) so that
+	// the symmetric range covers |value| < 2^bits
+	bqint_set_u32(&rns->modulus, 1);
+	while (bqint_bit_length(&rns->modulus) <= bits + 1) {
+		p = bqint__prev_prime_word(p);
+		if (!p)
+			break;
+		bqint__lincomb(&tmp, &rns->modulus, p, &rns->modulus, 0, 0);
+		bqint__swap(&tmp, &rns->modulus);
+		count++;
+	}
+	bqint__shr(&rns->half, &rns->modulus, 1);
+	err = (rns->modulus.flags | rns->half.flags | tmp.flags) & BQINT_ERROR;
+	bqint_free(&tmp);
+
+	if (p) {
+		rns->primes = (bqint_word*)bqint_alloc_memory(2 * count * sizeof(bqint_word));
+	}
+	if (!rns->primes || err) {
+		if (rns->primes) {
+			bqint_free_memory(rns->primes);
+			rns->primes = 0;
+		}
+		bqint_rns_free(rns);
+		return 0;
+	}
+	BQINT__STAT_ALLOC(2 * count * sizeof(bqint_word));
+	rns->inverses = rns->primes + count;
+	rns->count = count;
+
+	// Find the same primes again and precompute the Garner inverses of the
+	// products of the previous primes
+	p = 0;
+	for (i = 0; i < count; i++) {
+		bqint_word mod = 1;
+
+		p = bqint__prev_prime_word(p);
+		for (j = 0; j < i; j++) {
+			mod = (bqint_word)((bqint_dword)mod * rns->primes[j] % p);
+		}
+		rns->primes[i] = p;
+		rns->inverses[i] = bqint__powmod_word(mod, p - 2, p);
+	}
+	return 1;
+}
+
+void bqint_rns_free(bqint_rns *rns)
+{
+	if (rns->primes) {
+		BQINT__STAT_FREE(2 * rns->count * sizeof(bqint_word));
+		bqint_free_memory(rns->primes);
+	}
+	rns->primes = 0;
+	rns->inverses = 0;
+	rns->count = 0;
+	bqint_free(&rns->modulus);
+	bqint_free(&rns->half);
+}
+
+void bqint_rns_set(const bqint_rns *rns, bqint_word *residues, const bqint *a)
+{
+	const bqint_word *words = bqint_get_words(a);
+	int negative = (a->flags & BQINT_NEGATIVE) != 0;
+	size_t i;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_RNS_SET, a->size);
+	for (i = 0; i < rns->count; i++) {
+		bqint_word r = bqint__mod_word(words, a->size, rns->primes[i]);
+		residues[i] = negative && r ? rns->primes[i] - r : r;
+	}
+	BQINT__STAT_END(BQINT_STAT_RNS_SET);
+}
+
+void bqint_rns_get(const bqint_rns *rns, bqint *result, const bqint_word *residues)
+{
+	const bqint_word *primes = rns->primes;
+	bqint_size res_size = bqint__clamp_size(rns->count + 1);
+	bqint_size size = 0, i, j;
+	bqint_word *digits, *res_words;
+	int truncated = 0;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_RNS_GET, rns->count);
+	res_words = bqint__reserve(result, &res_size);
+	result->flags &= ~BQINT_NEGATIVE;
+
+	// Mixed radix digits, value = d[0] + p[0] (d[1] + p[1] (d[2] + ...)):
+	// d[i] = (r[i] - (d[0] + p[0] (... + p[i - 2] d[i - 1]))) / (p[0] ... p[i - 1])
+	digits = (bqint_word*)bqint_alloc_memory(rns->count * sizeof(bqint_word));
+	if (!digits) {
+		BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+		BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+		bqint__set_error(result, BQINT_OUT_OF_MEMORY);
+		return;
+	}
+	BQINT__STAT_ALLOC(rns->count * sizeof(bqint_word));
+
+	for (i = 0; i < rns->count; i++) {
+		bqint_word p = primes[i];
+		bqint_dword x = 0;
+
+		for (j = i; j-- > 0; ) {
+			x = (x * primes[j] + digits[j]) % p;
+		}
+		x = (residues[i] + (bqint_dword)p - x) % p;
+		digits[i] = (bqint_word)(x * rns->inverses[i] % p);
+	}
+
+	// Evaluate the mixed radix representation with Horner's rule
+	for (i = rns->count; i-- > 0; ) {
+		bqint_word carry = digits[i];
+
+		for (j = 0; j < size; j++) {
+			bqint_dword mul = (bqint_dword)res_words[j] * primes[i] + carry;
+			res_words[j] = BQINT__LO(mul);
+			carry = BQINT__HI(mul);
+		}
+		if (carry) {
+			if (size < res_size) {
+				res_words[size++] = carry;
+			} else {
+				truncated = 1;
+			}
+		}
+	}
+
+	BQINT__STAT_FREE(rns->count * sizeof(bqint_word));
+	bqint_free_memory(digits);
+
+	if (truncated) {
+		bqint__truncate(result, BQINT_MAX_WORDS);
+		BQINT__STAT_END(BQINT_STAT_RNS_GET);
+		return;
+	}
+	bqint__truncate(result, size);
+
+	// Values above the half of the modulus are negative: result = -(M - result)
+	if (bqint__cmp_mag(result, &rns->half) > 0) {
+		const bqint_word *m_words = bqint_get_words(&rns->modulus);
+		bqint_dword borrow = 0;
+
+		if (rns->modulus.size > res_size) {
+			bqint__truncate(result, BQINT_MAX_WORDS);
+			BQINT__STAT_END(BQINT_STAT_RNS_GET);
+			return;
+		}
+
+		for (j = 0; j < rns->modulus.size; j++) {
+			bqint_dword diff = (bqint_dword)m_words[j]
+				- (j < size ? res_words[j] : 0) - borrow;
+			res_words[j] = BQINT__LO(diff);
+			borrow = BQINT__HI(diff) != 0;
+		}
+		size = rns->modulus.size;
+		while (size > 0 && !res_words[size - 1])
+			size--;
+		bqint__truncate(result, size);
+		bqint__set_sign(result, 1);
+	}
+	BQINT__STAT_END(BQINT_STAT_RNS_GET);
+}
+
+void bqint_rns_add(const bqint_rns *rns, bqint_word *result, const bqint_word *a, const bqint_word *b)
+{
+	const bqint_word *primes = rns->primes;
+	size_t i, count = rns->count;
+
+	for (i = 0; i < count; i++) {
+		bqint_dword sum = (bqint_dword)a[i] + b[i];
+		result[i] = (bqint_word)(sum >= primes[i] ? sum - primes[i] : sum);
+	}
+}
+
+void bqint_rns_sub(const bqint_rns *rns, bqint_word *result, const bqint_word *a, const bqint_word *b)
+{
+	const bqint_word *primes = rns->primes;
+	size_t i, count = rns->count;
+
+	for (i = 0; i < count; i++) {
+		bqint_word diff = (bqint_word)(a[i] - b[i]);
+		result[i] = a[i] >= b[i] ? diff : (bqint_word)(diff + primes[i]);
+	}
+}
+
+void bqint_rns_mul(const bqint_rns *rns, bqint_word *result, const bqint_word *a, const bqint_word *b)
+{
+	const bqint_word *primes = rns->primes;
+	size_t i, count = rns->count;
+
+	for (i = 0; i < count; i++) {
+		result[i] = (bqint_word)((bqint_dword)a[i] * b[i] % primes[i]);
+	}
+}
+
+// Words of the 64-bit value `hi:lo` given as two 32-bit halves
+#undef BQINT__FE_PAIR
+#if BQINT_WORD_BITS == 64
+#define BQINT__FE_PAIR(lo, hi) (bqint_word)((uint64_t)(hi) << 32 | (lo))
+#elif BQINT_WORD_BITS == 32
+#define BQINT__FE_PAIR(lo, hi) (bqint_word)(lo), (bqint_word)(hi)
+#elif BQINT_WORD_BITS == 16
+#define BQINT__FE_PAIR(lo, hi) (bqint_word)((lo) & 0xFFFF), (bqint_word)((lo) >> 16), \
+		(bqint_word)((hi) & 0xFFFF), (bqint_word)((hi) >> 16)
+#elif BQINT_WORD_BITS == 8
+#define BQINT__FE_PAIR(lo, hi) (bqint_word)((lo) & 0xFF), (bqint_word)((lo) >> 8 & 0xFF), \
+		(bqint_word)((lo) >> 16 & 0xFF), (bqint_word)((lo) >> 24), \
+		(bqint_word)((hi) & 0xFF), (bqint_word)((hi) >> 8 & 0xFF), \
+		(bqint_word)((hi) >> 16 & 0xFF), (bqint_word)((hi) >> 24)
+#endif
+
+static const bqint_word bqint__fe_prime_25519[] = {
+	BQINT__FE_PAIR(0xFFFFFFED, 0xFFFFFFFF), BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF),
+	BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF), BQINT__FE_PAIR(0xFFFFFFFF, 0x7FFFFFFF),
+};
+
+static const bqint_word bqint__fe_prime_secp256k1[] = {
+	BQINT__FE_PAIR(0xFFFFFC2F, 0xFFFFFFFE), BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF),
+	BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF), BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF),
+};
+
+static const bqint_word bqint__fe_prime_p256[] = {
+	BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF), BQINT__FE_PAIR(0xFFFFFFFF, 0x00000000),
+	BQINT__FE_PAIR(0x00000000, 0x00000000), BQINT__FE_PAIR(0x00000001, 0xFFFFFFFF),
+};
+
+static const bqint_word bqint__fe_prime_p384[] = {
+	BQINT__FE_PAIR(0xFFFFFFFF, 0x00000000), BQINT__FE_PAIR(0x00000000, 0xFFFFFFFF),
+	BQINT__FE_PAIR(0xFFFFFFFE, 0xFFFFFFFF), BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF),
+	BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF), BQINT__FE_PAIR(0xFFFFFFFF, 0xFFFFFFFF),
+};
+
+#undef BQINT__FE_PAIR
+
+// Prime of `field` and the number of words in its elements
+static const bqint_word *bqint__fe_field(int field, bqint_size *size)
+{
+	*size = (field == BQINT_FIELD_P384 ? 48 : 32) / sizeof(bqint_word);
+	switch (field) {
+	case BQINT_FIELD_25519: return bqint__fe_prime_25519;
+	case BQINT_FIELD_SECP256K1: return bqint__fe_prime_secp256k1;
+	case BQINT_FIELD_P256: return bqint__fe_prime_p256;
+	default: return bqint__fe_prime_p384;
+	}
+}
+
+// Split `num_chunks` 32-bit chunks from the words `w`
+static void bqint__fe_load(uint32_t *c, const bqint_word *w, size_t num_chunks)
+{
+	size_t i;
+
+#if BQINT_WORD_BITS == 64
+	for (i = 0; i < num_chunks; i += 2) {
+		c[i] = (uint32_t)w[i / 2];
+		c[i + 1] = (uint32_t)(w[i / 2] >> 32);
+	}
+#else
+	for (i = 0; i < num_chunks; i++) {
+		uint32_t chunk = 0;
+		size_t j;
+		for (j = 0; j < 32 / BQINT_WORD_BITS; j++)
+			chunk |= (uint32_t)w[i * (32 / BQINT_WORD_BITS) + j] << (j * BQINT_WORD_BITS);
+		c[i] = chunk;
+	}
+#endif
+}
+
+// Join the (carried) chunks `t` to words
+static void bqint__fe_store(bqint_word *w, const int64_t *t, size_t num_chunks)
+{
+	size_t i;
+
+#if BQINT_WORD_BITS == 64
+	for (i = 0; i < num_chunks; i += 2) {
+		w[i / 2] = (bqint_word)t[i] | (bqint_word)t[i + 1] << 32;
+	}
+#else
+	for (i = 0; i < num_chunks; i++) {
+		size_t j;
+		for (j = 0; j < 32 / BQINT_WORD_BITS; j++)
+			w[i * (32 / BQINT_WORD_BITS) + j] = (bqint_word)((uint32_t)t[i] >> (j * BQINT_WORD_BITS));
+	}
+#endif
+}
+
+// t = a b for elements of `size` words, with the multi-row kernels on small
+// words and a row at a time otherwise which is faster for these sizes
+static void bqint__fe_mul_words(bqint_word *t, const bqint_word *a, const bqint_word *b, bqint_size size)
+{
+	bqint_size i = 0;
+
+	memset(t, 0, size * sizeof(bqint_word));
+#if BQINT_WORD_BITS <= 16
+	for (; i + 4 <= size; i += 4)
+		t[i + size + 3] = bqint__addmul_4_words(t + i, a, size, b + i);
+#endif
+	for (; i < size; i++)
+		t[i + size] = bqint__addmul_1_words(t + i, a, size, b[i]);
+}
+
+// r = lo + hi c < 2^N for p = 2^N - c where `c` fits in a word: the high
+// half is folded with one row of multiplications and the top word of that
+// with one more
+static void bqint__fe_reduce_word(bqint_word *r, const bqint_word *t, bqint_size size, bqint_word c)
+{
+	bqint_dword x;
+	bqint_size i;
+
+	memcpy(r, t, size * sizeof(bqint_word));
+	x = (bqint_dword)bqint__addmul_1_words(r, t + size, size, c) * c;
+	for (i = 0; x && i < size; i++) {
+		x += r[i];
+		r[i] = BQINT__LO(x);
+		x = BQINT__HI(x);
+	}
+
+	// Wrapped past 2^N, the rest is small so adding c can't carry out again
+	if (x) {
+		x = c;
+		for (i = 0; x && i < size; i++) {
+			x += r[i];
+			r[i] = BQINT__LO(x);
+			x = BQINT__HI(x);
+		}
+	}
+}
+
+// r = t mod p for the double size `t` (any value below 2^2N)
+static void bqint__fe_reduce(int field, bqint_word *r, const bqint_word *t)
+{
+	uint32_t c[24];
+	int64_t s[12];
+	bqint_size size;
+	const bqint_word *p = bqint__fe_field(field, &size);
+	size_t num_chunks = (size_t)size * BQINT_WORD_BITS / 32;
+
+	switch (field) {
+	case BQINT_FIELD_25519:
+		// 2^256 = 38 (mod p)
+		bqint__fe_reduce_word(r, t, size, 38);
+		break;
+#if BQINT_WORD_BITS == 64
+	case BQINT_FIELD_SECP256K1:
+		bqint__fe_reduce_word(r, t, size, 0x1000003D1);
+		break;
+#endif
+	default:
+		bqint__fe_load(c, t, 2 * num_chunks);
+		if (field == BQINT_FIELD_SECP256K1)
+			bqint__field_reduce_secp256k1(s, c);
+		else if (field == BQINT_FIELD_P256)
+			bqint__field_reduce_p256(s, c);
+		else
+			bqint__field_reduce_p384(s, c);
+		bqint__fe_store(r, s, num_chunks);
+		break;
+	}
+
+	// Below 2^N, which is less than 3p for all the primes
+	while (bqint__cmp_n_words(r, p, size) >= 0)
+		bqint__sub_n_words(r, r, p, size);
+}
+
+bqint_size bqint_fe_size(int field)
+{
+	bqint_size size;
+	bqint__fe_field(field, &size);
+	return size;
+}
+
+void bqint_fe_prime(int field, bqint *result)
+{
+	bqint_size size;
+	const bqint_word *p = bqint__fe_field(field, &size);
+	bqint view = bqint_view(p, size);
+	bqint_set(result, &view);
+}
+
+void bqint_fe_set(int field, bqint_fe *r, const bqint *a)
+{
+	const bqint_word *a_words = bqint_get_words(a);
+	bqint_word t[2 * BQINT_FE_WORDS];
+	bqint_size size, i, j;
+
+	bqint__fe_field(field, &size);
+	memset(r, 0, sizeof(bqint_fe));
+
+	// Horner's rule on blocks of `size` words from the top: r = r 2^N + block
+	for (i = (a->size + size - 1) / size; i-- > 0; ) {
+		for (j = 0; j < size; j++)
+			t[j] = i * size + j < a->size ? a_words[i * size + j] : 0;
+		memcpy(t + size, r->words, size * sizeof(bqint_word));
+		bqint__fe_reduce(field, r->words, t);
+	}
+
+	if (a->flags & BQINT_NEGATIVE) {
+		bqint_fe zero;
+		memset(&zero, 0, sizeof(zero));
+		bqint_fe_sub(field, r, &zero, r);
+	}
+}
+
+void bqint_fe_set_u32(int field, bqint_fe *r, uint32_t val)
+{
+	bqint a = bqint_dynamic();
+	bqint__set_raw_u32(&a, val);
+	bqint_fe_set(field, r, &a);
+	bqint_free(&a);
+}
+
+void bqint_fe_get(int field, bqint *result, const bqint_fe *a)
+{
+	bqint_size size;
+	bqint view;
+
+	bqint__fe_field(field, &size);
+	view = bqint_view(a->words, size);
+	bqint_set(result, &view);
+}
+
+int bqint_fe_equal(int field, const bqint_fe *a, const bqint_fe *b)
+{
+	bqint_size size;
+	bqint__fe_field(field, &size);
+	return bqint__cmp_n_words(a->words, b->words, size) == 0;
+}
+
+void bqint_fe_add(int field, bqint_fe *r, const bqint_fe *a, const bqint_fe *b)
+{
+	bqint_size size;
+	const bqint_word *p = bqint__fe_field(field, &size);
+
+	if (bqint__add_n_words(r->words, a->words, b->words, size)
+			|| bqint__cmp_n_words(r->words, p, size) >= 0)
+		bqint__sub_n_words(r->words, r->words, p, size);
+}
+
+void bqint_fe_sub(int field, bqint_fe *r, const bqint_fe *a, const bqint_fe *b)
+{
+	bqint_size size;
+	const bqint_word *p = bqint__fe_field(field, &size);
+
+	if (bqint__sub_n_words(r->words, a->words, b->words, size))
+		bqint__add_n_words(r->words, r->words, p, size);
+}
+
+void bqint_fe_mul(int field, bqint_fe *r, const bqint_fe *a, const bqint_fe *b)
+{
+	bqint_word t[2 * BQINT_FE_WORDS];
+	bqint_size size;
+
+	bqint__fe_field(field, &size);
+	bqint__fe_mul_words(t, a->words, b->words, size);
+	bqint__fe_reduce(field, r->words, t);
 }
 
-void bqint_sub(bqint *result, const bqint *a, const bqint *b)
+void bqint_fe_sqr(int field, bqint_fe *r, const bqint_fe *a)
 {
-	int cmp = bqint_cmp(a, b);
-	bqint_size size = 0;
+	bqint_word t[2 * BQINT_FE_WORDS];
+	bqint_size size;
 
-	if (cmp > 0) {
-		bqint_size res_size = a->size;
-		bqint_word *res_words = bqint__reserve(result, &res_size);
-		size = bqint__sub_words(
-				res_words, res_size,
-				bqint_get_words(a), a->size,
-				bqint_get_words(b), b->size);
-	} else if (cmp < 0) {
-		// A - B = -(A - B)
-		bqint_size res_size = b->size;
-		bqint_word *res_words = bqint__reserve(result, &res_size);
-		size = bqint__sub_words(
-				res_words, res_size,
-				bqint_get_words(b), b->size,
-				bqint_get_words(a), a->size);
+	// The dedicated squaring doesn't pay off for these sizes
+	bqint__fe_field(field, &size);
+	bqint__fe_mul_words(t, a->words, a->words, size);
+	bqint__fe_reduce(field, r->words, t);
+}
 
-		result->flags |= BQINT_NEGATIVE;
-	} else {
-		// A - A = 0
-		bqint_set_zero(result);
+void bqint_fe_inv(int field, bqint_fe *r, const bqint_fe *a)
+{
+	bqint_fe table[16], x;
+	bqint_word e[BQINT_FE_WORDS];
+	bqint_size size;
+	const bqint_word *p = bqint__fe_field(field, &size);
+	size_t bit;
+	int i;
+
+	// e = p - 2, the low word of every prime is at least 2
+	memcpy(e, p, size * sizeof(bqint_word));
+	e[0] -= 2;
+
+	// Fixed 4-bit windows from the top, table[i] = a^i
+	bqint_fe_set_u32(field, &table[0], 1);
+	table[1] = *a;
+	for (i = 2; i < 16; i++)
+		bqint_fe_mul(field, &table[i], &table[i - 1], a);
+
+	x = table[0];
+	for (bit = (size_t)size * BQINT_WORD_BITS; bit > 0; ) {
+		unsigned digit = 0;
+		bit -= 4;
+		for (i = 3; i >= 0; i--)
+			digit = digit << 1 | (unsigned)(e[(bit + i) / BQINT_WORD_BITS] >> ((bit + i) % BQINT_WORD_BITS) & 1);
+		for (i = 0; i < 4; i++)
+			bqint_fe_sqr(field, &x, &x);
+		if (digit)
+			bqint_fe_mul(field, &x, &x, &table[digit]);
+	}
+	*r = x;
+}
+
+void bqint_accumulator_init(bqint_accumulator *acc)
+{
+	acc->lanes = 0;
+	acc->size = 0;
+	acc->capacity = 0;
+	acc->pending = 0;
+	acc->flags = 0;
+}
+
+void bqint_accumulator_free(bqint_accumulator *acc)
+{
+	if (acc->lanes) {
+		BQINT__STAT_FREE(2 * acc->capacity * sizeof(bqint_dword));
+		bqint_free_memory(acc->lanes);
 	}
+	bqint_accumulator_init(acc);
+}
 
-	result->flags = bqint__combine_flags(result->flags, a->flags | b->flags, BQINT_ERROR);
-	bqint__truncate(result, size);
+void bqint_accumulator_clear(bqint_accumulator *acc)
+{
+	size_t i;
+
+	for (i = 0; i < 2 * acc->capacity; i++) {
+		acc->lanes[i] = 0;
+	}
+	acc->size = 0;
+	acc->pending = 0;
+	acc->flags = 0;
+}
+
+// Make sure that there are at least `size` lanes, returns zero if out of memory
+static int bqint__accumulator_reserve(bqint_accumulator *acc, size_t size)
+{
+	size_t i, new_cap = acc->capacity * 2;
+	bqint_dword *lanes;
+
+	if (size <= acc->capacity)
+		return 1;
+
+	new_cap = new_cap > size ? new_cap : size;
+	new_cap = new_cap > 4 ? new_cap : 4;
+	lanes = (bqint_dword*)bqint_alloc_memory(2 * new_cap * sizeof(bqint_dword));
+	if (!lanes) {
+		BQINT_ASSERT_FLAG_SET(BQINT_OUT_OF_MEMORY);
+		BQINT__STAT_ERROR(BQINT_OUT_OF_MEMORY);
+		acc->flags |= BQINT_OUT_OF_MEMORY;
+		return 0;
+	}
+	BQINT__STAT_ALLOC(2 * new_cap * sizeof(bqint_dword));
+
+	for (i = 0; i < new_cap; i++) {
+		lanes[i] = i < acc->capacity ? acc->lanes[i] : 0;
+		lanes[new_cap + i] = i < acc->capacity ? acc->lanes[acc->capacity + i] : 0;
+	}
+
+	if (acc->lanes) {
+		BQINT__STAT_FREE(2 * acc->capacity * sizeof(bqint_dword));
+		bqint_free_memory(acc->lanes);
+	}
+	acc->lanes = lanes;
+	acc->capacity = new_cap;
+	return 1;
+}
+
+// Propagate the carries of lanes [0, size) leaving a single word in each,
+// returns the new number of used lanes
+static size_t bqint__accumulator_carry(bqint_dword *lanes, size_t size, size_t capacity)
+{
+	bqint_dword carry = 0;
+	size_t i;
+
+	for (i = 0; i < size || (carry && i < capacity); i++) {
+		bqint_dword lane = lanes[i] + carry;
+		lanes[i] = BQINT__LO(lane);
+		carry = BQINT__HI(lane);
+	}
+	return i;
+}
+
+// Propagate the carries of both signs, the lanes are reserved so that the
+// carries always fit
+static void bqint__accumulator_normalize(bqint_accumulator *acc)
+{
+	size_t pos, neg;
+
+	pos = bqint__accumulator_carry(acc->lanes, acc->size, acc->capacity);
+	neg = bqint__accumulator_carry(acc->lanes + acc->capacity, acc->size, acc->capacity);
+	acc->size = pos > neg ? pos : neg;
+	acc->pending = 0;
+}
+
+// Add `count` words to the lanes of the sign `negative`
+static void bqint__accumulate(bqint_accumulator *acc, const bqint_word *words,
+		size_t count, int negative)
+{
+	bqint_dword *lanes;
+	size_t i, size;
+
+	// Every lane can take 2^BQINT_WORD_BITS - 2 words on top of a normalized
+	// word before the carry can overflow it (the normalization adds a carry
+	// word too). Keep two spare lanes for the carries of the normalization.
+	if (acc->pending >= (bqint_word)~(bqint_word)0 - 1)
+		bqint__accumulator_normalize(acc);
+	size = count > acc->size ? count : acc->size;
+	if (!bqint__accumulator_reserve(acc, size + 2))
+		return;
+
+	lanes = acc->lanes + (negative ? acc->capacity : 0);
+	for (i = 0; i < count; i++) {
+		lanes[i] += words[i];
+	}
+	acc->size = size;
+	acc->pending++;
+}
+
+void bqint_accumulator_add(bqint_accumulator *acc, const bqint *a)
+{
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_ACCUMULATE, a->size);
+	acc->flags |= a->flags & BQINT_ERROR;
+	bqint__accumulate(acc, bqint_get_words(a), a->size, (a->flags & BQINT_NEGATIVE) != 0);
+	BQINT__STAT_END(BQINT_STAT_ACCUMULATE);
 }
 
-void bqint_shr_inplace(bqint *result, bqint_size shift)
+void bqint_accumulator_add_word(bqint_accumulator *acc, bqint_word word)
 {
-	bqint_size size = bqint__shr_words_inplace(bqint_get_words(result), result->size, shift);
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_ACCUMULATE, 1);
+	bqint__accumulate(acc, &word, word ? 1 : 0, 0);
+	BQINT__STAT_END(BQINT_STAT_ACCUMULATE);
+}
+
+void bqint_accumulator_get(bqint_accumulator *acc, bqint *result)
+{
+	const bqint_dword *big, *small;
+	bqint_size res_size, size;
+	bqint_word *res_words;
+	bqint_dword borrow = 0;
+	size_t i;
+	int negative = 0;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_ACCUMULATOR_GET, acc->size);
+	if (acc->size == 0) {
+		bqint_set_zero(result);
+		result->flags |= acc->flags;
+		BQINT__STAT_END(BQINT_STAT_ACCUMULATOR_GET);
+		return;
+	}
+
+	bqint__accumulator_normalize(acc);
+
+	// Compare the normalized sums of the signs from the top
+	big = acc->lanes;
+	small = acc->lanes + acc->capacity;
+	for (i = acc->size; i-- > 0; ) {
+		if (big[i] != small[i]) {
+			negative = big[i] < small[i];
+			break;
+		}
+	}
+	if (negative) {
+		const bqint_dword *tmp = big;
+		big = small;
+		small = tmp;
+	}
+
+	// result = big - small
+	res_size = bqint__clamp_size(acc->size);
+	res_words = bqint__reserve(result, &res_size);
+	for (i = 0; i < res_size; i++) {
+		bqint_dword diff = big[i] - small[i] - borrow;
+		res_words[i] = BQINT__LO(diff);
+		borrow = BQINT__HI(diff) != 0;
+	}
+
+	size = res_size;
+	while (size > 0 && !res_words[size - 1])
+		size--;
+	for (; i < acc->size; i++) {
+		if (big[i] != small[i])
+			size = BQINT_MAX_WORDS;
+	}
+
+	result->flags = bqint__combine_flags(result->flags, acc->flags, BQINT_ERROR);
 	bqint__truncate(result, size);
+	bqint__set_sign(result, negative);
+	BQINT__STAT_END(BQINT_STAT_ACCUMULATOR_GET);
 }
 
-int bqint_cmp(const bqint *a, const bqint *b)
+static int bqint__cmp(const bqint *a, const bqint *b)
 {
 	int sign, signdiff;
 	bqint_size i, size;
@@ -1068,5 +7261,611 @@ int bqint_cmp(const bqint *a, const bqint *b)
 	return 0;
 }
 
+int bqint_cmp(const bqint *a, const bqint *b)
+{
+	int cmp;
+	BQINT__STAT_TIMER
+
+	BQINT__STAT_BEGIN(BQINT_STAT_CMP, a->size > b->size ? a->size : b->size);
+	cmp = bqint__cmp(a, b);
+	BQINT__STAT_END(BQINT_STAT_CMP);
+	return cmp;
+}
+
+// Sort key of a value: the class (negative, zero or positive) and the size in
+// `hi` and the top 64 bits of the magnitude in `lo`, inverted for negative
+// values so that the keys order like the values
+typedef struct bqint__sort_key
+{
+	uint64_t hi, lo;
+	size_t index;
+} bqint__sort_key;
+
+#define BQINT__SORT_PASSES 16
+
+static void bqint__sort_key_init(bqint__sort_key *key, const bqint *a, size_t index)
+{
+	const bqint_word *words = bqint_get_words(a);
+	const uint64_t size_mask = ((uint64_t)1 << 62) - 1;
+	uint64_t top = 0;
+	unsigned bits = 0;
+	bqint_size i = a->size;
+
+	while (i > 0 && bits < 64) {
+		i--;
+		top |= (uint64_t)words[i] << (64 - BQINT_WORD_BITS - bits);
+		bits += BQINT_WORD_BITS;
+	}
+
+	key->index = index;
+	if (a->size == 0) {
+		key->hi = (uint64_t)1 << 62;
+		key->lo = 0;
+	} else if (a->flags & BQINT_NEGATIVE) {
+		key->hi = ~(uint64_t)a->size & size_mask;
+		key->lo = ~top;
+	} else {
+		key->hi = (uint64_t)2 << 62 | ((uint64_t)a->size & size_mask);
+		key->lo = top;
+	}
+}
+
+inline static unsigned bqint__sort_digit(const bqint__sort_key *key, unsigned pass)
+{
+	uint64_t half = pass < 8 ? key->lo : key->hi;
+	return (unsigned)(half >> (pass % 8 * 8)) & 0xff;
+}
+
+// Stable merge sort of keys that tie on the prefix by the full values
+static void bqint__sort_run(bqint__sort_key *keys, bqint__sort_key *tmp, size_t count,
+		const bqint *array)
+{
+	size_t width, i;
+
+	for (width = 1; width < count; width *= 2) {
+		for (i = 0; i < count; i += 2 * width) {
+			size_t mid = i + width < count ? i + width : count;
+			size_t end = mid + width < count ? mid + width : count;
+			size_t l = i, r = mid, o = i;
+
+			while (l < mid && r < end) {
+				if (bqint__cmp(&array[keys[r].index], &array[keys[l].index]) < 0)
+					tmp[o++] = keys[r++];
+				else
+					tmp[o++] = keys[l++];
+			}
+			while (l < mid)
+				tmp[o++] = keys[l++];
+			while (r < end)
+				tmp[o++] = keys[r++];
+		}
+		memcpy(keys, tmp, count * sizeof(bqint__sort_key));
+	}
+}
+
+static int bqint__sort_cmp(const void *a, const void *b)
+{
+	return bqint__cmp((const bqint*)a, (const bqint*)b);
+}
+
+void bqint_sort(bqint *array, size_t count)
+{
+	bqint__sort_key *keys, *tmp, *swap;
+	size_t *counts, i, j, bytes;
+	unsigned pass;
+	BQINT__STAT_TIMER
+
+	if (count < 2)
+		return;
+
+	BQINT__STAT_BEGIN(BQINT_STAT_SORT, count);
+
+	bytes = 2 * count * sizeof(bqint__sort_key) + BQINT__SORT_PASSES * 256 * sizeof(size_t);
+	keys = count <= ((size_t)-1 - BQINT__SORT_PASSES * 256 * sizeof(size_t)) / 2 / sizeof(bqint__sort_key)
+		? (bqint__sort_key*)bqint_alloc_memory(bytes) : 0;
+	if (!keys) {
+		qsort(array, count, sizeof(bqint), bqint__sort_cmp);
+		BQINT__STAT_END(BQINT_STAT_SORT);
+		return;
+	}
+	BQINT__STAT_ALLOC(bytes);
+	tmp = keys + count;
+	counts = (size_t*)(tmp + count);
+
+	// 1. Extract the keys and count the digits of all the passes at once
+	memset(counts, 0, BQINT__SORT_PASSES * 256 * sizeof(size_t));
+	for (i = 0; i < count; i++) {
+		bqint__sort_key_init(&keys[i], &array[i], i);
+		for (pass = 0; pass < BQINT__SORT_PASSES; pass++) {
+			counts[pass * 256 + bqint__sort_digit(&keys[i], pass)]++;
+		}
+	}
+
+	// 2. Least significant digit first radix sort, skipping the passes where
+	// every key has the same digit (most of the size bits)
+	for (pass = 0; pass < BQINT__SORT_PASSES; pass++) {
+		size_t *c = counts + pass * 256, sum = 0;
+
+		if (c[bqint__sort_digit(&keys[0], pass)] == count)
+			continue;
+
+		for (j = 0; j < 256; j++) {
+			size_t n = c[j];
+			c[j] = sum;
+			sum += n;
+		}
+		for (i = 0; i < count; i++) {
+			tmp[c[bqint__sort_digit(&keys[i], pass)]++] = keys[i];
+		}
+
+		swap = keys;
+		keys = tmp;
+		tmp = swap;
+	}
+
+	// 3. Order the runs of equal keys by the full values, keys of values that
+	// fit in 64 bits are exact
+	for (i = 0; i < count; i = j) {
+		for (j = i + 1; j < count; j++) {
+			if (keys[j].hi != keys[i].hi || keys[j].lo != keys[i].lo)
+				break;
+		}
+		if (j - i > 1 && array[keys[i].index].size > 64 / BQINT_WORD_BITS)
+			bqint__sort_run(keys + i, tmp, j - i, array);
+	}
+
+	// 4. Move the values to the sorted order following the cycles of the
+	// permutation, `index` is set to the position of the finished values
+	for (i = 0; i < count; i++) {
+		bqint value;
+
+		if (keys[i].index == i)
+			continue;
+
+		value = array[i];
+		j = i;
+		while (keys[j].index != i) {
+			size_t next = keys[j].index;
+			array[j] = array[next];
+			keys[j].index = j;
+			j = next;
+		}
+		array[j] = value;
+		keys[j].index = j;
+	}
+
+	// The buffers may have been swapped by the passes
+	if (tmp < keys)
+		keys = tmp;
+	BQINT__STAT_FREE(bytes);
+	bqint_free_memory(keys);
+	BQINT__STAT_END(BQINT_STAT_SORT);
+}
+
+size_t bqint_unique(bqint *array, size_t count)
+{
+	size_t i, num = 0;
+
+	for (i = 0; i < count; i++) {
+		if (num > 0 && bqint__cmp(&array[num - 1], &array[i]) == 0) {
+			bqint_free(&array[i]);
+		} else if (num++ != i) {
+			array[num - 1] = array[i];
+			array[i] = bqint_dynamic();
+		}
+	}
+
+	return num;
+}
+
+static const char bqint__digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+size_t bqint_string_size(const bqint *a, int base)
+{
+	size_t log2_base = 1;
+
+	BQINT_ASSERT(base >= 2 && base <= 36);
+	while ((2 << log2_base) <= base)
+		log2_base++;
+	return bqint_bit_length(a) / log2_base + 3;
+}
+
+size_t bqint_get_string(const bqint *a, char *buffer, size_t size, int base)
+{
+	bqint_job job;
+
+	bqint_job_get_string(&job, buffer, size, a, base);
+	while (bqint_job_step(&job, (uint64_t)-1) == BQINT_JOB_RUNNING) {
+	}
+	return job.length;
+}
+
+#define BQINT__JOB_VALUES (sizeof(((bqint_job*)0)->values) / sizeof(bqint))
+
+static void bqint__job_init(bqint_job *job, int type, bqint *result)
+{
+	size_t i;
+
+	job->type = type;
+	job->status = BQINT_JOB_RUNNING;
+	job->done = 0;
+	job->total = 0;
+	job->length = 0;
+	job->result = result;
+	job->buffer = 0;
+	job->size = 0;
+	job->pos = 0;
+	job->pending = 0;
+	job->phase = 0;
+	job->index = -1;
+	job->param = 0;
+	job->word = 0;
+	for (i = 0; i < BQINT__JOB_VALUES; i++)
+		job->values[i] = bqint_dynamic();
+}
+
+// Release the memory of the job and set the final status
+static void bqint__job_finish(bqint_job *job, int status)
+{
+	size_t i;
+
+	for (i = 0; i < BQINT__JOB_VALUES; i++)
+		bqint_free(&job->values[i]);
+	job->status = status;
+}
+
+// Error flags of the internal values of the job
+static bqint_flags bqint__job_error(const bqint_job *job)
+{
+	bqint_flags err = 0;
+	size_t i;
+
+	for (i = 0; i < BQINT__JOB_VALUES; i++)
+		err |= job->values[i].flags & BQINT_ERROR;
+	return err;
+}
+
+void bqint_job_mul(bqint_job *job, bqint *result, const bqint *a, const bqint *b)
+{
+	bqint *prod = &job->values[2];
+	bqint_size size;
+	bqint_word *words;
+
+	bqint__job_init(job, BQINT_JOB_MUL, result);
+	job->param = ((a->flags ^ b->flags) & BQINT_NEGATIVE) != 0;
+
+	// One row per word of the shorter operand
+	if (a->size < b->size) {
+		const bqint *t = a;
+		a = b;
+		b = t;
+	}
+	bqint__set_abs(&job->values[0], a);
+	bqint__set_abs(&job->values[1], b);
+	job->total = (uint64_t)a->size * b->size;
+
+	size = bqint__add_size(a->size, b->size);
+	words = bqint__reserve(prod, &size);
+	if (size < (size_t)a->size + b->size) {
+		prod->flags |= BQINT_TRUNCATED;
+		BQINT_ASSERT_FLAG_SET(BQINT_TRUNCATED);
+		BQINT__STAT_ERROR(BQINT_TRUNCATED);
+	} else {
+		memset(words, 0, size * sizeof(bqint_word));
+	}
+}
+
+static uint64_t bqint__job_mul_step(bqint_job *job, uint64_t budget)
+{
+	const bqint *a = &job->values[0], *b = &job->values[1];
+	bqint *prod = &job->values[2];
+	const bqint_word *a_words = bqint_get_words(a), *b_words = bqint_get_words(b);
+	bqint_word *words = bqint_get_words(prod);
+	bqint_flags err = bqint__job_error(job);
+	bqint_size size;
+	uint64_t spent = 0;
+
+	if (err) {
+		bqint__set_error(job->result, err);
+		bqint__job_finish(job, BQINT_JOB_DONE);
+		return 0;
+	}
+
+	while (job->pos < b->size && spent < budget) {
+		words[job->pos + a->size] = bqint__addmul_1_words(words + job->pos,
+				a_words, a->size, b_words[job->pos]);
+		job->pos++;
+		spent += a->size;
+	}
+
+	if (job->pos == b->size) {
+		size = a->size + b->size;
+		while (size > 0 && !words[size - 1])
+			size--;
+		bqint__truncate(prod, size);
+		bqint_set(job->result, prod);
+		bqint__set_sign(job->result, job->param);
+		bqint__job_finish(job, BQINT_JOB_DONE);
+	}
+	return spent;
+}
+
+void bqint_job_powmod(bqint_job *job, bqint *result, const bqint *base,
+		const bqint *exp, const bqint *mod)
+{
+	bqint *n = &job->values[0], *b = &job->values[1], *e = &job->values[2];
+	bqint *x = &job->values[3], *t = &job->values[4];
+	bqint_flags err = (base->flags | exp->flags | mod->flags) & BQINT_ERROR;
+	size_t bits, num_table, k;
+	bqint__mont m;
+
+	bqint__job_init(job, BQINT_JOB_POWMOD, result);
+	if (mod->size == 0) {
+		BQINT_ASSERT_FLAG_SET(BQINT_DIV_BY_ZERO);
+		BQINT__STAT_ERROR(BQINT_DIV_BY_ZERO);
+		bqint__set_error(result, err | BQINT_DIV_BY_ZERO);
+		bqint__job_finish(job, BQINT_JOB_DONE);
+		return;
+	}
+
+	// Base reduced to [0, |mod|), inverted for negative exponents
+	bqint__set_abs(n, mod);
+	bqint__divmod(0, b, base, n);
+	if ((b->flags & BQINT_NEGATIVE) && b->size > 0) {
+		b->flags &= ~BQINT_NEGATIVE;
+		bqint_sub(t, n, b);
+		bqint__swap(b, t);
+	}
+	if ((exp->flags & BQINT_NEGATIVE) && exp->size > 0) {
+		if (!bqint_invmod(t, b, n)) {
+			bqint__domain_error(result, 0, err);
+			bqint__job_finish(job, BQINT_JOB_DONE);
+			return;
+		}
+		bqint__swap(b, t);
+	}
+	bqint__set_abs(e, exp);
+
+	if (n->size == 1 && bqint_get_words(n)[0] == 1) {
+		bqint_set_zero(result);
+		result->flags |= err | bqint__job_error(job);
+		bqint__job_finish(job, BQINT_JOB_DONE);
+		return;
+	}
+
+	// Odd moduli use Montgomery multiplication with the result, x^2 and the
+	// window table in the temporaries of the context, even ones the binary
+	// method with division
+	k = n->size;
+	bits = bqint_bit_length(e);
+	job->pos = bits;
+	job->param = 1;
+	job->phase = 1;
+	if (bqint_get_words(n)[0] & 1) {
+		job->param = (int)bqint__pow_window(bits);
+		num_table = (size_t)1 << (job->param - 1);
+		if (!bqint__mont_init(&m, n, num_table + 2)) {
+			bqint__set_error(result, err | (m.storage.flags & BQINT_ERROR));
+			bqint__mont_free(&m);
+			bqint__job_finish(job, BQINT_JOB_DONE);
+			return;
+		}
+		memcpy(m.temps, m.one, k * sizeof(bqint_word));
+		bqint__mont_set(&m, m.temps + 2 * k, b);
+		job->word = m.n_inv;
+		job->values[3] = m.storage;
+		if (job->param > 1) {
+			job->phase = 0;
+			job->index = 0;
+		}
+		job->total = num_table;
+	} else {
+		bqint_set_u32(x, 1);
+	}
+	job->total = (job->total + bits + bits / (job->param + 1)) * 2 * k * k;
+}
+
+static uint64_t bqint__job_powmod_step(bqint_job *job, uint64_t budget)
+{
+	bqint *n = &job->values[0], *b = &job->values[1], *e = &job->values[2];
+	bqint *x = &job->values[3], *t = &job->values[4];
+	bqint_size k = n->size;
+	size_t bits = bqint_bit_length(e), window = (size_t)job->param, low, j;
+	size_t num_table = (size_t)1 << (window - 1);
+	uint64_t cost = 2 * (uint64_t)k * k, spent = 0;
+	int odd = bqint_get_words(n)[0] & 1;
+	bqint_word *r = 0, *sq = 0, *table = 0;
+	unsigned value;
+	bqint__mont m;
+
+	if (odd) {
+		bqint__mont_layout(&m, n, bqint_get_words(x), num_table + 2);
+		m.n_inv = job->word;
+		r = m.temps;
+		sq = m.temps + k;
+		table = m.temps + 2 * k;
+	}
+
+	while (spent < budget) {
+		if (job->phase == 0) {
+			// x^2 and the odd powers of the window
+			if (job->index == 0) {
+				bqint__mont_mul(&m, sq, table, table);
+			} else {
+				bqint__mont_mul(&m, table + job->index * k, table + (job->index - 1) * k, sq);
+			}
+			if ((size_t)++job->index == num_table) {
+				job->phase = 1;
+				job->index = -1;
+			}
+		} else if (job->pending > 0) {
+			if (odd) {
+				bqint__mont_mul(&m, r, r, r);
+			} else {
+				bqint_mul(t, x, x);
+				bqint__divmod(0, x, t, n);
+			}
+			job->pending--;
+		} else if (job->index >= 0) {
+			if (odd) {
+				bqint__mont_mul(&m, r, r, table + job->index * k);
+			} else {
+				bqint_mul(t, x, b);
+				bqint__divmod(0, x, t, n);
+			}
+			job->index = -1;
+		} else if (job->pos == 0) {
+			if (odd) {
+				bqint__mont_get(&m, job->result, r);
+			} else {
+				bqint_set(job->result, x);
+			}
+			job->result->flags |= bqint__job_error(job);
+			bqint__job_finish(job, BQINT_JOB_DONE);
+			break;
+		} else if (!bqint_test_bit(e, job->pos - 1)) {
+			job->pending = 1;
+			job->pos--;
+			continue;
+		} else {
+			// Longest window ending with a set bit: Square for each of its bits
+			// and multiply by the odd power, the first one is copied
+			low = job->pos > window ? job->pos - window : 0;
+			while (!bqint_test_bit(e, low))
+				low++;
+			value = 0;
+			for (j = job->pos; j-- > low; )
+				value = value << 1 | (unsigned)bqint_test_bit(e, j);
+
+			if (job->pos == bits) {
+				if (odd) {
+					memcpy(r, table + value / 2 * k, k * sizeof(bqint_word));
+				} else {
+					bqint_set(x, b);
+				}
+			} else {
+				job->pending = job->pos - low;
+				job->index = (int)(value / 2);
+			}
+			job->pos = low;
+			continue;
+		}
+		spent += cost;
+	}
+	return spent;
+}
+
+void bqint_job_get_string(bqint_job *job, char *buffer, size_t size, const bqint *a, int base)
+{
+	size_t required = bqint_string_size(a, base), chunk_bits = 0;
+	bqint_dword power = (bqint_dword)base;
+
+	bqint__job_init(job, BQINT_JOB_GET_STRING, 0);
+	if (size < required) {
+		job->length = required;
+		bqint__job_finish(job, BQINT_JOB_DONE);
+		return;
+	}
+
+	// The digits are written backwards from the end of the buffer
+	job->buffer = buffer;
+	job->size = size;
+	job->pos = size - 1;
+	job->param = base;
+	job->phase = (a->flags & BQINT_NEGATIVE) && a->size > 0;
+	bqint__set_abs(&job->values[0], a);
+
+	// Largest power of the base that fits in a word
+	job->index = 1;
+	while (power * (bqint_dword)base <= (bqint_dword)(bqint_word)~(bqint_word)0) {
+		power *= (bqint_dword)base;
+		job->index++;
+	}
+	job->word = (bqint_word)power;
+	while (power >> chunk_bits > 1)
+		chunk_bits++;
+	job->total = (uint64_t)a->size * ((uint64_t)a->size * BQINT_WORD_BITS / chunk_bits + 2) / 2;
+}
+
+static uint64_t bqint__job_get_string_step(bqint_job *job, uint64_t budget)
+{
+	bqint *v = &job->values[0];
+	bqint_word *words = bqint_get_words(v), rem;
+	bqint_size size;
+	uint64_t spent = 0;
+	int i;
+
+	while (spent < budget) {
+		if (v->size == 0) {
+			if (job->pos == job->size - 1)
+				job->buffer[--job->pos] = '0';
+			if (job->phase)
+				job->buffer[--job->pos] = '-';
+			job->length = job->size - 1 - job->pos;
+			memmove(job->buffer, job->buffer + job->pos, job->length);
+			job->buffer[job->length] = '\0';
+			bqint__job_finish(job, BQINT_JOB_DONE);
+			break;
+		}
+
+		spent += v->size;
+		rem = bqint__div_word_words(words, v->size, job->word);
+		size = v->size;
+		while (size > 0 && !words[size - 1])
+			size--;
+		bqint__truncate(v, size);
+
+		// Full chunks are padded with zeros, the last one stops at the top digit
+		for (i = 0; i < job->index && (size > 0 || rem > 0); i++) {
+			job->buffer[--job->pos] = bqint__digits[rem % job->param];
+			rem = (bqint_word)(rem / job->param);
+		}
+	}
+	return spent;
+}
+
+int bqint_job_step(bqint_job *job, uint64_t budget)
+{
+	uint64_t spent = 0;
+	BQINT__STAT_TIMER
+
+	if (job->status != BQINT_JOB_RUNNING)
+		return job->status;
+	if (budget == 0)
+		budget = 1;
+
+	BQINT__STAT_BEGIN(BQINT_STAT_JOB_STEP, job->values[0].size);
+	switch (job->type) {
+	case BQINT_JOB_MUL:
+		spent = bqint__job_mul_step(job, budget);
+		break;
+	case BQINT_JOB_POWMOD:
+		spent = bqint__job_powmod_step(job, budget);
+		break;
+	case BQINT_JOB_GET_STRING:
+		spent = bqint__job_get_string_step(job, budget);
+		break;
+	}
+	job->done += spent;
+	BQINT__STAT_END(BQINT_STAT_JOB_STEP);
+	return job->status;
+}
+
+void bqint_job_cancel(bqint_job *job)
+{
+	if (job->status == BQINT_JOB_RUNNING)
+		bqint__job_finish(job, BQINT_JOB_CANCELLED);
+}
+
+#endif
 #endif
+
+#undef BQINT__DECLARE
+#undef BQINT__IMPLEMENT
+
+#ifdef BQINT_INSTANCE
+	#undef BQINT__SUFFIX
+	#define BQINT__SUFFIX
+	#pragma pop_macro("BQINT_WORD_BITS")
+	#undef BQINT_INSTANCE
 #endif
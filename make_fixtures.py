@@ -74,6 +74,138 @@ small_fixtures = [
 	2 ** 31 - 1,
 ]
 
+shift_fixtures = [
+	0,
+	1,
+	2,
+	3,
+	7,
+	8,
+	9,
+	15,
+	16,
+	17,
+	31,
+	32,
+	33,
+	63,
+	64,
+	65,
+	100,
+	128,
+	129,
+	255,
+	256,
+	257,
+]
+
+def fibonacci(n):
+	a, b = 0, 1
+	for i in range(n):
+		a, b = b, a + b
+	return a
+
+def lcg_number(seed, bits):
+	num = 0
+	for i in range(0, bits, 32):
+		seed = (seed * 6364136223846793005 + 1442695040888963407) % 2 ** 64
+		num = num << 32 | seed >> 32
+	return num >> (bits % 32 and 32 - bits % 32) | 1 << (bits - 1)
+
+gcd_common = lcg_number(3, 300)
+
+gcd_fixtures = [
+	0,
+	1,
+	2,
+	12,
+	fibonacci(90),
+	fibonacci(91),
+	fibonacci(300),
+	fibonacci(301),
+	2 ** 89 - 1,
+	2 ** 127 - 1,
+	(2 ** 89 - 1) * (2 ** 127 - 1),
+	2 ** 521 - 1,
+	lcg_number(1, 512),
+	lcg_number(2, 1000),
+	lcg_number(1, 512) * gcd_common,
+	lcg_number(2, 1000) * gcd_common,
+	gcd_common * 2 ** 40,
+]
+
+def gcdext(a, b):
+	r0, r1, s0, s1, t0, t1 = a, b, 1, 0, 0, 1
+	while r1:
+		q = r0 // r1
+		r0, r1 = r1, r0 - q * r1
+		s0, s1 = s1, s0 - q * s1
+		t0, t1 = t1, t0 - q * t1
+	return r0, s0, t0
+
+def invmod(a, m):
+	g, s, t = gcdext(a % m, m)
+	return s % m if g == 1 else -1
+
+def iroot(a, k):
+	if a < 2:
+		return a
+	x = 1 << -(-a.bit_length() // k)
+	while True:
+		y = ((k - 1) * x + a // x ** (k - 1)) // k
+		if y >= x:
+			return x
+		x = y
+
+def factorial(n):
+	r = 1
+	for i in range(2, n + 1):
+		r *= i
+	return r
+
+def product(nums):
+	r = 1
+	for n in nums:
+		r *= n
+	return r
+
+# Binary splitting sum of the series p(n) = 3, q(n) = n + 1, a(n) = (-1)^n
+def bsplit(begin, end):
+	q = product(n + 1 for n in range(begin, end))
+	t = 0
+	for n in range(begin, end):
+		t += (-1) ** n * 3 ** (n - begin + 1) * product(m + 1 for m in range(n + 1, end))
+	return 3 ** (end - begin), q, t
+
+# Miller-Rabin with the first 13 primes as bases, exact for n < 3.3 * 10^24
+def is_prime(n):
+	bases = [2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41]
+	if n < 2:
+		return False
+	for p in bases:
+		if n % p == 0:
+			return n == p
+	d, s = n - 1, 0
+	while d % 2 == 0:
+		d, s = d // 2, s + 1
+	for a in bases:
+		x = pow(a, d, n)
+		if x == 1 or x == n - 1:
+			continue
+		for i in range(s - 1):
+			x = x * x % n
+			if x == n - 1:
+				break
+		else:
+			return False
+	return True
+
+def next_prime(n):
+	n = max(n, 1) + 1
+	while not is_prime(n):
+		n += 1
+	return n
+
 def bytes_le(num, minbytes=0):
 	while num or minbytes > 0:
 		yield num & 0xFF
@@ -86,6 +218,18 @@ def bytearray_le(num, minbytes=0):
 def write32(fl, num):
 	fl.write(bytearray_le(num, 4))
 
+def writestr(fl, s):
+	write32(fl, len(s))
+	fl.write(s)
+
+def to_base(num, base):
+	digits = ''
+	n = abs(num)
+	while n:
+		digits = '0123456789abcdefghijklmnopqrstuvwxyz'[n % base] + digits
+		n //= base
+	return '-' * (num < 0) + (digits or '0')
+
 def writenum(fl, num):
 	bts = bytearray_le(abs(num))
 	write32(fl, len(bts))
@@ -98,6 +242,7 @@ if not os.path.exists('bin'):
 with open('bin/fixtures.bin', 'wb') as fl:
 	write32(fl, len(fixtures))
 	write32(fl, len(small_fixtures))
+	write32(fl, len(shift_fixtures))
 
 	for f in fixtures:
 		writenum(fl, f)
@@ -105,16 +250,39 @@ with open('bin/fixtures.bin', 'wb') as fl:
 	for f in small_fixtures:
 		write32(fl, f)
 
+	for f in shift_fixtures:
+		write32(fl, f)
+
 	for a in fixtures:
 		for b in fixtures:
 			writenum(fl, a + b)
 			writenum(fl, a * b)
 			writenum(fl, a - b)
+			writenum(fl, a & b)
+			writenum(fl, a | b)
+			writenum(fl, a ^ b)
+			writenum(fl, a & ~b)
+			writenum(fl, -a & b)
+			writenum(fl, a | -b)
+			writenum(fl, -a ^ -b)
+			writenum(fl, -a & ~b)
+			writenum(fl, -a & -b)
 
 	for a in fixtures:
 		for b in small_fixtures:
 			writenum(fl, a >> b)
 
+	for a in fixtures:
+		writenum(fl, ~a)
+		writenum(fl, ~-a)
+
+	for a in fixtures:
+		for s in shift_fixtures:
+			writenum(fl, a << s)
+			writenum(fl, a >> s)
+			writenum(fl, -a << s)
+			writenum(fl, -a >> s)
+
 	for a in fixtures:
 		for b in fixtures:
 			if a > b:
@@ -124,3 +292,68 @@ with open('bin/fixtures.bin', 'wb') as fl:
 			else:
 				fl.write('=')
 
+	for a in fixtures:
+		for b in fixtures:
+			if b:
+				writenum(fl, a // b)
+				writenum(fl, a % b)
+			writenum(fl, gcdext(a, b)[0])
+
+	write32(fl, len(gcd_fixtures))
+
+	for f in gcd_fixtures:
+		writenum(fl, f)
+
+	for a in gcd_fixtures:
+		for b in gcd_fixtures:
+			g, s, t = gcdext(a, b)
+			writenum(fl, g)
+			writenum(fl, s)
+			writenum(fl, t)
+			if b:
+				writenum(fl, invmod(a, b))
+
+	for a in fixtures + gcd_fixtures:
+		root = iroot(a, 2)
+		writenum(fl, root)
+		writenum(fl, a - root * root)
+		writenum(fl, iroot(a, 3))
+		writenum(fl, iroot(a, 7))
+		writenum(fl, a ** 3)
+		writenum(fl, a ** 37)
+
+	writenum(fl, product(gcd_fixtures[1:]))
+	writenum(fl, factorial(255))
+	writenum(fl, sum((g if i % 2 else -g) * h for i, (g, h) in enumerate(zip(fixtures, fixtures[::-1]))))
+	writenum(fl, sum(g * g for g in fixtures))
+
+	for begin, end in [(0, 1), (0, 60), (7, 50)]:
+		for n in bsplit(begin, end):
+			writenum(fl, n)
+
+	for a in fixtures + gcd_fixtures:
+		write32(fl, is_prime(a))
+
+	for a in fixtures:
+		writenum(fl, next_prime(a))
+
+	for i, a in enumerate(fixtures):
+		for j, m in enumerate(gcd_fixtures[1:]):
+			writenum(fl, pow(a, small_fixtures[(i + j) % len(small_fixtures)], m))
+
+	for j, m in enumerate(gcd_fixtures[1:]):
+		writenum(fl, pow(fixtures[j], fixtures[-1 - j], m))
+
+	writenum(fl, 10 * sum(fixtures))
+	writenum(fl, sum(f if i % 3 else -f for i, f in enumerate(fixtures)))
+
+	for a in fixtures:
+		write32(fl, a.bit_length())
+		write32(fl, bin(a).count('1'))
+		write32(fl, (a & -a).bit_length() - 1 if a else 0)
+		write32(fl, (~a & (a + 1)).bit_length() - 1)
+
+	for a in fixtures:
+		writestr(fl, to_base(-a, 10))
+		writestr(fl, to_base(a, 36))
+
@@ -1,12 +1,50 @@
 #define inline
 #define _CRT_SECURE_NO_WARNINGS
+#include <assert.h>
+
+// Errors abort like in the default configuration unless a test expects them
+int expect_errors;
+#define BQINT_ASSERT(x) assert((x) || expect_errors)
+
 #define BQINT_IMPLEMENTATION
 #include "bqint.h"
+#define BQINT_INSTANCE 8
+#include "bqint.h"
+#if defined(__SIZEOF_INT128__)
+#define BQINT_INSTANCE 64
+#include "bqint.h"
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
 
+#ifdef BQINT_STATS
+uint64_t expected_truncated;
+#endif
+
+// Start or end a test that sets error flags on purpose, its truncations are
+// not counted by the stats test
+void expect_errors_begin(void)
+{
+#ifdef BQINT_STATS
+	bqint_stats stats;
+	bqint_stats_snapshot(&stats);
+	expected_truncated -= stats.truncated;
+#endif
+	expect_errors = 1;
+}
+
+void expect_errors_end(void)
+{
+#ifdef BQINT_STATS
+	bqint_stats stats;
+	bqint_stats_snapshot(&stats);
+	expected_truncated += stats.truncated;
+#endif
+	expect_errors = 0;
+}
+
 uint32_t read_u32(const char **ptr)
 {
 	const unsigned char *p = (const unsigned char*)*ptr;
@@ -91,10 +129,60 @@ void test_assert_equal(bqint *val, bqint *ref, const char *name)
 	test_assert(cmp == 0, "%s equal to reference (%s)", name, cmp_descs[cmp + 1]);
 }
 
+void negate(bqint *val)
+{
+	if (val->size > 0)
+		val->flags ^= BQINT_NEGATIVE;
+}
+
+// val = 2^200 + |low| negated for negative `low`, or 2^200 + 2^100 if `low` is
+// zero. The values have the same size and top 64 bits for the sort tests.
+void set_sort_tie(bqint *val, int low)
+{
+	bqint t = { 0 };
+
+	bqint_set_u32(val, 1);
+	bqint_shl_inplace(val, 200);
+	if (low == 0) {
+		bqint_set_bit(val, 100);
+	} else {
+		bqint_set_u32(&t, (uint32_t)(low < 0 ? -low : low));
+		bqint_add_inplace(val, &t);
+		if (low < 0)
+			negate(val);
+	}
+	bqint_free(&t);
+}
+
+// Deterministic xorshift64 generator for the random tests
+void test_random(void *user, void *data, size_t size)
+{
+	uint64_t *state = (uint64_t*)user;
+	unsigned char *bytes = (unsigned char*)data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		*state ^= *state << 13;
+		*state ^= *state >> 7;
+		*state ^= *state << 17;
+		bytes[i] = (unsigned char)(*state >> 32);
+	}
+}
+
+// Series term p(n) = 3, q(n) = n + 1, a(n) = (-1)^n, counts the calls
+void series_term(void *user, size_t n, bqint *p, bqint *q, bqint *a)
+{
+	++*(size_t*)user;
+	bqint_set_u32(p, 3);
+	bqint_set_u32(q, (uint32_t)n + 1);
+	bqint_set_i32(a, n % 2 ? -1 : 1);
+}
+
 struct bqtest_alloc_hdr
 {
 	struct bqtest_alloc_hdr *prev, *next;
 	uint64_t size;
+	uint64_t pad;  // Keep the returned memory 16 byte aligned like malloc()
 };
 
 struct bqtest_alloc_hdr alloc_head;
@@ -115,6 +203,13 @@ void *bqtest_alloc(size_t size)
 	return hdr + 1;
 }
 
+// Allocator that always fails for testing the error paths
+void *bqtest_alloc_fail(size_t size)
+{
+	(void)size;
+	return 0;
+}
+
 void bqtest_free(void *mem)
 {
 	struct bqtest_alloc_hdr *hdr = (struct bqtest_alloc_hdr*)mem;
@@ -150,16 +245,22 @@ int main(int argc, char **argv)
 	}
 
 	{
-		uint32_t num_binops = 3;
+		uint32_t num_binops = 12;
 		uint32_t num_small_binops = 1;
+		uint32_t num_unops = 2;
+		uint32_t num_shiftops = 4;
 		uint32_t fixi, fixj, bini;
 		const char *fixptr = fixture_data;
 		uint32_t num_fixtures = read_u32(&fixptr);
 		uint32_t num_small_fixtures = read_u32(&fixptr);
+		uint32_t num_shift_fixtures = read_u32(&fixptr);
 		bqint *fixtures = (bqint*)calloc(sizeof(bqint), num_fixtures);
 		uint32_t *small_fixtures = (uint32_t*)calloc(sizeof(uint32_t), num_small_fixtures);
+		uint32_t *shift_fixtures = (uint32_t*)calloc(sizeof(uint32_t), num_shift_fixtures);
 		bqint *binop_res = (bqint*)calloc(sizeof(bqint), num_fixtures*num_fixtures*num_binops);
 		bqint *small_binop_res = (bqint*)calloc(sizeof(bqint), num_fixtures*num_small_fixtures*num_small_binops);
+		bqint *unop_res = (bqint*)calloc(sizeof(bqint), num_fixtures*num_unops);
+		bqint *shiftop_res = (bqint*)calloc(sizeof(bqint), num_fixtures*num_shift_fixtures*num_shiftops);
 
 		// Read fixtures
 		for (fixi = 0; fixi < num_fixtures; fixi++) {
@@ -172,6 +273,11 @@ int main(int argc, char **argv)
 			small_fixtures[fixi] = read_u32(&fixptr);
 		}
 
+		// Read shift fixtures
+		for (fixi = 0; fixi < num_shift_fixtures; fixi++) {
+			shift_fixtures[fixi] = read_u32(&fixptr);
+		}
+
 		// Read fixture results
 		for (fixi = 0; fixi < num_fixtures; fixi++) {
 			for (fixj = 0; fixj < num_fixtures; fixj++) {
@@ -194,6 +300,18 @@ int main(int argc, char **argv)
 			}
 		}
 
+		// Read unary operation results
+		for (fixi = 0; fixi < num_fixtures * num_unops; fixi++) {
+			read_bqint(&unop_res[fixi], &fixptr);
+			test_assert_ok(&unop_res[fixi], "Unary operation result");
+		}
+
+		// Read shift operation results
+		for (fixi = 0; fixi < num_fixtures * num_shift_fixtures * num_shiftops; fixi++) {
+			read_bqint(&shiftop_res[fixi], &fixptr);
+			test_assert_ok(&shiftop_res[fixi], "Shift operation result");
+		}
+
 		// Test comparison
 		// - bqint_cmp
 		for (fixi = 0; fixi < num_fixtures; fixi++) {
@@ -205,6 +323,1082 @@ int main(int argc, char **argv)
 			}
 		}
 
+		// Test division
+		// - bqint_divmod
+		// - bqint_div
+		// - bqint_mod
+		// - bqint_gcd
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			for (fixj = 0; fixj < num_fixtures; fixj++) {
+				bqint *a = &fixtures[fixi], *b = &fixtures[fixj];
+				bqint quot = { 0 };
+				bqint rem = { 0 };
+				bqint val = { 0 };
+				bqint quot_ref = { 0 };
+				bqint rem_ref = { 0 };
+				bqint gcd_ref = { 0 };
+
+				if (b->size > 0) {
+					read_bqint(&quot_ref, &fixptr);
+					read_bqint(&rem_ref, &fixptr);
+
+					bqint_divmod(&quot, &rem, a, b);
+					test_assert_equal(&quot, &quot_ref, "Quotient");
+					test_assert_equal(&rem, &rem_ref, "Remainder");
+
+					bqint_div(&val, a, b);
+					test_assert_equal(&val, &quot_ref, "Div result");
+					bqint_mod(&val, a, b);
+					test_assert_equal(&val, &rem_ref, "Mod result");
+
+					bqint_set(&quot, a);
+					bqint_set(&rem, b);
+					bqint_divmod(&quot, &rem, &quot, &rem);
+					test_assert_equal(&quot, &quot_ref, "In-place quotient");
+					test_assert_equal(&rem, &rem_ref, "In-place remainder");
+
+					// Rounds towards zero, remainder has the sign of the dividend
+					bqint_set(&val, a);
+					negate(&val);
+					negate(&quot_ref);
+					negate(&rem_ref);
+					bqint_divmod(&quot, &rem, &val, b);
+					test_assert_equal(&quot, &quot_ref, "Negative quotient");
+					test_assert_equal(&rem, &rem_ref, "Negative remainder");
+
+					// -(a / b) b is divisible by b
+					bqint_set_zero(&rem);
+					bqint_mul(&rem, &quot_ref, b);
+					negate(&rem);
+					bqint_divexact(&quot, &rem, b);
+					test_assert_equal(&quot, &quot_ref, "Exact quotient");
+					bqint_divexact(&rem, &rem, b);
+					test_assert_equal(&rem, &quot_ref, "In-place exact quotient");
+
+					bqint_set_zero(&val);
+					bqint_mul(&val, a, b);
+					bqint_set(&rem, b);
+					bqint_divexact(&rem, &val, &rem);
+					test_assert_equal(&rem, a, "Exact quotient of a product");
+				}
+
+				read_bqint(&gcd_ref, &fixptr);
+				bqint_gcd(&val, a, b);
+				test_assert_equal(&val, &gcd_ref, "GCD result");
+
+				bqint_free(&quot);
+				bqint_free(&rem);
+				bqint_free(&val);
+				bqint_free(&quot_ref);
+				bqint_free(&rem_ref);
+				bqint_free(&gcd_ref);
+			}
+		}
+
+		// Test exact division by words
+		// - bqint_divexact_word
+		{
+			static const bqint_word divisors[] = { 1, 2, 3, 10, 127, 128, 255, (bqint_word)~(bqint_word)0 };
+			bqint val = { 0 };
+			bqint d;
+			int i;
+
+			for (fixi = 0; fixi < num_fixtures; fixi++) {
+				for (i = 0; i < (int)(sizeof(divisors) / sizeof(*divisors)); i++) {
+					bqint_word w = divisors[i];
+					d = bqint_view(&divisors[i], 1);
+					bqint_set_zero(&val);
+					bqint_mul(&val, &fixtures[fixi], &d);
+					negate(&val);
+					bqint_divexact_word(&val, &val, w);
+					negate(&val);
+					test_assert_equal(&val, &fixtures[fixi], "Exact quotient by word");
+				}
+			}
+
+			bqint_free(&val);
+		}
+
+		// Test number theory
+		// - bqint_gcd
+		// - bqint_gcdext
+		// - bqint_invmod
+		{
+			uint32_t num_gcd_fixtures = read_u32(&fixptr);
+			bqint *gcd_fixtures = (bqint*)calloc(sizeof(bqint), num_gcd_fixtures);
+
+			for (fixi = 0; fixi < num_gcd_fixtures; fixi++) {
+				read_bqint(&gcd_fixtures[fixi], &fixptr);
+				test_assert_ok(&gcd_fixtures[fixi], "GCD fixture");
+			}
+
+			for (fixi = 0; fixi < num_gcd_fixtures; fixi++) {
+				for (fixj = 0; fixj < num_gcd_fixtures; fixj++) {
+					bqint *a = &gcd_fixtures[fixi], *b = &gcd_fixtures[fixj];
+					bqint g = { 0 };
+					bqint s = { 0 };
+					bqint t = { 0 };
+					bqint g_ref = { 0 };
+					bqint s_ref = { 0 };
+					bqint t_ref = { 0 };
+					bqint inv_ref = { 0 };
+					bqint na = { 0 };
+					bqint nb = { 0 };
+					bqint x = { 0 };
+					bqint y = { 0 };
+					bqint z = { 0 };
+					int sign, x_neg, y_neg;
+
+					read_bqint(&g_ref, &fixptr);
+					read_bqint(&s_ref, &fixptr);
+					read_bqint(&t_ref, &fixptr);
+
+					bqint_gcdext(&g, &s, &t, a, b);
+					test_assert_equal(&g, &g_ref, "Extended GCD result");
+					test_assert_equal(&s, &s_ref, "Extended GCD first cofactor");
+					test_assert_equal(&t, &t_ref, "Extended GCD second cofactor");
+
+					// Negative inputs into outputs holding a stale error, checked
+					// with a s + b t = g. The arithmetic doesn't handle signs yet so
+					// the products are combined by their magnitudes.
+					for (sign = 1; sign < 4; sign++) {
+						bqint_set(&na, a);
+						bqint_set(&nb, b);
+						if (sign & 1)
+							negate(&na);
+						if (sign & 2)
+							negate(&nb);
+						g.flags |= BQINT_DIV_BY_ZERO;
+						s.flags |= BQINT_DIV_BY_ZERO;
+						t.flags |= BQINT_DIV_BY_ZERO;
+						bqint_gcdext(&g, &s, &t, &na, &nb);
+						test_assert_equal(&g, &g_ref, "Extended GCD of negative values");
+						test_assert_ok(&s, "Extended GCD of negative values first cofactor");
+						test_assert_ok(&t, "Extended GCD of negative values second cofactor");
+
+						bqint_set_zero(&x);
+						bqint_mul(&x, &na, &s);
+						bqint_set_zero(&y);
+						bqint_mul(&y, &nb, &t);
+						x_neg = x.size > 0 && ((na.flags ^ s.flags) & BQINT_NEGATIVE);
+						y_neg = y.size > 0 && ((nb.flags ^ t.flags) & BQINT_NEGATIVE);
+						bqint_set_zero(&z);
+						if (x_neg == y_neg) {
+							bqint_add(&z, &x, &y);
+						} else if (x_neg) {
+							bqint_sub(&z, &y, &x);
+						} else {
+							bqint_sub(&z, &x, &y);
+						}
+						test_assert_equal(&z, &g_ref, "Extended GCD of negative values identity");
+					}
+
+					bqint_gcd(&g, a, b);
+					test_assert_equal(&g, &g_ref, "Large GCD result");
+
+					bqint_set_threshold(BQINT_THRESHOLD_GCD_LEHMER, 0);
+					bqint_gcd(&g, a, b);
+					test_assert_equal(&g, &g_ref, "Lehmer GCD result");
+					bqint_set_threshold(BQINT_THRESHOLD_GCD_LEHMER, (size_t)-1);
+					bqint_gcd(&g, a, b);
+					test_assert_equal(&g, &g_ref, "Binary GCD result");
+					bqint_set_threshold(BQINT_THRESHOLD_GCD_LEHMER, BQINT_GCD_LEHMER_THRESHOLD);
+
+					if (b->size > 0) {
+						int ok;
+						read_bqint(&inv_ref, &fixptr);
+						ok = bqint_invmod(&g, a, b);
+						if (inv_ref.flags & BQINT_NEGATIVE) {
+							test_assert(!ok, "No modular inverse");
+						} else {
+							test_assert(ok, "Modular inverse exists");
+							test_assert_equal(&g, &inv_ref, "Modular inverse");
+						}
+					}
+
+					bqint_free(&g);
+					bqint_free(&s);
+					bqint_free(&t);
+					bqint_free(&g_ref);
+					bqint_free(&s_ref);
+					bqint_free(&t_ref);
+					bqint_free(&inv_ref);
+					bqint_free(&na);
+					bqint_free(&nb);
+					bqint_free(&x);
+					bqint_free(&y);
+					bqint_free(&z);
+				}
+			}
+
+			// Test roots
+			// - bqint_sqrt
+			// - bqint_sqrtrem
+			// - bqint_root
+			// - bqint_is_square
+			// - bqint_pow
+			// - bqint_pow_word
+			for (fixi = 0; fixi < num_fixtures + num_gcd_fixtures; fixi++) {
+				bqint *a = fixi < num_fixtures ? &fixtures[fixi] : &gcd_fixtures[fixi - num_fixtures];
+				bqint root = { 0 };
+				bqint rem = { 0 };
+				bqint val = { 0 };
+				bqint one = { 0 };
+				bqint root_ref = { 0 };
+				bqint rem_ref = { 0 };
+				bqint cbrt_ref = { 0 };
+				bqint root7_ref = { 0 };
+				bqint cube_ref = { 0 };
+				bqint pow37_ref = { 0 };
+
+				read_bqint(&root_ref, &fixptr);
+				read_bqint(&rem_ref, &fixptr);
+				read_bqint(&cbrt_ref, &fixptr);
+				read_bqint(&root7_ref, &fixptr);
+				read_bqint(&cube_ref, &fixptr);
+				read_bqint(&pow37_ref, &fixptr);
+
+				bqint_sqrtrem(&root, &rem, a);
+				test_assert_equal(&root, &root_ref, "Square root");
+				test_assert_equal(&rem, &rem_ref, "Square root remainder");
+
+				bqint_set(&val, a);
+				bqint_sqrt(&val, &val);
+				test_assert_equal(&val, &root_ref, "In-place square root");
+
+				bqint_root(&val, a, 2);
+				test_assert_equal(&val, &root_ref, "Second root");
+				bqint_root(&val, a, 3);
+				test_assert_equal(&val, &cbrt_ref, "Cube root");
+				bqint_root(&val, a, 7);
+				test_assert_equal(&val, &root7_ref, "Seventh root");
+
+				// Odd roots of negative values round towards zero
+				bqint_set(&val, a);
+				negate(&val);
+				negate(&cbrt_ref);
+				bqint_root(&val, &val, 3);
+				test_assert_equal(&val, &cbrt_ref, "Negative cube root");
+
+				test_assert(bqint_is_square(a) == (rem_ref.size == 0), "Perfect square");
+
+				bqint_set_u32(&one, 1);
+				bqint_set_zero(&val);
+				bqint_mul(&val, a, a);
+				test_assert(bqint_is_square(&val), "Squared value is square");
+				bqint_add_inplace(&val, &one);
+				test_assert(bqint_is_square(&val) == (a->size == 0), "Square plus one");
+
+				bqint_pow(&val, a, 3);
+				test_assert_equal(&val, &cube_ref, "Cube");
+				bqint_pow(&val, a, 37);
+				test_assert_equal(&val, &pow37_ref, "Power with window");
+				bqint_pow(&val, a, 0);
+				test_assert_equal(&val, &one, "Zeroth power");
+
+				bqint_set(&val, a);
+				negate(&val);
+				negate(&cube_ref);
+				bqint_pow(&val, &val, 3);
+				test_assert_equal(&val, &cube_ref, "Negative in-place cube");
+
+				bqint_pow_word(&val, 2, (uint32_t)fixi);
+				bqint_shl(&root, &one, fixi);
+				test_assert_equal(&val, &root, "Power of two");
+
+				bqint_free(&root);
+				bqint_free(&rem);
+				bqint_free(&val);
+				bqint_free(&one);
+				bqint_free(&root_ref);
+				bqint_free(&rem_ref);
+				bqint_free(&cbrt_ref);
+				bqint_free(&root7_ref);
+				bqint_free(&cube_ref);
+				bqint_free(&pow37_ref);
+			}
+
+			// Test products
+			// - bqint_product
+			// - bqint_product_words
+			// - bqint_dot
+			// - bqint_bsplit
+			{
+				bqint val = { 0 };
+				bqint p = { 0 };
+				bqint q = { 0 };
+				bqint t = { 0 };
+				bqint prod_ref = { 0 };
+				bqint fact_ref = { 0 };
+				bqint_word words[255];
+				size_t ranges[3][2] = { { 0, 1 }, { 0, 60 }, { 7, 50 } };
+				size_t i, calls;
+
+				read_bqint(&prod_ref, &fixptr);
+				read_bqint(&fact_ref, &fixptr);
+
+				bqint_product(&val, gcd_fixtures + 1, num_gcd_fixtures - 1);
+				test_assert_equal(&val, &prod_ref, "Product");
+
+				negate(&gcd_fixtures[3]);
+				negate(&prod_ref);
+				bqint_product(&val, gcd_fixtures + 1, num_gcd_fixtures - 1);
+				test_assert_equal(&val, &prod_ref, "Negative product");
+				negate(&gcd_fixtures[3]);
+
+				bqint_product(&val, gcd_fixtures, num_gcd_fixtures);
+				test_assert(val.size == 0 && !(val.flags & BQINT_NEGATIVE), "Product with zero");
+
+				bqint_set_u32(&p, 1);
+				bqint_product(&val, gcd_fixtures, 0);
+				test_assert_equal(&val, &p, "Empty product");
+
+				for (i = 0; i < 255; i++) {
+					words[i] = (bqint_word)(i + 1);
+				}
+				bqint_product_words(&val, words, 255);
+				test_assert_equal(&val, &fact_ref, "Product of words");
+
+				{
+					bqint *signed_fixtures = (bqint*)malloc(sizeof(bqint) * num_fixtures);
+					bqint *reversed_fixtures = (bqint*)malloc(sizeof(bqint) * num_fixtures);
+					bqint dot_ref = { 0 };
+					bqint squares_ref = { 0 };
+
+					read_bqint(&dot_ref, &fixptr);
+					read_bqint(&squares_ref, &fixptr);
+
+					for (i = 0; i < num_fixtures; i++) {
+						signed_fixtures[i] = bqint_dynamic();
+						bqint_set(&signed_fixtures[i], &fixtures[i]);
+						if (i % 2 == 0)
+							negate(&signed_fixtures[i]);
+						reversed_fixtures[i] = bqint_view(bqint_get_words(&fixtures[num_fixtures - 1 - i]),
+								fixtures[num_fixtures - 1 - i].size);
+					}
+
+					bqint_dot(&val, signed_fixtures, reversed_fixtures, num_fixtures);
+					test_assert_equal(&val, &dot_ref, "Dot product");
+
+					bqint_dot(&val, fixtures, fixtures, num_fixtures);
+					test_assert_equal(&val, &squares_ref, "Dot product of squares");
+
+					bqint_dot(&val, fixtures, fixtures, 0);
+					test_assert(val.size == 0 && !(val.flags & BQINT_NEGATIVE), "Empty dot product");
+
+					bqint_dot(&signed_fixtures[0], signed_fixtures, reversed_fixtures, num_fixtures);
+					test_assert_equal(&signed_fixtures[0], &dot_ref, "Dot product into a term");
+
+					for (i = 0; i < num_fixtures; i++) {
+						bqint_free(&signed_fixtures[i]);
+					}
+					free(signed_fixtures);
+					free(reversed_fixtures);
+					bqint_free(&dot_ref);
+					bqint_free(&squares_ref);
+				}
+
+				for (i = 0; i < 3; i++) {
+					bqint p_ref = { 0 };
+					bqint q_ref = { 0 };
+					bqint t_ref = { 0 };
+
+					read_bqint(&p_ref, &fixptr);
+					read_bqint(&q_ref, &fixptr);
+					read_bqint(&t_ref, &fixptr);
+
+					calls = 0;
+					bqint_bsplit(&p, &q, &t, ranges[i][0], ranges[i][1], &series_term, &calls);
+					test_assert_equal(&p, &p_ref, "Binary splitting P");
+					test_assert_equal(&q, &q_ref, "Binary splitting Q");
+					test_assert_equal(&t, &t_ref, "Binary splitting T");
+					test_assert(calls == ranges[i][1] - ranges[i][0], "Binary splitting term calls");
+
+					bqint_free(&p_ref);
+					bqint_free(&q_ref);
+					bqint_free(&t_ref);
+				}
+
+				bqint_free(&val);
+				bqint_free(&p);
+				bqint_free(&q);
+				bqint_free(&t);
+				bqint_free(&prod_ref);
+				bqint_free(&fact_ref);
+			}
+
+			// Test primes
+			// - bqint_is_probable_prime
+			// - bqint_next_prime
+			// - bqint_powmod
+			{
+				// Strong pseudoprimes to base 2 as (high, low) 32-bit halves
+				static const uint32_t pseudoprimes[][2] = {
+					{ 0x0, 0x7ff },
+					{ 0x0, 0xbfa17dc7 },
+					{ 0x105, 0x3cb094c1 },
+					{ 0x1f5, 0x1f3fee3b },
+					{ 0x329, 0x7381cdf },
+					{ 0x136a3, 0x52b2c8c1 },
+					{ 0x35159127, 0x4f9af9fb },
+				};
+				bqint val = { 0 };
+				bqint ref = { 0 };
+				bqint exp = { 0 };
+				bqint mod = { 0 };
+				uint32_t prime;
+				int i;
+
+				for (fixi = 0; fixi < num_fixtures + num_gcd_fixtures; fixi++) {
+					bqint *a = fixi < num_fixtures ? &fixtures[fixi] : &gcd_fixtures[fixi - num_fixtures];
+					prime = read_u32(&fixptr);
+					test_assert(bqint_is_probable_prime(a) == (int)prime, "Probable prime");
+
+					bqint_set(&val, a);
+					negate(&val);
+					test_assert(!bqint_is_probable_prime(&val), "Negative values are not prime");
+				}
+
+				for (fixi = 0; fixi < num_fixtures; fixi++) {
+					read_bqint(&ref, &fixptr);
+					bqint_next_prime(&val, &fixtures[fixi]);
+					test_assert_equal(&val, &ref, "Next prime");
+
+					if (bqint_bit_length(&fixtures[fixi]) <= 64) {
+						bqint_set(&val, &fixtures[fixi]);
+						bqint_next_prime(&val, &val);
+						test_assert_equal(&val, &ref, "In-place next prime");
+					}
+				}
+
+				for (fixi = 0; fixi < num_fixtures; fixi++) {
+					for (fixj = 1; fixj < num_gcd_fixtures; fixj++) {
+						bqint *a = &fixtures[fixi], *m = &gcd_fixtures[fixj];
+
+						read_bqint(&ref, &fixptr);
+						bqint_set_u32(&exp, small_fixtures[(fixi + fixj - 1) % num_small_fixtures]);
+						bqint_powmod(&val, a, &exp, m);
+						test_assert_equal(&val, &ref, "Modular power");
+
+						bqint_set(&mod, m);
+						negate(&mod);
+						bqint_set(&val, a);
+						bqint_powmod(&val, &val, &exp, &mod);
+						test_assert_equal(&val, &ref, "In-place modular power with negative modulus");
+					}
+				}
+
+				for (fixj = 1; fixj < num_gcd_fixtures; fixj++) {
+					read_bqint(&ref, &fixptr);
+					bqint_powmod(&val, &fixtures[fixj - 1], &fixtures[num_fixtures - fixj], &gcd_fixtures[fixj]);
+					test_assert_equal(&val, &ref, "Modular power with a large exponent");
+				}
+
+				for (i = 0; i < (int)(sizeof(pseudoprimes) / sizeof(*pseudoprimes)); i++) {
+					bqint_set_u32(&val, pseudoprimes[i][0]);
+					bqint_shl_inplace(&val, 32);
+					bqint_set_u32(&ref, pseudoprimes[i][1]);
+					bqint_add_inplace(&val, &ref);
+					test_assert(!bqint_is_probable_prime(&val), "Strong pseudoprime to base 2");
+
+					bqint_set_u32(&exp, 1);
+					bqint_sub(&mod, &val, &exp);
+					bqint_set_u32(&exp, 2);
+					bqint_powmod(&ref, &exp, &mod, &val);
+					test_assert(ref.size == 1 && bqint_get_words(&ref)[0] == 1, "Fermat pseudoprime to base 2");
+				}
+
+				// -2^3 = 6 (mod 7), 3^-1 = 5 (mod 7)
+				bqint_set_u32(&val, 2);
+				negate(&val);
+				bqint_set_u32(&exp, 3);
+				bqint_set_u32(&mod, 7);
+				bqint_powmod(&ref, &val, &exp, &mod);
+				test_assert(ref.size == 1 && bqint_get_words(&ref)[0] == 6, "Modular power of a negative base");
+				bqint_set_u32(&val, 3);
+				bqint_set_u32(&exp, 1);
+				negate(&exp);
+				bqint_powmod(&ref, &val, &exp, &mod);
+				test_assert(ref.size == 1 && bqint_get_words(&ref)[0] == 5, "Modular power with a negative exponent");
+
+				// Allocation failures are not reported as composite
+				expect_errors_begin();
+				bqint_set_allocators(bqtest_alloc_fail, bqtest_free, 0);
+				test_assert(bqint_is_probable_prime(&gcd_fixtures[9]) == -1, "Probable prime allocation failure");
+				bqint_set_allocators(bqtest_alloc, bqtest_free, 0);
+				expect_errors_end();
+
+#ifdef BQINT_COMPACT
+				// The Montgomery context doesn't fit in BQINT_MAX_WORDS words
+				bqint_set_u32(&mod, 1);
+				bqint_shl_inplace(&mod, (size_t)(BQINT_MAX_WORDS / 6 + 1) * BQINT_WORD_BITS);
+				bqint_set_bit(&mod, 0);
+				bqint_set_u32(&exp, 3);
+				expect_errors_begin();
+				bqint_powmod(&ref, &val, &exp, &mod);
+				expect_errors_end();
+				test_assert((ref.flags & BQINT_TRUNCATED) != 0, "Modular power with a too large modulus");
+#endif
+
+				bqint_free(&val);
+				bqint_free(&ref);
+				bqint_free(&exp);
+				bqint_free(&mod);
+			}
+
+			// Test multi-exponentiation
+			// - bqint_multi_powmod
+			{
+				// Few terms with large exponents are interleaved, the 300 terms
+				// with small exponents from 5 onwards go to the buckets
+				static const size_t ranges[][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 5 }, { 5, 300 } };
+				bqint *bases = (bqint*)calloc(sizeof(bqint), 305);
+				bqint *exps = (bqint*)calloc(sizeof(bqint), 305);
+				bqint val = { 0 };
+				bqint ref = { 0 };
+				bqint pow = { 0 };
+				bqint prod = { 0 };
+				size_t i, c;
+
+				for (i = 0; i < 305; i++) {
+					bqint_set(&bases[i], &fixtures[(i * 7 + 3) % num_fixtures]);
+					if (i < 5 && i % 2 == 0)
+						bqint_set(&exps[i], &fixtures[num_fixtures - 1 - i]);
+					else
+						bqint_set_u32(&exps[i], small_fixtures[i % num_small_fixtures]);
+				}
+
+				for (fixj = 1; fixj < num_gcd_fixtures; fixj++) {
+					bqint *m = &gcd_fixtures[fixj];
+
+					for (c = 0; c < sizeof(ranges) / sizeof(*ranges); c++) {
+						bqint_set_u32(&ref, 1);
+						bqint_mod(&ref, &ref, m);
+						for (i = ranges[c][0]; i < ranges[c][0] + ranges[c][1]; i++) {
+							bqint_powmod(&pow, &bases[i], &exps[i], m);
+							bqint_set_zero(&prod);
+							bqint_mul(&prod, &ref, &pow);
+							bqint_mod(&ref, &prod, m);
+						}
+
+						bqint_multi_powmod(&val, bases + ranges[c][0], exps + ranges[c][0], ranges[c][1], m);
+						test_assert_equal(&val, &ref, "Multi-exponentiation");
+					}
+				}
+
+				// 3^-1 (-5)^3 4^0 = 5 (mod 7)
+				bqint_set_u32(&bases[0], 3);
+				bqint_set_u32(&exps[0], 1);
+				negate(&exps[0]);
+				bqint_set_u32(&bases[1], 5);
+				negate(&bases[1]);
+				bqint_set_u32(&exps[1], 3);
+				bqint_set_u32(&bases[2], 4);
+				bqint_set_zero(&exps[2]);
+				bqint_set_u32(&val, 7);
+				bqint_multi_powmod(&ref, bases, exps, 3, &val);
+				test_assert(ref.size == 1 && bqint_get_words(&ref)[0] == 5, "Multi-exponentiation with a negative exponent");
+
+				// Allocation failures of the tables are reported
+				expect_errors_begin();
+				bqint_set_allocators(bqtest_alloc_fail, bqtest_free, 0);
+				bqint_multi_powmod(&ref, bases, exps, 3, &val);
+				bqint_set_allocators(bqtest_alloc, bqtest_free, 0);
+				expect_errors_end();
+				test_assert((ref.flags & BQINT_OUT_OF_MEMORY) != 0, "Multi-exponentiation allocation failure");
+
+#ifdef BQINT_COMPACT
+				// The tables of 40 terms with 800-bit exponents and a 64-word
+				// modulus don't fit in BQINT_MAX_WORDS words
+				bqint_set_u32(&val, 1);
+				bqint_shl_inplace(&val, 64 * BQINT_WORD_BITS - 1);
+				bqint_set_bit(&val, 0);
+				bqint_set_u32(&ref, 1);
+				for (i = 0; i < 40; i++) {
+					bqint_set(&bases[i], &fixtures[(i * 7 + 3) % num_fixtures]);
+					bqint_set_u32(&exps[i], small_fixtures[i % num_small_fixtures]);
+					bqint_set_bit(&exps[i], 799 - i);
+					bqint_powmod(&pow, &bases[i], &exps[i], &val);
+					bqint_set_zero(&prod);
+					bqint_mul(&prod, &ref, &pow);
+					bqint_mod(&ref, &prod, &val);
+				}
+				bqint_multi_powmod(&pow, bases, exps, 40, &val);
+				test_assert_equal(&pow, &ref, "Multi-exponentiation with large tables");
+#endif
+
+				for (i = 0; i < 305; i++) {
+					bqint_free(&bases[i]);
+					bqint_free(&exps[i]);
+				}
+				free(bases);
+				free(exps);
+				bqint_free(&val);
+				bqint_free(&ref);
+				bqint_free(&pow);
+				bqint_free(&prod);
+			}
+
+			for (fixi = 0; fixi < num_gcd_fixtures; fixi++) {
+				bqint_free(&gcd_fixtures[fixi]);
+			}
+			free(gcd_fixtures);
+		}
+
+		// Test accumulator
+		// - bqint_accumulator_add
+		// - bqint_accumulator_add_word
+		// - bqint_accumulator_get
+		// - bqint_accumulator_clear
+		{
+			bqint_accumulator acc;
+			bqint val = { 0 };
+			bqint ref = { 0 };
+			bqint sum_ref = { 0 };
+			bqint mixed_ref = { 0 };
+			int i;
+
+			read_bqint(&sum_ref, &fixptr);
+			read_bqint(&mixed_ref, &fixptr);
+
+			bqint_accumulator_init(&acc);
+			bqint_accumulator_get(&acc, &val);
+			test_assert(val.size == 0, "Empty accumulator");
+
+			// Enough adds to propagate the carries in between with 8-bit words
+			for (i = 0; i < 10; i++) {
+				for (fixi = 0; fixi < num_fixtures; fixi++) {
+					bqint_accumulator_add(&acc, &fixtures[fixi]);
+				}
+			}
+			bqint_accumulator_get(&acc, &val);
+			test_assert_equal(&val, &sum_ref, "Accumulated sum");
+
+			bqint_accumulator_clear(&acc);
+			for (fixi = 0; fixi < num_fixtures; fixi++) {
+				bqint_set(&val, &fixtures[fixi]);
+				if (fixi % 3 == 0)
+					negate(&val);
+				bqint_accumulator_add(&acc, &val);
+			}
+			bqint_accumulator_get(&acc, &val);
+			test_assert_equal(&val, &mixed_ref, "Accumulated signed sum");
+
+			bqint_accumulator_clear(&acc);
+			for (i = 0; i < 1000; i++) {
+				bqint_word w = (bqint_word)~(bqint_word)i;
+				bqint word_val = bqint_view(&w, 1);
+				bqint_add_inplace(&ref, &word_val);
+				bqint_accumulator_add_word(&acc, w);
+			}
+			bqint_accumulator_get(&acc, &val);
+			test_assert_equal(&val, &ref, "Accumulated words");
+
+			bqint_accumulator_free(&acc);
+			bqint_free(&val);
+			bqint_free(&ref);
+			bqint_free(&sum_ref);
+			bqint_free(&mixed_ref);
+		}
+
+		// Test bit queries
+		// - bqint_bit_length
+		// - bqint_popcount
+		// - bqint_ctz
+		// - bqint_test_bit
+		// - bqint_set_bit
+		// - bqint_clear_bit
+		// - bqint_scan1
+		// - bqint_scan0
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			bqint *a = &fixtures[fixi];
+			uint32_t bit_length = read_u32(&fixptr);
+			uint32_t popcount = read_u32(&fixptr);
+			uint32_t ctz = read_u32(&fixptr);
+			uint32_t ones = read_u32(&fixptr);
+			bqint val = { 0 };
+			bqint ref = { 0 };
+			size_t bit, count;
+
+			test_assert(bqint_bit_length(a) == bit_length, "Bit length");
+			test_assert(bqint_popcount(a) == popcount, "Popcount");
+			test_assert(bqint_ctz(a) == ctz, "Trailing zeros");
+			test_assert(bqint_scan0(a, 0) == ones, "Scan for the first clear bit");
+			test_assert(bqint_scan1(a, 0) == (a->size ? ctz : BQINT_BIT_NONE), "Scan for the first set bit");
+			test_assert(bqint_scan1(a, bit_length) == BQINT_BIT_NONE, "Scan past the top bit");
+			test_assert(bqint_scan0(a, bit_length + 100) == bit_length + 100, "Scan for clear bits past the top bit");
+
+			count = 0;
+			for (bit = 0; bit < bit_length + 10; bit++) {
+				if (bqint_test_bit(a, bit))
+					count++;
+			}
+			test_assert(count == popcount, "Set bits tested");
+
+			count = 0;
+			for (bit = bqint_scan1(a, 0); bit != BQINT_BIT_NONE; bit = bqint_scan1(a, bit + 1)) {
+				test_assert(bqint_test_bit(a, bit), "Scanned bit is set");
+				test_assert(bqint_scan0(a, bit) != bit, "Scanned bit is not clear");
+				count++;
+			}
+			test_assert(count == popcount, "Set bits scanned");
+
+			// a + 2^(bit_length + 40)
+			bqint_set_u32(&ref, 1);
+			bqint_shl_inplace(&ref, bit_length + 40);
+			bqint_add_inplace(&ref, a);
+			bqint_set(&val, a);
+			bqint_set_bit(&val, bit_length + 40);
+			test_assert_equal(&val, &ref, "Set bit");
+			bqint_clear_bit(&val, bit_length + 40);
+			test_assert_equal(&val, a, "Cleared bit");
+			bqint_clear_bit(&val, bit_length + 100);
+			test_assert_equal(&val, a, "Cleared bit past the top bit");
+
+			for (bit = 0; bit < bit_length; bit++) {
+				bqint_clear_bit(&val, bit);
+			}
+			test_assert(val.size == 0, "All bits cleared");
+
+			bqint_free(&val);
+			bqint_free(&ref);
+		}
+
+		// Test string conversion
+		// - bqint_string_size
+		// - bqint_get_string
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			static const int bases[] = { 10, 36 };
+			bqint val = { 0 };
+			uint32_t length;
+			size_t size, len;
+			char *buffer;
+			int i;
+
+			bqint_set(&val, &fixtures[fixi]);
+			negate(&val);
+			for (i = 0; i < 2; i++) {
+				length = read_u32(&fixptr);
+				size = bqint_string_size(&val, bases[i]);
+				test_assert(size > length, "String size");
+				buffer = (char*)malloc(size);
+				len = bqint_get_string(&val, buffer, size, bases[i]);
+				test_assert(len == length, "String length");
+				test_assert(!memcmp(buffer, fixptr, length) && buffer[length] == '\0', "String digits");
+				test_assert(bqint_get_string(&val, buffer, length, bases[i]) > length, "String buffer too small");
+				fixptr += length;
+				free(buffer);
+				bqint_set(&val, &fixtures[fixi]);
+			}
+
+			bqint_free(&val);
+		}
+
+		// Test jobs
+		// - bqint_job_mul
+		// - bqint_job_powmod
+		// - bqint_job_get_string
+		// - bqint_job_step
+		// - bqint_job_cancel
+		{
+			bqint val = { 0 };
+			bqint ref = { 0 };
+			bqint exp = { 0 };
+			bqint_job job;
+			uint64_t done;
+			char buffer[64], ref_buffer[64];
+			int steps;
+
+			for (fixi = 0; fixi < num_fixtures; fixi++) {
+				for (fixj = 0; fixj < num_fixtures; fixj += 3) {
+					bqint *a = &fixtures[fixi], *b = &fixtures[fixj];
+
+					bqint_set_zero(&ref);
+					bqint_mul(&ref, a, b);
+					bqint_set(&val, b);
+					bqint_job_mul(&job, &val, a, &val);
+					done = 0;
+					while (bqint_job_step(&job, 1) == BQINT_JOB_RUNNING) {
+						test_assert(job.done > done, "Job makes progress");
+						test_assert_equal(&val, b, "Job result is written when done");
+						done = job.done;
+					}
+					test_assert(job.status == BQINT_JOB_DONE, "Job done");
+					test_assert_equal(&val, &ref, "Multiplication job");
+
+					if (fixj == 0 || !b->size)
+						continue;
+
+					bqint_set_u32(&exp, small_fixtures[(fixi + fixj) % num_small_fixtures]);
+					bqint_powmod(&ref, a, &exp, b);
+					bqint_job_powmod(&job, &val, a, &exp, b);
+					steps = 0;
+					while (bqint_job_step(&job, 50) == BQINT_JOB_RUNNING)
+						steps++;
+					test_assert_equal(&val, &ref, "Modular power job");
+
+					// A zero budget still makes progress on every step
+					bqint_set_zero(&val);
+					bqint_job_powmod(&job, &val, a, &exp, b);
+					done = 0;
+					while (bqint_job_step(&job, 0) == BQINT_JOB_RUNNING && job.done > done)
+						done = job.done;
+					test_assert(job.status == BQINT_JOB_DONE, "Job with a zero budget done");
+					test_assert_equal(&val, &ref, "Modular power job with a zero budget");
+
+					bqint_job_powmod(&job, &val, a, &fixtures[num_fixtures - 1], b);
+					bqint_job_step(&job, 10);
+					bqint_job_cancel(&job);
+					test_assert(job.status == BQINT_JOB_CANCELLED, "Job cancelled");
+					test_assert_equal(&val, &ref, "Cancelled job leaves the result untouched");
+				}
+			}
+
+			// -2^64 in base 10 written a few digits at a time
+			bqint_set_u32(&val, 1);
+			bqint_shl_inplace(&val, 64);
+			negate(&val);
+			bqint_job_get_string(&job, buffer, sizeof(buffer), &val, 10);
+			steps = 0;
+			while (bqint_job_step(&job, 1) == BQINT_JOB_RUNNING)
+				steps++;
+			test_assert(steps > 0, "String job takes multiple steps");
+			test_assert(job.length == 21 && !strcmp(buffer, "-18446744073709551616"), "String job");
+
+			bqint_job_get_string(&job, buffer, sizeof(buffer), &val, 10);
+			done = 0;
+			while (bqint_job_step(&job, 0) == BQINT_JOB_RUNNING && job.done > done)
+				done = job.done;
+			test_assert(job.status == BQINT_JOB_DONE && !strcmp(buffer, "-18446744073709551616"), "String job with a zero budget");
+
+			bqint_set_zero(&val);
+			test_assert(bqint_get_string(&val, ref_buffer, sizeof(ref_buffer), 2) == 1 && !strcmp(ref_buffer, "0"), "Zero string");
+			bqint_set_u32(&val, 255);
+			negate(&val);
+			test_assert(bqint_get_string(&val, ref_buffer, sizeof(ref_buffer), 16) == 3 && !strcmp(ref_buffer, "-ff"), "Hex string");
+
+			bqint_free(&val);
+			bqint_free(&ref);
+			bqint_free(&exp);
+		}
+
+		// Test random numbers
+		// - bqint_random_bits
+		// - bqint_random_below
+		{
+			uint64_t state = 0x9E3779B97F4A7C15ULL;
+			bqint val = { 0 };
+			bqint bound = { 0 };
+			size_t bits, counts[3] = { 0 }, max_bits = 0;
+			int i;
+
+			for (bits = 0; bits < 300; bits++) {
+				bqint_random_bits(&val, bits, &test_random, &state);
+				test_assert_ok(&val, "Random bits");
+				test_assert(bqint_bit_length(&val) <= bits, "Random bits length");
+				if (bqint_bit_length(&val) == bits)
+					max_bits++;
+			}
+			test_assert(max_bits > 100, "Random bits use the top bit");
+
+			for (fixi = 0; fixi < num_fixtures; fixi++) {
+				bqint *a = &fixtures[fixi];
+				if (a->size == 0)
+					continue;
+				for (i = 0; i < 20; i++) {
+					bqint_random_below(&val, a, &test_random, &state);
+					test_assert_ok(&val, "Random below bound");
+					test_assert(bqint_cmp(&val, a) < 0, "Random value below bound");
+				}
+			}
+
+			bqint_set_u32(&bound, 3);
+			for (i = 0; i < 3000; i++) {
+				bqint_random_below(&val, &bound, &test_random, &state);
+				counts[val.size ? bqint_get_words(&val)[0] : 0]++;
+			}
+			test_assert(counts[0] > 900 && counts[1] > 900 && counts[2] > 900, "Random values are uniform");
+
+			bqint_set_u32(&bound, 1);
+			bqint_shl_inplace(&bound, 200);
+			bqint_random_below(&bound, &bound, &test_random, &state);
+			test_assert(bqint_bit_length(&bound) <= 200 && bqint_bit_length(&bound) > 150, "Random below itself");
+
+			bqint_free(&val);
+			bqint_free(&bound);
+		}
+
+		// Test residue number system
+		// - bqint_rns_init
+		// - bqint_rns_set
+		// - bqint_rns_get
+		// - bqint_rns_add
+		// - bqint_rns_sub
+		// - bqint_rns_mul
+		{
+			bqint_rns rns;
+			bqint_word *ra, *rb, *rr;
+
+			test_assert(bqint_rns_init(&rns, ~(size_t)0) == 0, "RNS init with too many bits");
+			test_assert(rns.primes == 0 && rns.count == 0, "Failed RNS init is empty");
+			test_assert(bqint_rns_init(&rns, 300), "RNS init");
+
+			ra = (bqint_word*)malloc(3 * rns.count * sizeof(bqint_word));
+			rb = ra + rns.count;
+			rr = rb + rns.count;
+
+			for (fixi = 0; fixi < num_fixtures; fixi++) {
+				for (fixj = 0; fixj < num_fixtures; fixj++) {
+					bqint *a = &fixtures[fixi], *b = &fixtures[fixj];
+					bqint val = { 0 };
+					bqint ref = { 0 };
+
+					if ((bqint_byte_size(a) + bqint_byte_size(b)) * 8 > 290 || bqint_byte_size(b) * 16 > 290)
+						continue;
+
+					// a * b + a - b
+					bqint_mul(&val, a, b);
+					bqint_add(&ref, &val, a);
+					bqint_sub(&val, &ref, b);
+
+					bqint_rns_set(&rns, ra, a);
+					bqint_rns_set(&rns, rb, b);
+					bqint_rns_mul(&rns, rr, ra, rb);
+					bqint_rns_add(&rns, rr, rr, ra);
+					bqint_rns_sub(&rns, rr, rr, rb);
+					bqint_rns_get(&rns, &ref, rr);
+					test_assert_equal(&ref, &val, "RNS arithmetic");
+
+					// a - b * b
+					bqint_set_zero(&ref);
+					bqint_mul(&ref, b, b);
+					bqint_sub(&val, a, &ref);
+
+					bqint_rns_mul(&rns, rr, rb, rb);
+					bqint_rns_sub(&rns, rr, ra, rr);
+					bqint_rns_get(&rns, &ref, rr);
+					test_assert_equal(&ref, &val, "RNS negative result");
+
+					bqint_set(&val, a);
+					negate(&val);
+					bqint_rns_set(&rns, rr, &val);
+					bqint_rns_get(&rns, &ref, rr);
+					test_assert_equal(&ref, &val, "RNS negative value");
+
+					bqint_free(&val);
+					bqint_free(&ref);
+				}
+			}
+
+			free(ra);
+			bqint_rns_free(&rns);
+		}
+
+		// Test prime field elements
+		// - bqint_fe_prime
+		// - bqint_fe_set
+		// - bqint_fe_get
+		// - bqint_fe_add
+		// - bqint_fe_sub
+		// - bqint_fe_mul
+		// - bqint_fe_sqr
+		// - bqint_fe_inv
+		{
+			static const char *primes[] = {
+				"7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffed",
+				"fffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f",
+				"ffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
+				"fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffe"
+				"ffffffff0000000000000000ffffffff",
+			};
+			int field;
+
+			for (field = 0; field < BQINT_FIELD_NUM; field++) {
+				bqint p = { 0 };
+				bqint val = { 0 };
+				bqint ref = { 0 };
+				bqint ra = { 0 };
+				bqint rb = { 0 };
+				bqint_fe fa, fb, fr, one;
+				unsigned char bytes[48];
+				size_t len = strlen(primes[field]) / 2, i;
+
+				for (i = 0; i < len; i++) {
+					unsigned byte;
+					sscanf(primes[field] + 2 * i, "%2x", &byte);
+					bytes[i] = (unsigned char)byte;
+				}
+				bqint_set_bytes(&ref, bytes, len, BQINT_BYTES_BIG_ENDIAN);
+				bqint_fe_prime(field, &p);
+				test_assert_equal(&p, &ref, "Field prime");
+				test_assert(bqint_fe_size(field) * BQINT_WORD_BITS == (field == BQINT_FIELD_P384 ? 384 : 256),
+						"Field element size");
+				bqint_fe_set_u32(field, &one, 1);
+
+				for (fixi = 0; fixi < num_fixtures; fixi++) {
+					bqint *a = &fixtures[fixi];
+
+					bqint_fe_set(field, &fa, a);
+					bqint_fe_get(field, &val, &fa);
+					bqint_mod(&ra, a, &p);
+					test_assert_equal(&val, &ra, "Field element");
+
+					bqint_set(&val, a);
+					negate(&val);
+					bqint_fe_set(field, &fr, &val);
+					bqint_fe_add(field, &fr, &fr, &fa);
+					bqint_fe_get(field, &val, &fr);
+					test_assert(val.size == 0, "Field negative element");
+
+					// a a^-1 = 1 unless a = 0
+					bqint_fe_inv(field, &fr, &fa);
+					bqint_fe_mul(field, &fr, &fr, &fa);
+					bqint_fe_get(field, &val, &fr);
+					test_assert(ra.size == 0 ? val.size == 0 : bqint_fe_equal(field, &fr, &one), "Field inverse");
+
+					bqint_fe_sqr(field, &fr, &fa);
+					bqint_fe_get(field, &val, &fr);
+					bqint_set_zero(&ref);
+					bqint_mul(&ref, &ra, &ra);
+					bqint_mod(&ref, &ref, &p);
+					test_assert_equal(&val, &ref, "Field square");
+
+					for (fixj = 0; fixj < num_fixtures; fixj++) {
+						bqint *b = &fixtures[fixj];
+
+						bqint_fe_set(field, &fb, b);
+						bqint_mod(&rb, b, &p);
+
+						bqint_fe_mul(field, &fr, &fa, &fb);
+						bqint_fe_get(field, &val, &fr);
+						bqint_set_zero(&ref);
+						bqint_mul(&ref, &ra, &rb);
+						bqint_mod(&ref, &ref, &p);
+						test_assert_equal(&val, &ref, "Field product");
+
+						bqint_fe_add(field, &fr, &fa, &fb);
+						bqint_fe_get(field, &val, &fr);
+						bqint_add(&ref, &ra, &rb);
+						bqint_mod(&ref, &ref, &p);
+						test_assert_equal(&val, &ref, "Field sum");
+
+						bqint_fe_sub(field, &fr, &fa, &fb);
+						bqint_fe_get(field, &val, &fr);
+						bqint_add(&ref, &ra, &p);
+						bqint_sub(&ref, &ref, &rb);
+						bqint_mod(&ref, &ref, &p);
+						test_assert_equal(&val, &ref, "Field difference");
+					}
+				}
+
+				bqint_free(&p);
+				bqint_free(&val);
+				bqint_free(&ref);
+				bqint_free(&ra);
+				bqint_free(&rb);
+			}
+		}
+
 		// Test moving values
 		// - bqint_set
 		for (fixi = 0; fixi < num_fixtures; fixi++) {
@@ -216,6 +1410,121 @@ int main(int argc, char **argv)
 			bqint_free(&copy);
 		}
 
+		// Test sorting
+		// - bqint_sort
+		// - bqint_unique
+		{
+			size_t num = 3 * (size_t)num_fixtures, num_unique, num_ref = 0, i;
+			bqint *values = (bqint*)calloc(sizeof(bqint), num);
+
+			// Every fixture negated and twice as is, in reverse order
+			for (fixi = 0; fixi < num_fixtures; fixi++) {
+				bqint *v = &values[num - 1 - 3 * fixi];
+				bqint_set(&v[0], &fixtures[fixi]);
+				bqint_set(&v[-1], &fixtures[fixi]);
+				bqint_set(&v[-2], &fixtures[fixi]);
+				negate(&v[-2]);
+			}
+
+			bqint_sort(values, num);
+			for (i = 1; i < num; i++) {
+				test_assert(bqint_cmp(&values[i - 1], &values[i]) <= 0, "Sorted order");
+				if (bqint_cmp(&values[i - 1], &values[i]) != 0)
+					num_ref++;
+			}
+			num_ref++;
+
+			num_unique = bqint_unique(values, num);
+			test_assert(num_unique == num_ref, "Unique count");
+			for (i = 1; i < num_unique; i++) {
+				test_assert(bqint_cmp(&values[i - 1], &values[i]) < 0, "Unique order");
+			}
+			for (i = num_unique; i < num; i++) {
+				test_assert(values[i].size == 0, "Removed repeat");
+			}
+
+			for (i = 0; i < num; i++) {
+				bqint_free(&values[i]);
+			}
+			free(values);
+		}
+
+		// Sorting values whose keys tie, ordered by the full compare
+		{
+			static const int lows[] = { 2, -1, 3, 1, -2, 2, 1, 0, 1 };
+			static const int sorted[] = { -2, -1, 1, 1, 1, 2, 2, 3, 0 };
+			static const int distinct[] = { -2, -1, 1, 2, 3, 0 };
+			size_t num = sizeof(lows) / sizeof(*lows), i;
+			bqint values[sizeof(lows) / sizeof(*lows)];
+			bqint ref = { 0 };
+
+			memset(values, 0, sizeof(values));
+			for (i = 0; i < num; i++) {
+				set_sort_tie(&values[i], lows[i]);
+			}
+
+			bqint_sort(values, num);
+			for (i = 0; i < num; i++) {
+				set_sort_tie(&ref, sorted[i]);
+				test_assert_equal(&values[i], &ref, "Sorted tie");
+			}
+
+			test_assert(bqint_unique(values, num) == sizeof(distinct) / sizeof(*distinct), "Unique tie count");
+			for (i = 0; i < sizeof(distinct) / sizeof(*distinct); i++) {
+				set_sort_tie(&ref, distinct[i]);
+				test_assert_equal(&values[i], &ref, "Unique tie");
+			}
+
+			for (i = 0; i < num; i++) {
+				bqint_free(&values[i]);
+			}
+			bqint_free(&ref);
+		}
+
+		// Test shared storage
+		// - bqint_share
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			bqint *results = binop_res + ((fixi * num_fixtures) + fixi) * num_binops;
+			bqint a = { 0 };
+			bqint b = { 0 };
+			bqint c = { 0 };
+			bqint val = { 0 };
+			bqint ref = { 0 };
+			char str[512], str_ref[512];
+
+			bqint_set(&a, &fixtures[fixi]);
+			bqint_share(&a);
+			bqint_set(&b, &a);
+			bqint_set(&c, &b);
+			test_assert_equal(&b, &fixtures[fixi], "Shared copy");
+			if (a.size > BQINT_INLINE_CAPACITY) {
+				test_assert(a.flags & BQINT_SHARED, "Shared flag");
+				test_assert(bqint_get_words(&c) == bqint_get_words(&a), "Shared words");
+			}
+
+			// Writing to a copy must leave the others intact
+			bqint_add_inplace(&b, &c);
+			test_assert_equal(&b, &results[0], "Shared in-place sum result");
+			test_assert_equal(&a, &fixtures[fixi], "Shared value after write");
+			test_assert_equal(&c, &fixtures[fixi], "Shared copy after write");
+
+			// Operations that modify internal copies of their inputs
+			bqint_gcd(&val, &a, &c);
+			bqint_gcd(&ref, &fixtures[fixi], &fixtures[fixi]);
+			test_assert_equal(&val, &ref, "Shared GCD result");
+			bqint_get_string(&a, str, sizeof(str), 10);
+			bqint_get_string(&fixtures[fixi], str_ref, sizeof(str_ref), 10);
+			test_assert(!strcmp(str, str_ref), "Shared string");
+			test_assert_equal(&a, &fixtures[fixi], "Shared value after reads");
+
+			bqint_free(&a);
+			bqint_free(&b);
+			test_assert_equal(&c, &fixtures[fixi], "Shared copy after free");
+			bqint_free(&c);
+			bqint_free(&val);
+			bqint_free(&ref);
+		}
+
 		// Test self-operations
 		// - bqint_add
 		// - bqint_add_inplace
@@ -225,6 +1534,7 @@ int main(int argc, char **argv)
 			bqint *results = binop_res + ((fixi * num_fixtures) + fixi) * num_binops;
 			bqint sum = { 0 };
 			bqint placesum = { 0 };
+			bqint sqr = { 0 };
 			// bqint mul = { 0 };
 			// bqint placemul = { 0 };
 			bqint_set(&sum, &fixtures[fixi]);
@@ -238,6 +1548,20 @@ int main(int argc, char **argv)
 			bqint_add_inplace(&placesum, &placesum);
 			test_assert_equal(&sum, &results[0], "Self in-place sum result");
 
+			// Squares with both algorithms
+			bqint_set_threshold(BQINT_THRESHOLD_SQR, 0);
+			bqint_mul(&sqr, &fixtures[fixi], &fixtures[fixi]);
+			test_assert_equal(&sqr, &results[1], "Square result");
+			bqint_set_zero(&sqr);
+			bqint_set_threshold(BQINT_THRESHOLD_SQR, (size_t)-1);
+			bqint_mul(&sqr, &fixtures[fixi], &fixtures[fixi]);
+			test_assert_equal(&sqr, &results[1], "General square result");
+			bqint_load_thresholds();
+			if (!getenv("BQINT_THRESHOLDS"))
+				test_assert(bqint_get_threshold(BQINT_THRESHOLD_SQR) == BQINT_SQR_THRESHOLD, "Thresholds loaded");
+			bqint_set_threshold(BQINT_THRESHOLD_SQR, BQINT_SQR_THRESHOLD);
+			test_assert(!strcmp(bqint_threshold_name(BQINT_THRESHOLD_SQR), "sqr"), "Threshold name");
+
 			// bqint_mul(&mul, &mul, &mul);
 			// test_assert_equal(&mul, &results[1], "Self mul result");
 
@@ -246,6 +1570,7 @@ int main(int argc, char **argv)
 
 			bqint_free(&sum);
 			bqint_free(&placesum);
+			bqint_free(&sqr);
 			// bqint_free(&mul);
 			// bqint_free(&placemul);
 
@@ -269,6 +1594,10 @@ int main(int argc, char **argv)
 				bqint amul = { 0 };
 				bqint bmul = { 0 };
 				bqint sub = { 0 };
+				bqint bit = { 0 };
+				bqint placebit = { 0 };
+				bqint nega = { 0 };
+				bqint negb = { 0 };
 
 				bqint_add(&sum, &fixtures[fixi], &fixtures[fixj]);
 				test_assert_equal(&sum, &results[0], "Sum result");
@@ -301,6 +1630,55 @@ int main(int argc, char **argv)
 				bqint_sub(&sub, &fixtures[fixi], &fixtures[fixj]);
 				test_assert_equal(&sub, &results[2], "Sub result");
 
+				bqint_set_zero(&bit);
+				bqint_and(&bit, &fixtures[fixi], &fixtures[fixj]);
+				test_assert_equal(&bit, &results[3], "And result");
+
+				bqint_or(&bit, &fixtures[fixi], &fixtures[fixj]);
+				test_assert_equal(&bit, &results[4], "Or result");
+
+				bqint_xor(&bit, &fixtures[fixi], &fixtures[fixj]);
+				test_assert_equal(&bit, &results[5], "Xor result");
+
+				bqint_andnot(&bit, &fixtures[fixi], &fixtures[fixj]);
+				test_assert_equal(&bit, &results[6], "Andnot result");
+
+				bqint_set(&nega, &fixtures[fixi]);
+				bqint_set(&negb, &fixtures[fixj]);
+				negate(&nega);
+				negate(&negb);
+
+				bqint_and(&bit, &nega, &fixtures[fixj]);
+				test_assert_equal(&bit, &results[7], "Negative and result");
+
+				bqint_or(&bit, &fixtures[fixi], &negb);
+				test_assert_equal(&bit, &results[8], "Negative or result");
+
+				bqint_xor(&bit, &nega, &negb);
+				test_assert_equal(&bit, &results[9], "Negative xor result");
+
+				bqint_andnot(&bit, &nega, &fixtures[fixj]);
+				test_assert_equal(&bit, &results[10], "Negative andnot result");
+
+				bqint_and(&bit, &nega, &negb);
+				test_assert_equal(&bit, &results[11], "Negative and result");
+
+				bqint_set(&placebit, &fixtures[fixi]);
+				bqint_or_inplace(&placebit, &fixtures[fixj]);
+				test_assert_equal(&placebit, &results[4], "In-place or result");
+
+				bqint_set(&placebit, &fixtures[fixi]);
+				bqint_andnot(&placebit, &placebit, &fixtures[fixj]);
+				test_assert_equal(&placebit, &results[6], "In-place andnot result");
+
+				bqint_set(&placebit, &nega);
+				bqint_xor_inplace(&placebit, &negb);
+				test_assert_equal(&placebit, &results[9], "In-place negative xor result");
+
+				bqint_set(&placebit, &negb);
+				bqint_and(&placebit, &nega, &placebit);
+				test_assert_equal(&placebit, &results[11], "In-place negative and result");
+
 				bqint_free(&sum);
 				bqint_free(&placesum);
 				bqint_free(&asum);
@@ -310,6 +1688,10 @@ int main(int argc, char **argv)
 				bqint_free(&amul);
 				bqint_free(&bmul);
 				bqint_free(&sub);
+				bqint_free(&bit);
+				bqint_free(&placebit);
+				bqint_free(&nega);
+				bqint_free(&negb);
 			}
 		}
 
@@ -328,6 +1710,239 @@ int main(int argc, char **argv)
 			}
 		}
 
+		// Test unary operations
+		// - bqint_not
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			bqint *results = unop_res + fixi * num_unops;
+			bqint inv = { 0 };
+			bqint neg = { 0 };
+
+			bqint_not(&inv, &fixtures[fixi]);
+			test_assert_equal(&inv, &results[0], "Not result");
+
+			bqint_set(&neg, &fixtures[fixi]);
+			negate(&neg);
+			bqint_not(&neg, &neg);
+			test_assert_equal(&neg, &results[1], "Negative in-place not result");
+
+			bqint_free(&inv);
+			bqint_free(&neg);
+		}
+
+		// Test shift operations
+		// - bqint_shl
+		// - bqint_shl_inplace
+		// - bqint_shr
+		// - bqint_shr_inplace
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			for (fixj = 0; fixj < num_shift_fixtures; fixj++) {
+				bqint *results = shiftop_res + ((fixi * num_shift_fixtures) + fixj) * num_shiftops;
+				bqint_size shift = shift_fixtures[fixj];
+				bqint shl = { 0 };
+				bqint shr = { 0 };
+				bqint place = { 0 };
+				bqint neg = { 0 };
+
+				bqint_shl(&shl, &fixtures[fixi], shift);
+				test_assert_equal(&shl, &results[0], "Shl result");
+
+				bqint_set(&place, &fixtures[fixi]);
+				bqint_shl_inplace(&place, shift);
+				test_assert_equal(&place, &results[0], "In-place shl result");
+
+				bqint_shr(&shr, &fixtures[fixi], shift);
+				test_assert_equal(&shr, &results[1], "Shr result");
+
+				bqint_set(&neg, &fixtures[fixi]);
+				negate(&neg);
+				bqint_shl(&shl, &neg, shift);
+				test_assert_equal(&shl, &results[2], "Negative shl result");
+
+				bqint_shr(&shr, &neg, shift);
+				test_assert_equal(&shr, &results[3], "Negative shr result");
+
+				bqint_shr_inplace(&neg, shift);
+				test_assert_equal(&neg, &results[3], "Negative in-place shr result");
+
+				bqint_free(&shl);
+				bqint_free(&shr);
+				bqint_free(&place);
+				bqint_free(&neg);
+			}
+		}
+
+		// Test byte import and export
+		// - bqint_set_bytes
+		// - bqint_get_bytes
+		// - bqint_byte_size
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			bqint *a = &fixtures[fixi];
+			size_t i, num = bqint_byte_size(a);
+			unsigned char *le = (unsigned char*)malloc(num + 4);
+			unsigned char *be = (unsigned char*)malloc(num + 4);
+			int reversed = 1;
+			bqint abs = { 0 };
+			bqint val = { 0 };
+
+			bqint_set(&abs, a);
+			abs.flags &= ~BQINT_NEGATIVE;
+
+			test_assert(bqint_get_bytes(a, le, num, BQINT_BYTES_LITTLE_ENDIAN) == num, "Little-endian export size");
+			test_assert(bqint_get_bytes(a, be, num, BQINT_BYTES_BIG_ENDIAN) == num, "Big-endian export size");
+			test_assert(num == 0 || le[num - 1] != 0, "Exported bytes are minimal");
+			for (i = 0; i < num; i++) {
+				reversed = reversed && le[i] == be[num - 1 - i];
+			}
+			test_assert(reversed, "Big-endian export is reversed");
+			if (num > 0) {
+				test_assert(bqint_get_bytes(a, le, num - 1, BQINT_BYTES_LITTLE_ENDIAN) == num, "Export to a too small buffer");
+			}
+
+			bqint_set_bytes(&val, le, num, BQINT_BYTES_LITTLE_ENDIAN);
+			test_assert_equal(&val, &abs, "Little-endian roundtrip");
+			bqint_set_bytes(&val, be, num, BQINT_BYTES_BIG_ENDIAN);
+			test_assert_equal(&val, &abs, "Big-endian roundtrip");
+
+			test_assert(bqint_get_bytes(a, be, num + 4, BQINT_BYTES_BIG_ENDIAN|BQINT_BYTES_PAD) == num + 4, "Padded export size");
+			test_assert(!be[0] && !be[1] && !be[2] && !be[3], "Padded big-endian export");
+			bqint_set_bytes(&val, be, num + 4, BQINT_BYTES_BIG_ENDIAN);
+			test_assert_equal(&val, &abs, "Padded big-endian roundtrip");
+
+			test_assert(bqint_get_bytes(a, le, num + 4, BQINT_BYTES_LITTLE_ENDIAN|BQINT_BYTES_PAD) == num + 4, "Padded export size");
+			test_assert(!le[num] && !le[num + 1] && !le[num + 2] && !le[num + 3], "Padded little-endian export");
+			bqint_set_bytes(&val, le, num + 4, BQINT_BYTES_LITTLE_ENDIAN);
+			test_assert_equal(&val, &abs, "Padded little-endian roundtrip");
+
+			bqint_free(&abs);
+			bqint_free(&val);
+			free(le);
+			free(be);
+		}
+
+		// Test read-only views
+		// - bqint_view
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			for (fixj = 0; fixj < num_fixtures; fixj++) {
+				bqint *results = binop_res + ((fixi * num_fixtures) + fixj) * num_binops;
+				bqint *a = &fixtures[fixi], *b = &fixtures[fixj];
+				size_t a_size = a->size + 2, b_size = b->size + 2;
+				bqint_word *a_buf = (bqint_word*)calloc(a_size, sizeof(bqint_word));
+				bqint_word *b_buf = (bqint_word*)calloc(b_size, sizeof(bqint_word));
+				bqint va, vb;
+				bqint res = { 0 };
+
+				// Note: High zero words must be trimmed by the view
+				memcpy(a_buf, bqint_get_words(a), a->size * sizeof(bqint_word));
+				memcpy(b_buf, bqint_get_words(b), b->size * sizeof(bqint_word));
+				va = bqint_view(a_buf, a_size);
+				vb = bqint_view(b_buf, b_size);
+				test_assert(bqint_cmp(&va, a) == 0, "View value");
+
+				bqint_add(&res, &va, &vb);
+				test_assert_equal(&res, &results[0], "View sum result");
+				bqint_mul(&res, &va, &vb);
+				test_assert_equal(&res, &results[1], "View mul result");
+				bqint_sub(&res, &va, &vb);
+				test_assert_equal(&res, &results[2], "View sub result");
+
+				// Writing to a view copies the value without touching the memory
+				bqint_add_inplace(&va, &vb);
+				test_assert_equal(&va, &results[0], "In-place view sum result");
+				test_assert(!memcmp(a_buf, bqint_get_words(a), a->size * sizeof(bqint_word)), "View memory unchanged");
+				test_assert(!(va.flags & BQINT_VIEW), "Written view detached");
+
+				bqint_free(&va);
+				bqint_free(&vb);
+				bqint_free(&res);
+				free(a_buf);
+				free(b_buf);
+			}
+		}
+
+		// Test instances
+		// - bqint8_*
+		// - bqint64_*
+		// - BQINT_REINTERPRET
+		for (fixi = 0; fixi < num_fixtures; fixi++) {
+			bqint *a = &fixtures[fixi], *b = &fixtures[(fixi + 1) % num_fixtures];
+			size_t num = bqint_byte_size(a) + bqint_byte_size(b);
+			unsigned char *ref_bytes = (unsigned char*)malloc(num + 1);
+			unsigned char *bytes = (unsigned char*)malloc(num + 1);
+			uint32_t one = 1;
+			int little_endian = *(unsigned char*)&one == 1;
+			bqint ref = { 0 };
+			bqint8 a8 = bqint8_dynamic(), b8 = bqint8_dynamic(), r8 = bqint8_dynamic();
+			bqint8 view8;
+
+			bqint_mul(&ref, a, b);
+			negate(&ref);
+			bqint_get_bytes(&ref, ref_bytes, num, BQINT_BYTES_LITTLE_ENDIAN|BQINT_BYTES_PAD);
+
+			bqint_get_bytes(a, bytes, num, BQINT_BYTES_LITTLE_ENDIAN);
+			bqint8_set_bytes(&a8, bytes, bqint_byte_size(a), BQINT_BYTES_LITTLE_ENDIAN);
+			bqint_get_bytes(b, bytes, num, BQINT_BYTES_LITTLE_ENDIAN);
+			bqint8_set_bytes(&b8, bytes, bqint_byte_size(b), BQINT_BYTES_LITTLE_ENDIAN);
+			bqint8_mul(&r8, &a8, &b8);
+			bqint8_get_bytes(&r8, bytes, num, BQINT_BYTES_LITTLE_ENDIAN|BQINT_BYTES_PAD);
+			test_assert(!memcmp(bytes, ref_bytes, num), "Product with 8-bit words");
+
+			if (little_endian) {
+				view8 = BQINT_REINTERPRET(bqint8, ref);
+				test_assert(bqint8_byte_size(&view8) == bqint_byte_size(&ref)
+						&& (view8.flags & BQINT_NEGATIVE) == (ref.flags & BQINT_NEGATIVE),
+						"Reinterpreted as 8-bit words");
+				bqint8_get_bytes(&view8, bytes, num, BQINT_BYTES_LITTLE_ENDIAN|BQINT_BYTES_PAD);
+				test_assert(!memcmp(bytes, ref_bytes, num), "Reinterpreted words");
+			}
+
+#if defined(__SIZEOF_INT128__)
+			{
+				bqint64 a64 = bqint64_dynamic(), b64 = bqint64_dynamic(), r64 = bqint64_dynamic();
+				bqint val;
+
+				bqint_get_bytes(a, bytes, num, BQINT_BYTES_LITTLE_ENDIAN);
+				bqint64_set_bytes(&a64, bytes, bqint_byte_size(a), BQINT_BYTES_LITTLE_ENDIAN);
+				bqint_get_bytes(b, bytes, num, BQINT_BYTES_LITTLE_ENDIAN);
+				bqint64_set_bytes(&b64, bytes, bqint_byte_size(b), BQINT_BYTES_LITTLE_ENDIAN);
+				bqint64_mul(&r64, &a64, &b64);
+				bqint64_get_bytes(&r64, bytes, num, BQINT_BYTES_LITTLE_ENDIAN|BQINT_BYTES_PAD);
+				test_assert(!memcmp(bytes, ref_bytes, num), "Product with 64-bit words");
+
+				if (little_endian) {
+					r64.flags |= BQINT_NEGATIVE;
+					val = BQINT_REINTERPRET(bqint, r64);
+					test_assert_equal(&val, &ref, "Reinterpreted 64-bit words");
+
+					if (ref.size * sizeof(bqint_word) % sizeof(bqint64_word) == 0) {
+						bqint64 view64 = BQINT_REINTERPRET(bqint64, ref);
+						test_assert(bqint64_cmp(&view64, &r64) == 0, "Reinterpreted as 64-bit words");
+					}
+				}
+
+				bqint64_free(&a64);
+				bqint64_free(&b64);
+				bqint64_free(&r64);
+			}
+#endif
+
+			bqint8_free(&a8);
+			bqint8_free(&b8);
+			bqint8_free(&r8);
+			bqint_free(&ref);
+			free(ref_bytes);
+			free(bytes);
+		}
+
+#if defined(__SIZEOF_INT128__)
+		// Word primality for the residue number system: 4759123141 is a strong
+		// pseudoprime to the bases 2, 7 and 61 and 3825123056546413051 to all
+		// the primes up to 23
+		test_assert(!bqint64__is_prime_word(UINT64_C(4759123141)), "64-bit word pseudoprime to bases 2, 7 and 61");
+		test_assert(!bqint64__is_prime_word(UINT64_C(3825123056546413051)), "64-bit word pseudoprime to bases up to 23");
+		test_assert(bqint64__is_prime_word(UINT64_C(4759123129)), "64-bit word prime");
+		test_assert(bqint64__is_prime_word(UINT64_C(18446744073709551557)), "Largest 64-bit word prime");
+#endif
+
 		for (fixi = 0; fixi < num_fixtures; fixi++) {
 			bqint_free(&fixtures[fixi]);
 		}
@@ -339,7 +1954,196 @@ int main(int argc, char **argv)
 		for (fixi = 0; fixi < num_fixtures*num_small_fixtures*num_small_binops; fixi++) {
 			bqint_free(&small_binop_res[fixi]);
 		}
+
+		for (fixi = 0; fixi < num_fixtures*num_unops; fixi++) {
+			bqint_free(&unop_res[fixi]);
+		}
+
+		for (fixi = 0; fixi < num_fixtures*num_shift_fixtures*num_shiftops; fixi++) {
+			bqint_free(&shiftop_res[fixi]);
+		}
+	}
+
+	// Test storage management
+	// - bqint_reserve
+	// - bqint_shrink_to_fit
+	{
+		bqint val = { 0 };
+		bqint ref = { 0 };
+		bqint_word *words;
+
+		bqint_set_u32(&ref, 0x12345678);
+		bqint_shl_inplace(&ref, 200);
+
+		bqint_set(&val, &ref);
+		bqint_reserve(&val, 100);
+		test_assert(val.capacity >= 100, "Reserved capacity");
+		test_assert_equal(&val, &ref, "Reserved value");
+
+		words = bqint_get_words(&val);
+		bqint_add_inplace(&val, &ref);
+		test_assert(bqint_get_words(&val) == words, "Reserved storage is not reallocated");
+
+		bqint_shrink_to_fit(&val);
+		test_assert(val.capacity == (val.size > BQINT_INLINE_CAPACITY ? val.size : BQINT_INLINE_CAPACITY), "Shrunk capacity");
+		bqint_sub(&val, &val, &ref);
+		test_assert_equal(&val, &ref, "Shrunk value");
+
+		bqint_shr_inplace(&val, 200);
+		bqint_shrink_to_fit(&val);
+		test_assert((val.flags & BQINT_INLINED) && !(val.flags & BQINT_ALLOCATED), "Shrunk to inline");
+		bqint_shl_inplace(&val, 200);
+		test_assert_equal(&val, &ref, "Shrunk to inline value");
+
+		bqint_free(&val);
+		bqint_free(&ref);
+	}
+
+	// Test static storage
+	// - bqint_static
+	{
+		bqint_word buffer[5];
+		bqint res;
+		bqint a = { 0 };
+		bqint one = { 0 };
+		bqint mod = { 0 };
+		int i;
+
+		// 10-word operands into 4 words, the word past them must stay intact
+		bqint_set_u32(&one, 1);
+		bqint_shl(&a, &one, 10 * BQINT_WORD_BITS);
+		bqint_sub(&a, &a, &one);
+		buffer[4] = (bqint_word)0x5a;
+
+		expect_errors_begin();
+		res = bqint_static(buffer, 4 * sizeof(bqint_word));
+		bqint_mul(&res, &a, &a);
+		test_assert((res.flags & BQINT_TRUNCATED) != 0, "Truncated static product");
+		test_assert(buffer[4] == (bqint_word)0x5a, "Static product stays in the buffer");
+
+		res = bqint_static(buffer, 4 * sizeof(bqint_word));
+		bqint_set_u32(&res, 3);
+		bqint_shl_inplace(&res, 3 * BQINT_WORD_BITS);
+		bqint_mul_inplace(&res, &a);
+		test_assert((res.flags & BQINT_TRUNCATED) != 0, "Truncated static in-place product");
+		test_assert(buffer[4] == (bqint_word)0x5a, "Static in-place product stays in the buffer");
+
+		// 2^-i = -2^(10w - i) (mod 2^10w + 1) doesn't fit in 2 words
+		bqint_shl(&mod, &one, 10 * BQINT_WORD_BITS);
+		bqint_add_inplace(&mod, &one);
+		buffer[2] = (bqint_word)0x5a;
+		res = bqint_static(buffer, 2 * sizeof(bqint_word));
+		bqint_sub(&res, &mod, &a);
+		test_assert(buffer[2] == (bqint_word)0x5a, "Static difference stays in the buffer");
+		for (i = 1; i <= 4; i++) {
+			res = bqint_static(buffer, 2 * sizeof(bqint_word));
+			bqint_shl(&a, &one, i);
+			bqint_invmod(&res, &a, &mod);
+			test_assert((res.flags & BQINT_TRUNCATED) != 0, "Truncated static modular inverse");
+			test_assert(buffer[2] == (bqint_word)0x5a, "Static modular inverse stays in the buffer");
+		}
+		expect_errors_end();
+
+		bqint_free(&a);
+		bqint_free(&one);
+		bqint_free(&mod);
+	}
+
+#ifdef BQINT_INLINE_BITS
+	// Test inline storage
+	// - BQINT_INLINE_BITS
+	{
+		bqint val = { 0 };
+		bqint one = { 0 };
+
+		bqint_set_u32(&one, 1);
+		bqint_shl(&val, &one, BQINT_INLINE_BITS - 1);
+		test_assert(val.size * BQINT_WORD_BITS >= BQINT_INLINE_BITS, "Inline value size");
+		test_assert((val.flags & BQINT_INLINED) && !(val.flags & BQINT_ALLOCATED), "Inline value");
+
+		bqint_free(&val);
+		bqint_free(&one);
 	}
+#endif
+
+#ifdef BQINT_POOL
+	// Test pooled allocator
+	// - bqint_pool_alloc
+	// - bqint_pool_realloc
+	// - bqint_pool_free
+	// - bqint_pool_trim
+	{
+		void *a, *b;
+		bqint val = { 0 };
+		bqint ref = { 0 };
+		bqint one = { 0 };
+		size_t i;
+
+		a = bqint_pool_alloc(100);
+		bqint_pool_free(a);
+		b = bqint_pool_alloc(120);
+		test_assert(a == b, "Pool reuses freed block of the same class");
+		a = bqint_pool_realloc(b, 120, 128);
+		test_assert(a == b, "Pool realloc within class keeps the block");
+		memset(a, 0xAB, 128);
+		b = bqint_pool_realloc(a, 128, 4000);
+		test_assert(((unsigned char*)b)[127] == 0xAB, "Pool realloc copies data");
+		bqint_pool_free(b);
+
+		a = bqint_pool_alloc((size_t)1 << (BQINT_POOL_MAX_CLASS + 1));
+		test_assert(a != 0, "Pool large allocation");
+		bqint_pool_free(a);
+
+		bqint_set_allocators(bqint_pool_alloc, bqint_pool_free, bqint_pool_realloc);
+
+		bqint_set_u32(&one, 1);
+		bqint_set_u32(&val, 1);
+		for (i = 0; i < 100; i++) {
+			bqint_shl_inplace(&val, 37);
+			bqint_add_inplace(&val, &one);
+			bqint_mul(&ref, &val, &val);
+		}
+		bqint_shr_inplace(&ref, 7400);
+		test_assert_equal(&ref, &one, "Pooled value");
+
+		bqint_free(&val);
+		bqint_free(&ref);
+		bqint_free(&one);
+		bqint_pool_trim();
+
+		bqint_set_allocators(bqtest_alloc, bqtest_free, 0);
+	}
+#endif
+
+#ifdef BQINT_STATS
+	// Test instrumentation
+	// - bqint_stats_snapshot
+	// - bqint_stats_reset
+	{
+		bqint_stats stats;
+		int op;
+
+		bqint_stats_snapshot(&stats);
+		for (op = 0; op < BQINT_STAT_NUM_OPS; op++) {
+			uint64_t bucket_sum = 0;
+			int i;
+			for (i = 0; i < BQINT_STATS_SIZE_BUCKETS; i++)
+				bucket_sum += stats.ops[op].size_histogram[i];
+			test_assert(stats.ops[op].calls > 0, "Stats %s called", bqint_stats_op_name(op));
+			test_assert(bucket_sum == stats.ops[op].calls, "Stats %s size histogram", bqint_stats_op_name(op));
+		}
+
+		test_assert(stats.allocs > 0, "Stats allocations");
+		test_assert(stats.allocs == stats.frees, "Stats allocations freed");
+		test_assert(stats.bytes_allocated == stats.bytes_freed, "Stats allocated bytes freed");
+		test_assert(stats.truncated == expected_truncated, "Stats no unexpected truncation");
+
+		bqint_stats_reset();
+		bqint_stats_snapshot(&stats);
+		test_assert(stats.ops[BQINT_STAT_ADD].calls == 0, "Stats reset");
+		test_assert(stats.allocs == 0, "Stats allocations reset");
+	}
+#endif
 
 	printf("%llu/%llu (%llu fails)\n", (lluint)(num_asserts - num_failed), (lluint)num_asserts, (lluint)num_failed);
 
@@ -0,0 +1,174 @@
+// Measures the crossover points between the tiers of the algorithms on this
+// machine for every word size and writes them to a thresholds header that
+// bqint.h includes when it's found in the include path.
+//
+//   gcc -O2 -o bin/tune_bqint tune_bqint.c
+//   bin/tune_bqint bqint_thresholds.h
+
+#define inline
+#define _CRT_SECURE_NO_WARNINGS
+#define BQINT_NO_THRESHOLDS_HEADER
+#define BQINT_IMPLEMENTATION
+#include "bqint.h"
+#define BQINT_INSTANCE 8
+#include "bqint.h"
+#define BQINT_INSTANCE 16
+#include "bqint.h"
+#define BQINT_INSTANCE 32
+#include "bqint.h"
+#if defined(__SIZEOF_INT128__)
+#define BQINT_INSTANCE 64
+#include "bqint.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_BITS 4096
+#define MIN_SECONDS 0.002
+#define ROUNDS 5
+
+static unsigned char random_bytes[MAX_BITS / 8];
+
+// How the threshold maps to the crossover: the fast tier is used from
+// `words` (offset 0) or above `words` (offset 1)
+typedef struct tune_threshold
+{
+	int threshold;
+	const char *macro;
+	size_t offset;
+} tune_threshold;
+
+static const tune_threshold tune_thresholds[] = {
+	{ BQINT_THRESHOLD_GCD_LEHMER, "BQINT_GCD_LEHMER_THRESHOLD", 1 },
+	{ BQINT_THRESHOLD_SQR, "BQINT_SQR_THRESHOLD", 0 },
+};
+
+#define NUM_THRESHOLDS (sizeof(tune_thresholds) / sizeof(*tune_thresholds))
+
+typedef double (*tune_time_fn)(int threshold, size_t value, size_t words);
+
+typedef struct tune_instance
+{
+	int bits;
+	tune_time_fn time;
+	size_t results[NUM_THRESHOLDS];
+} tune_instance;
+
+// Seconds per call of the operation that `threshold` picks the algorithm for
+// with operands of `words` words, the best of a few rounds
+#define TUNE_DEFINE_TIME(prefix, bits) \
+	static double prefix##_time(int threshold, size_t value, size_t words) \
+	{ \
+		prefix a = prefix##_dynamic(), b = prefix##_dynamic(), r = prefix##_dynamic(); \
+		double best = 0.0; \
+		int round; \
+		prefix##_set_threshold(threshold, value); \
+		prefix##_set_raw(&a, random_bytes, words * (bits / 8)); \
+		prefix##_set_raw(&b, random_bytes + sizeof(random_bytes) / 2, words * (bits / 8)); \
+		for (round = 0; round < ROUNDS; round++) { \
+			clock_t begin = clock(); \
+			double seconds; \
+			long calls = 0; \
+			do { \
+				if (threshold == BQINT_THRESHOLD_GCD_LEHMER) \
+					prefix##_gcd(&r, &a, &b); \
+				else \
+					prefix##_mul(&r, &a, &a); \
+				calls++; \
+				seconds = (double)(clock() - begin) / CLOCKS_PER_SEC; \
+			} while (seconds < MIN_SECONDS); \
+			if (round == 0 || seconds / calls < best) \
+				best = seconds / calls; \
+		} \
+		prefix##_free(&a); \
+		prefix##_free(&b); \
+		prefix##_free(&r); \
+		return best; \
+	}
+
+TUNE_DEFINE_TIME(bqint8, 8)
+TUNE_DEFINE_TIME(bqint16, 16)
+TUNE_DEFINE_TIME(bqint32, 32)
+#if defined(__SIZEOF_INT128__)
+TUNE_DEFINE_TIME(bqint64, 64)
+#endif
+
+static tune_instance tune_instances[] = {
+	{ 8, bqint8_time },
+	{ 16, bqint16_time },
+	{ 32, bqint32_time },
+#if defined(__SIZEOF_INT128__)
+	{ 64, bqint64_time },
+#endif
+};
+
+#define NUM_INSTANCES (sizeof(tune_instances) / sizeof(*tune_instances))
+
+// Binary search for the smallest size where the fast tier wins, assumes that
+// it keeps winning for larger sizes
+static size_t tune_crossover(const tune_instance *inst, const tune_threshold *thr)
+{
+	size_t lo = 1, hi = MAX_BITS / inst->bits + 1;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		double fast = inst->time(thr->threshold, 0, mid);
+		double slow = inst->time(thr->threshold, (size_t)-1, mid);
+		if (fast < slow)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return lo - thr->offset;
+}
+
+static void write_macro(FILE *file, const tune_threshold *thr, size_t t)
+{
+	size_t i;
+
+	fprintf(file, "#ifndef %s\n#define %s (", thr->macro, thr->macro);
+	for (i = 0; i + 1 < NUM_INSTANCES; i++) {
+		fprintf(file, "BQINT_WORD_BITS == %d ? %u : ", tune_instances[i].bits,
+				(unsigned)tune_instances[i].results[t]);
+	}
+	fprintf(file, "%u)\n#endif\n\n", (unsigned)tune_instances[i].results[t]);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : "bqint_thresholds.h";
+	FILE *file;
+	size_t i, t;
+
+	srand(1);
+	for (i = 0; i < sizeof(random_bytes); i++) {
+		random_bytes[i] = (unsigned char)rand();
+	}
+
+	for (i = 0; i < NUM_INSTANCES; i++) {
+		tune_instance *inst = &tune_instances[i];
+		for (t = 0; t < NUM_THRESHOLDS; t++) {
+			inst->results[t] = tune_crossover(inst, &tune_thresholds[t]);
+			printf("%2d-bit words: %s = %u\n", inst->bits, tune_thresholds[t].macro,
+					(unsigned)inst->results[t]);
+		}
+	}
+
+	file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		return 1;
+	}
+
+	fprintf(file, "// Generated by tune_bqint.c for this machine, see bqint.h\n\n");
+	for (t = 0; t < NUM_THRESHOLDS; t++) {
+		write_macro(file, &tune_thresholds[t], t);
+	}
+	fclose(file);
+
+	printf("Wrote %s\n", path);
+	return 0;
+}